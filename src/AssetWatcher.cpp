@@ -0,0 +1,147 @@
+/*
+ * AssetWatcher.cpp: Reloading baked assets while the program runs.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "AssetWatcher.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+// One worker is plenty; files change a few at a time, by hand.
+AssetWatcher::AssetWatcher(void)
+    : pool(1)
+{
+    fd = -1;
+}
+
+AssetWatcher::~AssetWatcher(void)
+{
+#ifdef __linux__
+    if ( fd >= 0 )
+        close(fd);
+#endif
+}
+
+
+bool
+AssetWatcher::Start(const char *directory)
+{
+    dir = directory && directory[0] ? directory : ".";
+
+#ifdef __linux__
+    if ( fd >= 0 )
+        return true;
+
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if ( fd < 0 )
+    {
+        fprintf(stderr, "AssetWatcher::Start: inotify: %s\n", strerror(errno));
+        return false;
+    }
+
+    // park_bake writes each file beside its target and renames it over,
+    // so a finished file arrives as a move. Anything written in place is
+    // caught when it is closed.
+    if ( inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0 )
+    {
+        fprintf(stderr, "AssetWatcher::Start: Can't watch %s: %s\n", dir.c_str(), strerror(errno));
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    return true;
+#else
+    fprintf(stderr, "AssetWatcher::Start: Can't watch %s on this system\n", dir.c_str());
+    return false;
+#endif
+}
+
+
+void
+AssetWatcher::Watch(const std::string &filename, Reader read, Uploader upload)
+{
+    size_t  slash = filename.find_last_of("/\\");
+    Watched watch;
+
+    watch.name = slash == std::string::npos ? filename : filename.substr(slash + 1);
+    watch.read = read;
+    watch.upload = upload;
+    watch.changed = false;
+    watches.push_back(std::move(watch));
+}
+
+
+void
+AssetWatcher::Changed(const char *name)
+{
+    for ( auto &watch : watches )
+        if ( ! name || watch.name == name )
+            watch.changed = true;
+}
+
+
+void
+AssetWatcher::Poll(void)
+{
+#ifdef __linux__
+    if ( fd < 0 )
+        return;
+
+    // Everything inotify has queued, without waiting for more.
+    alignas(struct inotify_event) char  events[4096];
+    ssize_t                             length;
+
+    while ( ( length = read(fd, events, sizeof(events)) ) > 0 )
+    {
+        const struct inotify_event  *event;
+
+        for ( char *p = events ; p < events + length ; p += sizeof(*event) + event->len )
+        {
+            event = (const struct inotify_event*)p;
+            if ( event->mask & IN_Q_OVERFLOW )
+                Changed(nullptr);   // Lost track; read them all
+            else if ( event->len )
+                Changed(event->name);
+        }
+    }
+#endif
+
+    for ( auto &watch : watches )
+    {
+        // Upload what has finished reading. Failures keep the old asset,
+        // and the reader has said why.
+        if ( watch.reading.valid()
+          && watch.reading.wait_for(std::chrono::seconds(0)) == std::future_status::ready )
+        {
+            auto start = std::chrono::steady_clock::now();
+            bool read = false;
+
+            try {
+                read = watch.reading.get();
+            }
+            catch ( ... ) {
+            }
+            if ( read )
+            {
+                watch.upload();
+                double ms = std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - start).count();
+                fprintf(stderr, "AssetWatcher::Poll: Reloaded %s, uploaded in %.2f ms\n"
+                       , watch.name.c_str(), ms);
+            }
+        }
+
+        // A file that changes again mid-read is read again after.
+        if ( watch.changed && ! watch.reading.valid() )
+        {
+            watch.changed = false;
+            watch.reading = pool.Submit(watch.read);
+        }
+    }
+}
@@ -0,0 +1,41 @@
+/*
+ * Assets.cpp: Finding baked assets.
+ */
+
+#include <sys/stat.h>
+#include "Assets.h"
+#include "MappedFile.h"
+
+std::string
+Asset_Name(const char *source, const char *extension, const char *dir)
+{
+    std::string name(source);
+    size_t      dot = name.find_last_of('.');
+    size_t      slash = name.find_last_of("/\\");
+
+    if ( dot != std::string::npos && ( slash == std::string::npos || dot > slash ) )
+        name.erase(dot);
+    if ( dir && dir[0] )
+    {
+        if ( slash != std::string::npos )
+            name.erase(0, slash + 1);
+        name = std::string(dir) + "/" + name;
+    }
+    return name + extension;
+}
+
+
+bool
+Source_Matches(const char *source, uint64_t size, int64_t mtime, uint64_t hash)
+{
+    struct stat st;
+
+    if ( stat(source, &st) != 0 )
+        return true;
+    if ( (uint64_t)st.st_size == size && (int64_t)st.st_mtime == mtime )
+        return true;
+
+    // The timestamp moved, but the contents may not have.
+    MappedFile  file;
+    return file.Open(source) && file.Size() == size && file.Hash() == hash;
+}
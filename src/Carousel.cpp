@@ -7,12 +7,15 @@
 #include <FL/math.h>
 #include <GL/glu.h>
 #include <cmath>
+#include <cstddef>
 #include <stdio.h>
 #include <iostream>
 #include <math.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
 #include "Carousel.h"
-#include "GenericException.h"
-#include "objloader.h"
+#include "CompiledMesh.h"
+#include "MeshShader.h"
 #include "libtarga.h"
 //#include "TargaImage.h"
 
@@ -22,17 +25,33 @@ Carousel::~Carousel(void)
     if ( initialized )
     {
         glDeleteLists(track_list, 1);
-        glDeleteBuffers(1, &vertexbuffer);
-        glDeleteBuffers(1, &uvbuffer);
-        glDeleteBuffers(1, &normalbuffer);
     }
 }
 
 
+// Maps the model. This touches no GL state, so it
+// can run on a loader thread ahead of Initialize().
+bool
+Carousel::Load(void)
+{
+    if ( ! horse_mesh.Loaded() && ! horse_mesh.Load("horse.obj") )
+        return false;
+    return true;
+}
+
+
 // Initializer. Would return false if anything could go wrong.
 bool
 Carousel::Initialize(void)
 {
+    // Map the model, unless Load() already did
+    if ( ! Load() )
+        return false;
+
+    // the horses are drawn with the mesh shader
+    if ( ! MeshShader::Shared().Initialize() )
+        return false;
+
     // make the spinning track
     GLUquadric* quad = gluNewQuadric();
     gluQuadricNormals(quad, GLU_SMOOTH);
@@ -74,39 +93,18 @@ Carousel::Initialize(void)
     // Destroy the quadratics object
     gluDeleteQuadric(quad);
 
-    // Load the horse model
-    if (!ObjLoader("horse.obj", horse_vertices, horse_uvs, horse_normals))
-        throw new GenericException("Carousel::C - Failed to load horse");
-
-    // vertexbuffer
-    glGenBuffers(1, &vertexbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-    glBufferData(
-        GL_ARRAY_BUFFER, 
-        horse_vertices.size() * sizeof(glm::vec3), 
-        horse_vertices.data(), 
-        GL_STATIC_DRAW
-    );
-
-    // uvbuffer
-	glGenBuffers(1, &uvbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-	glBufferData(
-        GL_ARRAY_BUFFER, 
-        horse_uvs.size() * sizeof(glm::vec2), 
-        horse_uvs.data(), 
-        GL_STATIC_DRAW
-    );
-
-    // normalbuffer
-	glGenBuffers(1, &normalbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-	glBufferData(
-        GL_ARRAY_BUFFER, 
-        horse_normals.size() * sizeof(glm::vec3), 
-        horse_normals.data(), 
-        GL_STATIC_DRAW
-    );
+    // vertex and index buffers, with the vertices packed to half size
+    if ( ! horse_buffer.Upload(horse_mesh, VERTEX_PACKED) )
+        return false;
+
+    // and every horse in one draw
+    horse_instances.Upload();
+    horse_buffer.Attach(horse_instances);
+
+    Update_Bounds();
+
+    // The GL has its own copy now
+    horse_mesh.Close();
 
     initialized = true;
 
@@ -115,55 +113,33 @@ Carousel::Initialize(void)
 
 // Draw
 void
-Carousel::Draw(void)
+Carousel::Draw(const glm::mat4 &model, RenderQueue &queue)
 {
+    if ( ! initialized )
+        return;
+
     // Draw the track
+    glm::mat4 spin = glm::rotate(model, glm::radians((float)theta), glm::vec3(0.0f, 0.0f, 1.0f));
     glPushMatrix();
-    glRotatef(theta, 0.0f, 0.0f, 1.0f);
+    glMultMatrixf(glm::value_ptr(spin));
     glCallList(track_list);
+    glPopMatrix();
 
-    // Enable client states for vertex,
-    // texture coordinate,
-    // and normal arrays
-    glEnableClientState(GL_VERTEX_ARRAY);
-    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-    glEnableClientState(GL_NORMAL_ARRAY);
-
-    // Bind the vertex buffer
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-    glVertexPointer(3, GL_FLOAT, 0, (void*)0);
-
-    // Bind the texture coordinate buffer
-    glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-    glTexCoordPointer(2, GL_FLOAT, 0, (void*)0);
-
-    // Bind the normal buffer
-    glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-    glNormalPointer(GL_FLOAT, 0, (void*)0);
-
-    // Draw the Horses
-    glColor3f(1.0f, 1.0f, 1.0f);
-
-    glPushMatrix();
-    glTranslatef(0.0f, 0.0f, 1.0f);
-
+    // Where each horse is on its column
+    horse_instances.Clear();
     for (int i = 0; i < num_horses; ++i)
     {
-        glPushMatrix();
-        glRotatef(step * i, 0.0f, 0.0f, 1.0f);
-        if (up) glTranslatef(dist, 0.0f, horse_offset * max_horse_height / 100.0f);
-        else glTranslatef(dist, 0.0f, max_horse_height - horse_offset * max_horse_height / 100.0f);
-        glDrawArrays(GL_TRIANGLES, 0, horse_vertices.size());
-        glPopMatrix();
+        float height = horse_offset * max_horse_height / 100.0f;
+        if (!up) height = max_horse_height - height;
+
+        glm::mat4 horse = glm::rotate(glm::mat4(1.0f), glm::radians((float)( step * i )), glm::vec3(0.0f, 0.0f, 1.0f));
+        horse = glm::translate(horse, glm::vec3((float)dist, 0.0f, height));
+        horse_instances.Add(horse);
     }
-    
-    glPopMatrix();  // translating horses upwards
-    glPopMatrix();  // global rotation
-
-    // Disable client states
-    glDisableClientState(GL_VERTEX_ARRAY);
-    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-    glDisableClientState(GL_NORMAL_ARRAY);
+
+    // Draw the Horses, all at once, translated upwards
+    queue.Submit(horse_buffer, nullptr, glm::translate(spin, glm::vec3(0.0f, 0.0f, 1.0f))
+                , glm::vec4(1.0f), horse_instances, false);
 }
 
 
@@ -187,3 +163,40 @@ Carousel::Update(float dt)
 }
 
 
+// The mapping is only held until Initialize() has uploaded it.
+void
+Carousel::Print_Stats(FILE *out) const
+{
+    horse_buffer.Print_Stats(out, "horse.obj", horse_mesh.Loaded() ? horse_mesh.Resident_Bytes() : 0);
+}
+
+
+// Around the base, column and roof, and the ring the horses sweep out
+// between their lowest and highest.
+void
+Carousel::Update_Bounds(void)
+{
+    BoundingSphere  horse = horse_buffer.Bounds();
+    float           top = (float)( base_height + column_height + roof_height );
+    BoundingSphere  frame = { glm::vec3(0.0f, 0.0f, top * 0.5f)
+                            , glm::length(glm::vec2(radius, top * 0.5f)) };
+    BoundingSphere  ring = { glm::vec3(0.0f, 0.0f, 1.0f + horse.centre.z + max_horse_height * 0.5f)
+                           , (float)( dist + max_horse_height * 0.5f )
+                             + glm::length(glm::vec2(horse.centre.x, horse.centre.y)) + horse.radius };
+    bounds = Bounding_Union(frame, ring);
+}
+
+
+// A rebaked model is mapped on the watcher's thread and uploaded into the
+// same buffers.
+void
+Carousel::Watch(AssetWatcher &watcher)
+{
+    watcher.Watch(CompiledMesh::Cache_Name("horse.obj")
+                 , [this] { return horse_mesh.Load("horse.obj"); }
+                 , [this] {
+                       horse_buffer.Upload(horse_mesh, VERTEX_PACKED);
+                       horse_mesh.Close();
+                       Update_Bounds();
+                   });
+}
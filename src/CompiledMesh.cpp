@@ -0,0 +1,276 @@
+/*
+ * CompiledMesh.cpp: Compiled meshes (.pmesh files).
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "Assets.h"
+#include "CompiledMesh.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "objloader.h"
+
+static_assert(sizeof(Vertex) == 8 * sizeof(float), "Vertex must be tightly packed");
+static_assert(sizeof(PMeshHeader) == 160, "PMeshHeader must not have padding");
+
+// How much worse the vertex cache may get for less overdraw.
+const float MESH_OVERDRAW_THRESHOLD = 1.05f;
+
+static size_t
+Align_4(size_t n)
+{
+    return ( n + 3 ) & ~(size_t)3;
+}
+
+
+std::string
+CompiledMesh::Cache_Name(const char *obj_filename, const char *dir)
+{
+    return Asset_Name(obj_filename, ".pmesh", dir);
+}
+
+
+bool
+CompiledMesh::Compile(const char *obj_filename, std::vector<char> &out)
+{
+    std::vector<Vertex>         vertices;
+    std::vector<unsigned int>   indices;
+    MappedFile                  source;
+    struct stat                 st;
+
+    if ( ! source.Open(obj_filename) || stat(obj_filename, &st) != 0 )
+    {
+        fprintf(stderr, "CompiledMesh::Compile: Couldn't read %s\n", obj_filename);
+        return false;
+    }
+    if ( ! ObjLoader(obj_filename, vertices, indices) )
+        return false;
+
+    // Order the full mesh for the vertex cache, then simplify it and order
+    // each level the same way. The vertices go in the order the full mesh
+    // first uses them.
+    MeshCacheStats  before = Mesh_Cache_Stats(indices, vertices.size());
+    std::vector<MeshLod> lods;
+
+    Optimize_Vertex_Cache(indices, vertices.size());
+    Optimize_Overdraw(vertices, indices, MESH_OVERDRAW_THRESHOLD);
+    Build_Lod_Chain(vertices, indices, PMESH_MAX_LODS, lods);
+
+    MeshCacheStats  after = Mesh_Cache_Stats(lods[0].indices, vertices.size());
+
+    indices.clear();
+    for ( auto &lod : lods )
+    {
+        if ( &lod != &lods[0] )
+            Optimize_Vertex_Cache(lod.indices, vertices.size());
+        indices.insert(indices.end(), lod.indices.begin(), lod.indices.end());
+    }
+    Optimize_Vertex_Fetch(vertices, indices);
+
+    fprintf(stderr, "CompiledMesh::Compile: %s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n"
+           , obj_filename, before.acmr, after.acmr, before.atvr, after.atvr);
+
+    PMeshHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "PMSH", 4);
+    header.version = PMESH_VERSION;
+    header.source_hash = source.Hash();
+    header.source_size = source.Size();
+    header.source_mtime = (int64_t)st.st_mtime;
+    header.num_vertices = (uint32_t)vertices.size();
+    header.num_indices = (uint32_t)indices.size();
+    header.index_size = vertices.size() > 0xFFFF ? 4 : 2;
+    header.vertex_size = sizeof(Vertex);
+
+    header.num_lods = (uint32_t)lods.size();
+    for ( uint32_t i = 0, first = 0 ; i < header.num_lods ; i++ )
+    {
+        header.lods[i].first_index = first;
+        header.lods[i].num_indices = (uint32_t)lods[i].indices.size();
+        header.lods[i].error = lods[i].error;
+        first += header.lods[i].num_indices;
+
+        fprintf(stderr, "CompiledMesh::Compile: %s: LOD %u, %u triangles, error %.4f\n"
+               , obj_filename, i, header.lods[i].num_indices / 3, header.lods[i].error);
+    }
+
+    // bounding box
+    glm::vec3 lo(0.0f), hi(0.0f);
+    if ( ! vertices.empty() )
+        lo = hi = vertices[0].pos;
+    for ( auto &vertex : vertices )
+    {
+        lo = glm::min(lo, vertex.pos);
+        hi = glm::max(hi, vertex.pos);
+    }
+    for ( int j = 0 ; j < 3 ; j++ )
+    {
+        header.bounds_min[j] = lo[j];
+        header.bounds_max[j] = hi[j];
+    }
+
+    header.vertex_offset = sizeof(PMeshHeader);
+    header.index_offset = Align_4(header.vertex_offset + vertices.size() * sizeof(Vertex));
+
+    out.assign(Align_4(header.index_offset + indices.size() * header.index_size), 0);
+    memcpy(out.data(), &header, sizeof(header));
+    memcpy(out.data() + header.vertex_offset, vertices.data(), vertices.size() * sizeof(Vertex));
+    if ( header.index_size == 2 )
+    {
+        uint16_t *dst = (uint16_t*)( out.data() + header.index_offset );
+        for ( size_t i = 0 ; i < indices.size() ; i++ )
+            dst[i] = (uint16_t)indices[i];
+    }
+    else
+        memcpy(out.data() + header.index_offset, indices.data(), indices.size() * 4);
+
+    return true;
+}
+
+
+bool
+CompiledMesh::Compile(const char *obj_filename, const char *pmesh_filename)
+{
+    std::vector<char> image;
+    if ( ! Compile(obj_filename, image) )
+        return false;
+
+    return MappedFile::Write(pmesh_filename, image.data(), image.size());
+}
+
+
+bool
+CompiledMesh::Validate(const char *data, size_t size)
+{
+    const PMeshHeader *h = (const PMeshHeader*)data;
+
+    if ( size < sizeof(PMeshHeader)
+      || memcmp(h->magic, "PMSH", 4) != 0
+      || h->version != PMESH_VERSION
+      || h->vertex_size != sizeof(Vertex)
+      || ( h->index_size != 2 && h->index_size != 4 )
+      || h->vertex_offset % 4 || h->index_offset % 4
+      || h->vertex_offset + (uint64_t)h->num_vertices * h->vertex_size > size
+      || h->index_offset + (uint64_t)h->num_indices * h->index_size > size
+      || h->num_lods == 0 || h->num_lods > PMESH_MAX_LODS )
+        return false;
+
+    for ( uint32_t i = 0 ; i < h->num_lods ; i++ )
+        if ( (uint64_t)h->lods[i].first_index + h->lods[i].num_indices > h->num_indices )
+            return false;
+
+    // Every index has to name a vertex, or a stale or corrupt file would
+    // have the GPU fetch past the end of the vertex buffer.
+    const char  *indices = data + h->index_offset;
+    for ( uint32_t i = 0 ; i < h->num_indices ; i++ )
+    {
+        uint32_t    index;
+
+        if ( h->index_size == 2 )
+            index = ( (const uint16_t*)indices )[i];
+        else
+            index = ( (const uint32_t*)indices )[i];
+        if ( index >= h->num_vertices )
+            return false;
+    }
+
+    header = h;
+    return true;
+}
+
+
+bool
+CompiledMesh::Open(const char *pmesh_filename)
+{
+    Close();
+
+    if ( ! file.Open(pmesh_filename) )
+        return false;
+    if ( ! Validate(file.Data(), file.Size()) )
+    {
+        file.Close();
+        return false;
+    }
+    return true;
+}
+
+
+void
+CompiledMesh::Close(void)
+{
+    file.Close();
+    blob.clear();
+    blob.shrink_to_fit();
+    header = nullptr;
+}
+
+
+bool
+CompiledMesh::Load(const char *obj_filename)
+{
+    std::string cache = Cache_Name(obj_filename);
+    struct stat st;
+    bool        have_source = stat(obj_filename, &st) == 0;
+
+    if ( Open(cache.c_str()) )
+    {
+        if ( Matches(obj_filename) )
+            return true;
+        Close();
+    }
+
+    if ( ! have_source )
+    {
+        fprintf(stderr, "CompiledMesh::Load: Neither %s nor %s exists\n"
+               , obj_filename, cache.c_str());
+        return false;
+    }
+
+    fprintf(stderr, "CompiledMesh::Load: Compiling %s\n", cache.c_str());
+    std::vector<char> image;
+    if ( ! Compile(obj_filename, image) )
+        return false;
+    if ( MappedFile::Write(cache.c_str(), image.data(), image.size()) && Open(cache.c_str()) )
+        return true;
+
+    // We can't write the cache; keep the compiled copy in memory.
+    blob = std::move(image);
+    return Validate(blob.data(), blob.size());
+}
+
+
+bool
+CompiledMesh::Matches(const char *obj_filename) const
+{
+    return Source_Matches(obj_filename, header->source_size, header->source_mtime
+                         , header->source_hash);
+}
+
+
+const Vertex*
+CompiledMesh::Vertices(void) const
+{
+    return (const Vertex*)( (const char*)header + header->vertex_offset );
+}
+
+
+const void*
+CompiledMesh::Indices(void) const
+{
+    return (const char*)header + header->index_offset;
+}
+
+
+glm::vec3
+CompiledMesh::Bounds_Min(void) const
+{
+    return glm::vec3(header->bounds_min[0], header->bounds_min[1], header->bounds_min[2]);
+}
+
+
+glm::vec3
+CompiledMesh::Bounds_Max(void) const
+{
+    return glm::vec3(header->bounds_max[0], header->bounds_max[1], header->bounds_max[2]);
+}
@@ -0,0 +1,462 @@
+/*
+ * CompiledTexture.cpp: Baked textures (.ptex files).
+ *
+ * The block compressors are simple range fits: the endpoints are the two
+ * pixels furthest apart along the block's principal axis, and each pixel
+ * takes the nearest of the colours between them. That is well short of
+ * what a texture tool gets out of BC1, but it is fast, and the grass and
+ * photos this program draws don't show the difference.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "Assets.h"
+#include "CompiledTexture.h"
+#include "TgaImage.h"
+
+static_assert(sizeof(PTexHeader) == 432, "PTexHeader must not have padding");
+
+static size_t
+Align_4(size_t n)
+{
+    return ( n + 3 ) & ~(size_t)3;
+}
+
+
+// Halves an image with a 2x2 box filter. A side of 1 stays 1, and the last
+// row or column of an odd side is dropped, as glGenerateMipmap does.
+static void
+Downsample(const std::vector<uint8_t> &src, uint32_t width, uint32_t height, uint32_t channels
+          , std::vector<uint8_t> &dst)
+{
+    uint32_t    w = width > 1 ? width / 2 : 1;
+    uint32_t    h = height > 1 ? height / 2 : 1;
+    uint32_t    dx = width > 1 ? channels : 0;
+    uint32_t    dy = height > 1 ? width * channels : 0;
+
+    dst.resize((size_t)w * h * channels);
+    for ( uint32_t y = 0 ; y < h ; y++ )
+    {
+        const uint8_t   *row = &src[(size_t)( height > 1 ? y * 2 : 0 ) * width * channels];
+        uint8_t         *out = &dst[(size_t)y * w * channels];
+
+        for ( uint32_t x = 0 ; x < w ; x++ )
+        {
+            const uint8_t *p = row + ( width > 1 ? x * 2 : 0 ) * channels;
+
+            for ( uint32_t c = 0 ; c < channels ; c++ )
+                *out++ = (uint8_t)( ( p[c] + p[c + dx] + p[c + dy] + p[c + dx + dy] + 2 ) / 4 );
+        }
+    }
+}
+
+
+static uint16_t
+Pack_565(const float *c)
+{
+    int r = (int)( c[0] * 31.0f / 255.0f + 0.5f );
+    int g = (int)( c[1] * 63.0f / 255.0f + 0.5f );
+    int b = (int)( c[2] * 31.0f / 255.0f + 0.5f );
+
+    r = r < 0 ? 0 : r > 31 ? 31 : r;
+    g = g < 0 ? 0 : g > 63 ? 63 : g;
+    b = b < 0 ? 0 : b > 31 ? 31 : b;
+    return (uint16_t)( ( r << 11 ) | ( g << 5 ) | b );
+}
+
+static void
+Unpack_565(uint16_t packed, int *c)
+{
+    int r = packed >> 11, g = ( packed >> 5 ) & 0x3F, b = packed & 0x1F;
+
+    c[0] = ( r << 3 ) | ( r >> 2 );
+    c[1] = ( g << 2 ) | ( g >> 4 );
+    c[2] = ( b << 3 ) | ( b >> 2 );
+}
+
+static void
+Put_16(uint8_t *out, uint32_t value)
+{
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)( value >> 8 );
+}
+
+
+// Compresses the colour of a 4x4 block of RGBA pixels into 8 bytes, always
+// in the 4 colour mode, which is the only one BC3 has.
+static void
+Encode_Color_Block(const uint8_t block[16][4], uint8_t *out)
+{
+    float   mean[3] = { 0.0f, 0.0f, 0.0f };
+    float   cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+    for ( int i = 0 ; i < 16 ; i++ )
+        for ( int c = 0 ; c < 3 ; c++ )
+            mean[c] += block[i][c] / 16.0f;
+    for ( int i = 0 ; i < 16 ; i++ )
+    {
+        float r = block[i][0] - mean[0], g = block[i][1] - mean[1], b = block[i][2] - mean[2];
+
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+
+    // The principal axis, by a few rounds of power iteration.
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for ( int round = 0 ; round < 4 ; round++ )
+    {
+        float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        float m = fabsf(x) > fabsf(y) ? fabsf(x) : fabsf(y);
+
+        m = fabsf(z) > m ? fabsf(z) : m;
+        if ( m == 0.0f )
+            break;          // a flat block; any axis will do
+        axis[0] = x / m; axis[1] = y / m; axis[2] = z / m;
+    }
+
+    int     lo = 0, hi = 0;
+    float   lo_d = 0.0f, hi_d = 0.0f;
+    for ( int i = 0 ; i < 16 ; i++ )
+    {
+        float d = ( block[i][0] - mean[0] ) * axis[0] + ( block[i][1] - mean[1] ) * axis[1]
+                + ( block[i][2] - mean[2] ) * axis[2];
+
+        if ( i == 0 || d < lo_d ) { lo = i; lo_d = d; }
+        if ( i == 0 || d > hi_d ) { hi = i; hi_d = d; }
+    }
+
+    float       ends[2][3];
+    for ( int c = 0 ; c < 3 ; c++ )
+    {
+        ends[0][c] = block[hi][c];
+        ends[1][c] = block[lo][c];
+    }
+    uint16_t    c0 = Pack_565(ends[0]);
+    uint16_t    c1 = Pack_565(ends[1]);
+    uint32_t    indices = 0;
+
+    // Colour 0 has to be the larger, or it would mean the 3 colour mode.
+    if ( c0 < c1 )
+    {
+        uint16_t t = c0;
+        c0 = c1;
+        c1 = t;
+    }
+
+    if ( c0 != c1 )
+    {
+        int palette[4][3];
+
+        Unpack_565(c0, palette[0]);
+        Unpack_565(c1, palette[1]);
+        for ( int c = 0 ; c < 3 ; c++ )
+        {
+            palette[2][c] = ( 2 * palette[0][c] + palette[1][c] ) / 3;
+            palette[3][c] = ( palette[0][c] + 2 * palette[1][c] ) / 3;
+        }
+
+        for ( int i = 0 ; i < 16 ; i++ )
+        {
+            int best = 0, best_d = 0;
+
+            for ( int j = 0 ; j < 4 ; j++ )
+            {
+                int r = block[i][0] - palette[j][0];
+                int g = block[i][1] - palette[j][1];
+                int b = block[i][2] - palette[j][2];
+                int d = r * r + g * g + b * b;
+
+                if ( j == 0 || d < best_d )
+                {
+                    best = j;
+                    best_d = d;
+                }
+            }
+            indices |= (uint32_t)best << ( i * 2 );
+        }
+    }
+
+    Put_16(out, c0);
+    Put_16(out + 2, c1);
+    Put_16(out + 4, indices & 0xFFFF);
+    Put_16(out + 6, indices >> 16);
+}
+
+// Compresses the alpha of a 4x4 block into 8 bytes, in the 8 value mode.
+static void
+Encode_Alpha_Block(const uint8_t block[16][4], uint8_t *out)
+{
+    int         a0 = block[0][3], a1 = block[0][3];
+    uint64_t    indices = 0;
+
+    for ( int i = 1 ; i < 16 ; i++ )
+    {
+        a0 = block[i][3] > a0 ? block[i][3] : a0;
+        a1 = block[i][3] < a1 ? block[i][3] : a1;
+    }
+
+    if ( a0 != a1 )
+    {
+        int values[8] = { a0, a1 };
+
+        for ( int j = 1 ; j < 7 ; j++ )
+            values[j + 1] = ( ( 7 - j ) * a0 + j * a1 ) / 7;
+
+        for ( int i = 0 ; i < 16 ; i++ )
+        {
+            int best = 0, best_d = 256;
+
+            for ( int j = 0 ; j < 8 ; j++ )
+            {
+                int d = abs(block[i][3] - values[j]);
+                if ( d < best_d )
+                {
+                    best = j;
+                    best_d = d;
+                }
+            }
+            indices |= (uint64_t)best << ( i * 3 );
+        }
+    }
+
+    out[0] = (uint8_t)a0;
+    out[1] = (uint8_t)a1;
+    for ( int i = 0 ; i < 6 ; i++ )
+        out[2 + i] = (uint8_t)( indices >> ( i * 8 ) );
+}
+
+// Compresses a whole level. Blocks hanging off the edge repeat the last
+// row and column.
+static void
+Compress(const std::vector<uint8_t> &pixels, uint32_t width, uint32_t height, uint32_t channels
+        , PTexFormat format, uint8_t *out)
+{
+    uint8_t block[16][4];
+
+    for ( uint32_t by = 0 ; by < height ; by += 4 )
+        for ( uint32_t bx = 0 ; bx < width ; bx += 4 )
+        {
+            for ( uint32_t i = 0 ; i < 16 ; i++ )
+            {
+                uint32_t x = bx + i % 4 < width ? bx + i % 4 : width - 1;
+                uint32_t y = by + i / 4 < height ? by + i / 4 : height - 1;
+                const uint8_t *p = &pixels[( (size_t)y * width + x ) * channels];
+
+                block[i][0] = p[0];
+                block[i][1] = p[1];
+                block[i][2] = p[2];
+                block[i][3] = channels == 4 ? p[3] : 0xFF;
+            }
+
+            if ( format == PTEX_BC3 )
+            {
+                Encode_Alpha_Block(block, out);
+                out += 8;
+            }
+            Encode_Color_Block(block, out);
+            out += 8;
+        }
+}
+
+static size_t
+Level_Size(uint32_t width, uint32_t height, PTexFormat format)
+{
+    size_t blocks = (size_t)( ( width + 3 ) / 4 ) * ( ( height + 3 ) / 4 );
+
+    switch ( format )
+    {
+      case PTEX_BC1:
+        return blocks * 8;
+      case PTEX_BC3:
+        return blocks * 16;
+      default:
+        return (size_t)width * height * 3;
+    }
+}
+
+
+std::string
+CompiledTexture::Cache_Name(const char *tga_filename, const char *dir)
+{
+    return Asset_Name(tga_filename, ".ptex", dir);
+}
+
+std::string
+CompiledTexture::Plain_Name(const char *tga_filename, const char *dir)
+{
+    return Asset_Name(tga_filename, ".rgb.ptex", dir);
+}
+
+
+bool
+CompiledTexture::Compile(const char *tga_filename, PTexFormat format, std::vector<char> &out)
+{
+    MappedFile      source;
+    struct stat     st;
+    TgaImage        image;
+    uint32_t        channels = format == PTEX_BC3 ? 4 : 3;
+
+    if ( ! source.Open(tga_filename) || stat(tga_filename, &st) != 0 )
+    {
+        fprintf(stderr, "CompiledTexture::Compile: Couldn't read %s\n", tga_filename);
+        return false;
+    }
+    if ( ! image.Load(tga_filename, channels == 4 ? TGA_TRUECOLOR_32 : TGA_TRUECOLOR_24) )
+        return false;
+
+    PTexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "PTEX", 4);
+    header.version = PTEX_VERSION;
+    header.source_hash = source.Hash();
+    header.source_size = source.Size();
+    header.source_mtime = (int64_t)st.st_mtime;
+    header.width = (uint32_t)image.Width();
+    header.height = (uint32_t)image.Height();
+    header.format = format;
+
+    // Lay the levels out first, biggest to smallest.
+    uint64_t offset = sizeof(PTexHeader);
+    for ( uint32_t w = header.width, h = header.height ; ; w = w > 1 ? w / 2 : 1, h = h > 1 ? h / 2 : 1 )
+    {
+        if ( header.num_levels == PTEX_MAX_LEVELS )
+        {
+            fprintf(stderr, "CompiledTexture::Compile: %s is too big\n", tga_filename);
+            return false;
+        }
+
+        PTexLevel &level = header.levels[header.num_levels++];
+        level.width = w;
+        level.height = h;
+        level.offset = offset;
+        level.size = Level_Size(w, h, format);
+        offset = Align_4(offset + level.size);
+
+        if ( w == 1 && h == 1 )
+            break;
+    }
+
+    out.assign(offset, 0);
+    memcpy(out.data(), &header, sizeof(header));
+
+    std::vector<uint8_t>    pixels(image.Data(), image.Data() + (size_t)image.Width() * image.Height() * channels);
+    std::vector<uint8_t>    smaller;
+
+    image.Free();
+    for ( uint32_t i = 0 ; i < header.num_levels ; i++ )
+    {
+        const PTexLevel &level = header.levels[i];
+        uint8_t         *dst = (uint8_t*)out.data() + level.offset;
+
+        if ( i > 0 )
+        {
+            const PTexLevel &above = header.levels[i - 1];
+            Downsample(pixels, above.width, above.height, channels, smaller);
+            pixels.swap(smaller);
+        }
+
+        if ( format == PTEX_RGB8 )
+            memcpy(dst, pixels.data(), level.size);
+        else
+            Compress(pixels, level.width, level.height, channels, format, dst);
+    }
+
+    return true;
+}
+
+
+bool
+CompiledTexture::Compile(const char *tga_filename, PTexFormat format, const char *ptex_filename)
+{
+    std::vector<char> image;
+    if ( ! Compile(tga_filename, format, image) )
+        return false;
+
+    return MappedFile::Write(ptex_filename, image.data(), image.size());
+}
+
+
+bool
+CompiledTexture::Validate(const char *data, size_t size)
+{
+    const PTexHeader *h = (const PTexHeader*)data;
+
+    if ( size < sizeof(PTexHeader)
+      || memcmp(h->magic, "PTEX", 4) != 0
+      || h->version != PTEX_VERSION
+      || h->format > PTEX_BC3
+      || h->num_levels == 0 || h->num_levels > PTEX_MAX_LEVELS )
+        return false;
+
+    for ( uint32_t i = 0 ; i < h->num_levels ; i++ )
+    {
+        const PTexLevel &level = h->levels[i];
+
+        if ( level.size != Level_Size(level.width, level.height, (PTexFormat)h->format)
+          || level.offset > size || level.size > size - level.offset )
+            return false;
+    }
+
+    header = h;
+    return true;
+}
+
+
+bool
+CompiledTexture::Open(const char *ptex_filename)
+{
+    Close();
+
+    if ( ! file.Open(ptex_filename) )
+        return false;
+    if ( ! Validate(file.Data(), file.Size()) )
+    {
+        file.Close();
+        return false;
+    }
+    return true;
+}
+
+
+void
+CompiledTexture::Close(void)
+{
+    file.Close();
+    header = nullptr;
+}
+
+
+bool
+CompiledTexture::Load(const char *tga_filename, bool plain)
+{
+    std::string cache = plain ? Plain_Name(tga_filename) : Cache_Name(tga_filename);
+
+    if ( ! Open(cache.c_str()) )
+        return false;
+    if ( Matches(tga_filename) )
+        return true;
+
+    fprintf(stderr, "CompiledTexture::Load: %s is out of date\n", cache.c_str());
+    Close();
+    return false;
+}
+
+
+bool
+CompiledTexture::Matches(const char *tga_filename) const
+{
+    return Source_Matches(tga_filename, header->source_size, header->source_mtime
+                         , header->source_hash);
+}
+
+
+const void*
+CompiledTexture::Level_Data(uint32_t i) const
+{
+    return (const char*)header + header->levels[i].offset;
+}
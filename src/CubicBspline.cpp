@@ -5,41 +5,57 @@
  */
 
 #include <math.h>
+#include <utility>
 #include "CubicBspline.h"
 #include "GenericException.h"
+#include "SplineKernels.h"
 
 
-/* Initializes with the given dimension and control points. */
-CubicBspline::CubicBspline(const unsigned short dim, const unsigned short num,
-                           float **c_in, const bool l)
+/* Initializes with the given control points. */
+template <unsigned short Dim>
+CubicBspline<Dim>::CubicBspline(const unsigned int num, float **c_in,
+				const bool l)
 {
-    d = dim;
     n = num;
 
     Copy_Controls(c_in);
 
     loop = l;
+    arc_steps = 0;
+    arc_length = 0.0f;
 }
 
 
-/* Destructor. */
-CubicBspline::~CubicBspline(void)
+/* Move constructor. Takes the control points. */
+template <unsigned short Dim>
+CubicBspline<Dim>::CubicBspline(CubicBspline &&src) noexcept
+    : n(src.n), c_pts(std::move(src.c_pts)), loop(src.loop)
+    , arc_s(std::move(src.arc_s)), arc_t(std::move(src.arc_t))
+    , arc_steps(src.arc_steps), arc_length(src.arc_length)
 {
-    Delete_Controls();
+    src.n = 0;
+    src.c_pts.clear();
+    src.Forget_Arc_Length();
 }
 
 
-/* Copy operator. */
-CubicBspline&
-CubicBspline::operator=(const CubicBspline &src)
+/* Move operator. */
+template <unsigned short Dim>
+CubicBspline<Dim>&
+CubicBspline<Dim>::operator=(CubicBspline &&src) noexcept
 {
     if ( this != &src )
     {
-	Delete_Controls();
-	d = src.d;
 	n = src.n;
-	Copy_Controls(src.c_pts);
+	c_pts = std::move(src.c_pts);
 	loop = src.loop;
+	arc_s = std::move(src.arc_s);
+	arc_t = std::move(src.arc_t);
+	arc_steps = src.arc_steps;
+	arc_length = src.arc_length;
+	src.n = 0;
+	src.c_pts.clear();
+	src.Forget_Arc_Length();
     }
 
     return *this;
@@ -48,22 +64,24 @@ CubicBspline::operator=(const CubicBspline &src)
 
 /* Query a control point, putting the value into the given array, pt.
 ** Throws an exception if the index is out of range. */
+template <unsigned short Dim>
 void
-CubicBspline::C(unsigned short index, float *pt)
+CubicBspline<Dim>::C(unsigned int index, float *pt)
 {
     int i;
     if ( index >= n )
 	throw new GenericException("CubicBspline::C - Index out of range");
 
-    for ( i = 0 ; i < d ; i++ )
+    for ( i = 0 ; i < Dim ; i++ )
 	pt[i] = c_pts[index][i];
 }
 
 
 /* Change a control point at the given position.
 ** Will throw an exception if the position is out of range. */
+template <unsigned short Dim>
 void
-CubicBspline::Set_Control(const float *pt, const unsigned short posn)
+CubicBspline<Dim>::Set_Control(const float *pt, const unsigned int posn)
 {
     int i;
 
@@ -71,111 +89,114 @@ CubicBspline::Set_Control(const float *pt, const unsigned short posn)
 	throw new GenericException(
 	    "CubicBspline::Set_Control - Posn out of range");
 
-    for ( i = 0 ; i < d ; i++ )
+    for ( i = 0 ; i < Dim ; i++ )
 	c_pts[posn][i] = pt[i];
+    Forget_Arc_Length();
 }
 
  
 
-/* Add a control point at the end. */
+/* Make room for the given number of control points. */
+template <unsigned short Dim>
 void
-CubicBspline::Append_Control(const float *pt)
+CubicBspline<Dim>::Reserve(const unsigned int num)
 {
-    float   **c_new = new float*[n + 1];
-    int     i;
+    c_pts.reserve(num);
+}
+
+
+/* Copies a control point in. */
+template <unsigned short Dim>
+static typename CubicBspline<Dim>::Point
+To_Point(const float *pt)
+{
+    typename CubicBspline<Dim>::Point	p;
+    int					i;
+
+    for ( i = 0 ; i < Dim ; i++ )
+	p[i] = pt[i];
+    return p;
+}
 
-    // Copy the old points over.
-    for ( i = 0 ; i < n ; i++ )
-	c_new[i] = c_pts[i];
 
-    // Add the new one.
-    c_new[n] = new float[d];
-    for ( i = 0 ; i < d ; i++ )
-	c_new[n][i] = pt[i];
+/* Add a control point at the end. The storage grows geometrically, so
+** building a curve this way is linear in its length. */
+template <unsigned short Dim>
+void
+CubicBspline<Dim>::Append_Control(const float *pt)
+{
+    if ( n >= SPLINE_MAX_CONTROLS )
+	throw new GenericException(
+	    "CubicBspline::Append_Control - Too many control points");
 
-    // Swap old for new.
-    delete[] c_pts;
-    c_pts = c_new;
+    c_pts.push_back(To_Point<Dim>(pt));
 
     // One more control pt.
     n++;
+    Forget_Arc_Length();
 }
 
 
 /* Add a control point at the given position. */
 /* Will throw an exception if the position is beyond the end of
-** the existing set of control points. */
+** the existing set of control points, or there are too many. */
+template <unsigned short Dim>
 void
-CubicBspline::Insert_Control(const float *pt, const unsigned short posn)
+CubicBspline<Dim>::Insert_Control(const float *pt, const unsigned int posn)
 {
-    float   **c_new = new float*[n + 1];
-    int     i;
-
     if ( posn > n )
 	throw new GenericException(
 	    "CubicBspline::Insert_Control - Posn out of range");
+    if ( n >= SPLINE_MAX_CONTROLS )
+	throw new GenericException(
+	    "CubicBspline::Insert_Control - Too many control points");
 
-    // Copy some points over.
-    for ( i = 0 ; i < posn ; i++ )
-	c_new[i] = c_pts[i];
-
-    // Add the new one.
-    c_new[posn] = new float[d];
-    for ( i = 0 ; i < d ; i++ )
-	c_new[posn][i] = pt[i];
-
-    // Copy the rest of the points over.
-    for ( i = posn ; i < n ; i++ )
-	c_new[i+1] = c_pts[i];
-
-    // Swap old for new.
-    delete[] c_pts;
-    c_pts = c_new;
+    // The rest of the points move up to make room.
+    c_pts.insert(c_pts.begin() + posn, To_Point<Dim>(pt));
 
     // One more control pt.
     n++;
+    Forget_Arc_Length();
 }
 
 
 /* Remove a control point at the given position. */
 /* Will throw an exception the position is out of range. */
+template <unsigned short Dim>
 void
-CubicBspline::Delete_Control(const unsigned short posn)
+CubicBspline<Dim>::Delete_Control(const unsigned int posn)
 {
-    int i;
-
     if ( posn >= n )
 	throw new GenericException(
 	    "CubicBspline::Delete_Control - Posn out of range");
 
-    // Get rid of the undesired control point
-    delete[] c_pts[posn];
-
-    // Copy the rest of the points down.
-    for ( i = posn ; i < n - 1 ; i++ )
-	c_pts[i] = c_pts[i+1];
+    // Get rid of the undesired control point, moving the rest down.
+    c_pts.erase(c_pts.begin() + posn);
 
     // One less control pt.
     n--;
+    Forget_Arc_Length();
 }
 
 
 /* Evaluate the curve at a parameter value and copy the result into
 ** the given array. Throws an exception if the parameter is out of
 ** range, unless the curve is a loop. */
+template <unsigned short Dim>
 void
-CubicBspline::Evaluate_Point(const float t, float *pt)
+CubicBspline<Dim>::Evaluate_Point(const float t, float *pt)
 {
     int     posn;
     float   u;
     float   u_sq;
     float   u_cube;
     float   basis[4];
+    Point   sum;
     int     i, j;
 
     posn = (int)floor(t);
 
-    if ( posn > n - 4 && ! loop )
+    if ( posn > (int)n - 4 && ! loop )
     {
 	throw new GenericException(
 	    "CubicBspline::EvaluatePoint - Parameter value out of range");
@@ -192,36 +213,38 @@ CubicBspline::Evaluate_Point(const float t, float *pt)
     basis[3] = u_cube;
 
     /* Sum up the control points times the basis functions for each dimension.
-    ** j loops over dimension, i loops over control point. */
-    for ( j = 0 ; j < d ; j++ )
-	pt[j] = 0.0f;
+    ** j loops over dimension, i loops over control point. The sum is kept
+    ** in registers, and only stored once it is done. */
+    sum.fill(0.0f);
     for ( i = 0 ; i < 4 ; i++ )
     {
-	int index = ( posn + i ) % n;
-	for ( j = 0 ; j < d ; j++ )
-	    pt[j] += c_pts[index][j] * basis[i];
+	const Point &c = c_pts[( posn + i ) % (int)n];
+	for ( j = 0 ; j < Dim ; j++ )
+	    sum[j] += c[j] * basis[i];
     }
     /* Divide through the constant factor. */
-    for ( j = 0 ; j < d ; j++ )
-	pt[j] /= 6.0f;
+    for ( j = 0 ; j < Dim ; j++ )
+	pt[j] = sum[j] / 6.0f;
 }
 
 
 /* Evaluate the derivative at a parameter value and copy the result into
 ** the given array. Throws an exception if the parameter is out of
 ** range, unless the curve is a loop. */
+template <unsigned short Dim>
 void
-CubicBspline::Evaluate_Derivative(const float t, float *deriv)
+CubicBspline<Dim>::Evaluate_Derivative(const float t, float *deriv)
 {
     int     posn;
     float   u;
     float   u_sq;
     float   basis[4];
+    Point   sum;
     int     i, j;
 
     posn = (int)floor(t);
 
-    if ( posn > n - 4 && ! loop )
+    if ( posn > (int)n - 4 && ! loop )
     {
 	throw new GenericException(
 	    "CubicBspline::EvaluatePoint - Parameter value out of range");
@@ -238,67 +261,271 @@ CubicBspline::Evaluate_Derivative(const float t, float *deriv)
     basis[3] = 3.0f * u_sq;
 
     /* Now it's just like evaluating a point. */
-    for ( j = 0 ; j < d ; j++ )
-	deriv[j] = 0.0f;
+    sum.fill(0.0f);
     for ( i = 0 ; i < 4 ; i++ )
     {
-	int index = ( posn + i ) % n;
-	for ( j = 0 ; j < d ; j++ )
-	    deriv[j] += c_pts[index][j] * basis[i];
+	const Point &c = c_pts[( posn + i ) % (int)n];
+	for ( j = 0 ; j < Dim ; j++ )
+	    sum[j] += c[j] * basis[i];
     }
-    for ( j = 0 ; j < d ; j++ )
-	deriv[j] /= 6.0f;
+    for ( j = 0 ; j < Dim ; j++ )
+	deriv[j] = sum[j] / 6.0f;
+}
+
+
+/* Throws an exception if any of the parameter values are out of range,
+** unless the curve is a loop, as Evaluate_Point would. */
+template <unsigned short Dim>
+void
+CubicBspline<Dim>::Check_Parameters(const float *t, size_t count)
+{
+    size_t  k;
+
+    if ( loop )
+	return;
+
+    for ( k = 0 ; k < count ; k++ )
+	if ( (int)floor(t[k]) > (int)n - 4 )
+	    throw new GenericException(
+		"CubicBspline::Evaluate_Points - Parameter value out of range");
+}
+
+
+/* Evaluate the curve at many parameter values at once. */
+template <unsigned short Dim>
+void
+CubicBspline<Dim>::Evaluate_Points(const float *t, size_t count, float *pts)
+{
+    Evaluate_Derivatives(t, count, pts, NULL, NULL);
+}
+
+
+/* Evaluate the curve and its first two derivatives at many parameter
+** values at once. The kernels do it all; this only checks. The points
+** are packed, so they are the floats the kernels want. */
+template <unsigned short Dim>
+void
+CubicBspline<Dim>::Evaluate_Derivatives(const float *t, size_t count,
+					float *pts, float *first,
+					float *second)
+{
+    if ( count == 0 || n == 0 )
+	return;
+    Check_Parameters(t, count);
+
+    Spline_Get_Kernel(Spline_Kernel_Isa())(c_pts[0].data(), Dim, n, t, count,
+					   pts, first, second);
+}
+
+
+/* Five point Gauss-Legendre quadrature on [0, 1]: where to evaluate, and
+** what to weight each by. It is exact for polynomials up to degree 9, and
+** the speed along a cubic is smooth enough that a step of a span is as
+** good as exact. */
+static const int    ARC_NODES = 5;
+static const float  ARC_NODE_U[ARC_NODES] = {
+    0.0469100770f, 0.2307653449f, 0.5f, 0.7692346551f, 0.9530899230f };
+static const float  ARC_NODE_WEIGHT[ARC_NODES] = {
+    0.1184634425f, 0.2393143352f, 0.2844444444f, 0.2393143352f, 0.1184634425f };
+
+
+/* Build the arc length table. Every quadrature node on the curve is
+** evaluated in one batch. */
+template <unsigned short Dim>
+void
+CubicBspline<Dim>::Build_Arc_Length(const unsigned short steps)
+{
+    int			spans = loop ? (int)n : (int)n - 3;
+    size_t		count, i, j, k;
+    float		h;
+    std::vector<float>	t, deriv;
+
+    Forget_Arc_Length();
+    arc_steps = steps ? steps : 1;
+    arc_length = 0.0f;
+    if ( spans <= 0 )
+	return;
+
+    count = (size_t)spans * arc_steps;
+    h = 1.0f / arc_steps;
+    t.resize(count * ARC_NODES);
+    deriv.resize(count * ARC_NODES * Dim);
+    for ( i = 0 ; i < count ; i++ )
+	for ( k = 0 ; k < ARC_NODES ; k++ )
+	    t[i * ARC_NODES + k] = ( i + ARC_NODE_U[k] ) * h;
+    Evaluate_Derivatives(t.data(), t.size(), NULL, deriv.data(), NULL);
+
+    /* Distance at each step: the last plus the speed integrated over it. */
+    arc_s.resize(count + 1);
+    arc_s[0] = 0.0f;
+    for ( i = 0 ; i < count ; i++ )
+    {
+	double	step = 0.0;
+	for ( k = 0 ; k < ARC_NODES ; k++ )
+	{
+	    const float	*v = &deriv[( i * ARC_NODES + k ) * Dim];
+	    double	speed_sq = 0.0;
+	    for ( j = 0 ; j < Dim ; j++ )
+		speed_sq += v[j] * v[j];
+	    step += ARC_NODE_WEIGHT[k] * sqrt(speed_sq);
+	}
+	arc_s[i + 1] = arc_s[i] + (float)( step * h );
+    }
+    arc_length = arc_s[count];
+
+    /* The inverse, as many even steps of distance, each found by walking
+    ** along the steps of the parameter. */
+    arc_t.resize(count + 1);
+    for ( i = 0, k = 0 ; i <= count ; i++ )
+    {
+	float	target = arc_length * i / count;
+	while ( k + 1 < count && arc_s[k + 1] < target )
+	    k++;
+
+	float	run = arc_s[k + 1] - arc_s[k];
+	float	f = run > 0.0f ? ( target - arc_s[k] ) / run : 0.0f;
+	arc_t[i] = ( k + ( f < 0.0f ? 0.0f : f > 1.0f ? 1.0f : f ) ) * h;
+    }
+}
+
+
+/* Query the length of the curve. */
+template <unsigned short Dim>
+float
+CubicBspline<Dim>::Length(void)
+{
+    if ( arc_s.empty() )
+	Build_Arc_Length();
+    return arc_length;
+}
+
+
+/* Looks up x in a table of evenly spaced values spanning [0, range],
+** going round again past the end for a loop, or stopping there if not. */
+static float
+Interpolate(const std::vector<float> &table, float range, float other_range,
+	    bool loop, float x)
+{
+    size_t  steps = table.size() - 1;
+    float   laps = 0.0f;
+
+    if ( loop )
+    {
+	laps = floorf(x / range);
+	x -= laps * range;
+    }
+    else if ( x <= 0.0f )
+	return table[0];
+    else if ( x >= range )
+	return table[steps];
+
+    float   at = x / range * steps;
+    size_t  i = (size_t)at;
+    if ( i >= steps )
+	i = steps - 1;
+    float   f = at - i;
+
+    return laps * other_range + table[i] + f * ( table[i + 1] - table[i] );
+}
+
+
+/* Query the distance along the curve at a parameter value. */
+template <unsigned short Dim>
+float
+CubicBspline<Dim>::Arc_Length(const float t)
+{
+    if ( arc_s.empty() )
+	Build_Arc_Length();
+    if ( arc_s.size() < 2 )
+	return 0.0f;
+    return Interpolate(arc_s, (float)( arc_s.size() - 1 ) / arc_steps, arc_length, loop, t);
+}
+
+
+/* Query the parameter value at a distance along the curve. */
+template <unsigned short Dim>
+float
+CubicBspline<Dim>::Arc_Parameter(const float s)
+{
+    if ( arc_s.empty() )
+	Build_Arc_Length();
+    if ( arc_t.size() < 2 || arc_length <= 0.0f )
+	return 0.0f;
+    return Interpolate(arc_t, arc_length, (float)( arc_t.size() - 1 ) / arc_steps, loop, s);
 }
 
 
 /* Refine the curve, putting the result into the given curve. This
 ** will correctly account for looped curves. */
+template <unsigned short Dim>
 void
-CubicBspline::Refine(CubicBspline &result)
+CubicBspline<Dim>::Refine(CubicBspline &result)
+{
+    if ( &result != this )
+	result = *this;
+    result.Refine();
+}
+
+
+/* Refine the curve in place. Each control point makes two new ones,
+** except for the last (unless it loops), written from the end backwards
+** so that nothing is overwritten before it is read. */
+template <unsigned short Dim>
+void
+CubicBspline<Dim>::Refine(void)
 {
     int	    new_n;
-    float   **new_c;
     int     i, j, k;
 
+    if ( n == 0 )
+	return;
+    if ( n > SPLINE_MAX_CONTROLS / 2 )
+	throw new GenericException(
+	    "CubicBspline::Refine - Too many control points");
+
     /* Figure out how many new vertices. */
     if ( loop )
 	new_n = n * 2;
     else
 	new_n = n * 2 - 3;
+    if ( new_n <= 0 )
+	return;
 
-    /* This creates two new controls for each existing one, except for the
-    ** first and last control points (unless it loops.) */
-    new_c = new float*[new_n];
-    for ( i = 0, k = 0 ; i < new_n ; i+=2, k++ )
-    {
-	/* This figures out which control points to average for the new pts. */
-	int p0 = k % n;
-	int p1 = ( k + 1 ) % n;
-	int p2 = ( k + 2 ) % n;
+    /* Working down, the new points reach the old ones only at the start,
+    ** and the wrap reads the start from the end, so keep the first three
+    ** as they were. */
+    std::array<Point, 3>    first;
+    for ( j = 0 ; j < 3 && j < (int)n ; j++ )
+	first[j] = c_pts[j];
 
-	/* Allocate space for the new points. */
-	new_c[i] = new float[d];
-	if ( i + 1 < new_n )
-	    new_c[i+1] = new float[d];
+    c_pts.resize(new_n);
+    for ( k = ( new_n - 1 ) / 2 ; k >= 0 ; k-- )
+    {
+	i = k * 2;
 
-	/* Compute the new points using the refinement rules. */
-	for ( j = 0 ; j < d ; j++ )
+	/* This figures out which control points to average for the new pts. */
+	int p[3] = { k % (int)n, ( k + 1 ) % (int)n, ( k + 2 ) % (int)n };
+	const Point *c[3];
+	for ( j = 0 ; j < 3 ; j++ )
+	    c[j] = p[j] < 3 ? &first[p[j]] : &c_pts[p[j]];
+
+	/* Compute the new points using the refinement rules. Both are worked
+	** out before either is stored, because one may be where an old point
+	** still to be read is. */
+	Point	edge, vertex;
+	for ( j = 0 ; j < Dim ; j++ )
 	{
-	    new_c[i][j] = 0.5f * ( c_pts[p0][j] + c_pts[p1][j] );
-	    if ( i + 1 < new_n )
-		new_c[i+1][j] = 0.125f * ( c_pts[p0][j] + 6.0f * c_pts[p1][j]
-					 + c_pts[p2][j]);
+	    edge[j] = 0.5f * ( (*c[0])[j] + (*c[1])[j] );
+	    vertex[j] = 0.125f * ( (*c[0])[j] + 6.0f * (*c[1])[j] + (*c[2])[j] );
 	}
-    }
 
-    /* Get rid of any old control points in the result. */
-    result.Delete_Controls();
+	c_pts[i] = edge;
+	if ( i + 1 < new_n )
+	    c_pts[i + 1] = vertex;
+    }
 
-    /* Copy everything over. */
-    result.d = d;
-    result.n = new_n;
-    result.c_pts = new_c;
-    result.loop = loop;
+    n = new_n;
+    Forget_Arc_Length();
 }
 
 
@@ -306,58 +533,48 @@ CubicBspline::Refine(CubicBspline &result)
 ** tolerance. What it actually does is look at every set of three control
 ** points in turn, and checks the distance of the middle point from the
 ** line joining the other two. If the middle point is too far from the line,
-** the curve is outside the tolerence. The code is messy because it computes
-** certain vectors required for the test, and doesn't abstract them into a
-** vector class. Basically all it is doing is a bunch of vector subtractions
-** and dot products. */
+** the curve is outside the tolerence. The vectors it needs are points of
+** the curve's own dimension, so they live on the stack. */
+template <unsigned short Dim>
 bool
-CubicBspline::Within_Tolerance(const float tolerance)
+CubicBspline<Dim>::Within_Tolerance(const float tolerance)
 {
-    float   *p;
-    float   *x2_x1;
-    float   *x3_x1;
+    Point   p;
+    Point   x2_x1;
+    Point   x3_x1;
     float   l_13, l_2p, dot;
     int     i, j;
     int     m;
-    int     i1, i2, i3;
 
-    p = new float[d];
-    x2_x1 = new float[d];
-    x3_x1 = new float[d];
-
-    m = loop ? n : n - 2;
+    m = loop ? (int)n : (int)n - 2;
 
     for ( i = 0 ; i < m ; i++ )
     {
-	i1 = i % n;
-	i2 = ( i + 1 ) % n;
-	i3 = ( i + 2 ) % n;
+	const Point &x1 = c_pts[i % (int)n];
+	const Point &x2 = c_pts[( i + 1 ) % (int)n];
+	const Point &x3 = c_pts[( i + 2 ) % (int)n];
 
 	dot = 0.0f;
 	l_13 = 0.0f;
-	for ( j = 0 ; j < d ; j++ )
+	for ( j = 0 ; j < Dim ; j++ )
 	{
-	    x2_x1[j] = c_pts[i2][j] - c_pts[i1][j];
-	    x3_x1[j] = c_pts[i3][j] - c_pts[i1][j];
+	    x2_x1[j] = x2[j] - x1[j];
+	    x3_x1[j] = x3[j] - x1[j];
 	    dot += ( x2_x1[j] * x3_x1[j] );
 	    l_13 += ( x3_x1[j] * x3_x1[j] );
 	}
 	if ( l_13 == 0.0f )
 	    continue;
 	l_2p = 0.0f;
-	for ( j = 0 ; j < d ; j++ )
+	for ( j = 0 ; j < Dim ; j++ )
 	{
-	    p[j] = c_pts[i1][j] + dot * x3_x1[j] / l_13;
-	    l_2p += ( c_pts[i2][j] - p[j] ) * ( c_pts[i2][j] - p[j] );
+	    p[j] = x1[j] + dot * x3_x1[j] / l_13;
+	    l_2p += ( x2[j] - p[j] ) * ( x2[j] - p[j] );
 	}
 	if ( l_2p > tolerance * tolerance )
 	    return false;
     }
 
-    delete[] p;
-    delete[] x2_x1;
-    delete[] x3_x1;
-
     return true;
 }
 
@@ -365,8 +582,9 @@ CubicBspline::Within_Tolerance(const float tolerance)
 /* Refine a curve until it can be approximated with straight lines to within
 ** the given tolerance. Always does at least one refinement, even if the
 ** original curve is inside tolerance. */
+template <unsigned short Dim>
 void
-CubicBspline::Refine_Tolerance(CubicBspline &result, const float tolerance)
+CubicBspline<Dim>::Refine_Tolerance(CubicBspline &result, const float tolerance)
 {
     Refine(result);
     while ( ! result.Within_Tolerance(tolerance) )
@@ -374,39 +592,26 @@ CubicBspline::Refine_Tolerance(CubicBspline &result, const float tolerance)
 }
 
 
-/* Copy a set fo control points */
+/* Copy a set of control points, one array each, into the storage. */
+template <unsigned short Dim>
 void
-CubicBspline::Copy_Controls(float **c_in)
+CubicBspline<Dim>::Copy_Controls(float **c_in)
 {
-    int i, j;
-
-    if ( c_pts )
-	Delete_Controls();
+    unsigned int i;
 
-    c_pts = new float*[n];
-    for ( i = 0 ; i < n ; i++ )
-    {
-	c_pts[n] = new float[d];
-	for ( j = 0 ; j < d ; j++ )
-	    c_pts[n][d] = c_in[n][d];
-    }
-}
-
-
-/* Delete a set of control points */
-void
-CubicBspline::Delete_Controls(void)
-{
-    int i;
-
-    if ( ! c_pts )
-	return;
+    if ( n > SPLINE_MAX_CONTROLS )
+	throw new GenericException(
+	    "CubicBspline::CubicBspline - Too many control points");
 
+    c_pts.clear();
+    c_pts.reserve(n);
+    Forget_Arc_Length();
     for ( i = 0 ; i < n ; i++ )
-	delete[] c_pts[i];
-    delete[] c_pts;
-
-    c_pts = NULL;
+	c_pts.push_back(To_Point<Dim>(c_in[i]));
 }
 
 
+template class CubicBspline<1>;
+template class CubicBspline<2>;
+template class CubicBspline<3>;
+template class CubicBspline<4>;
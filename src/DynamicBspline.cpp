@@ -0,0 +1,162 @@
+/*
+ * DynamicBspline.cpp: Uniform cubic B-splines of any dimension CubicBspline
+ * is built for, chosen at run time.
+ */
+
+#include "DynamicBspline.h"
+#include "GenericException.h"
+
+
+/* Initializes with the given dimension and no control points. */
+DynamicBspline::DynamicBspline(const unsigned short dim, const bool l)
+    : d(dim), c1(l), c2(l), c3(l), c4(l)
+{
+    if ( d < 1 || d > SPLINE_MAX_DIM )
+	throw new GenericException(
+	    "DynamicBspline - Dimension out of range");
+}
+
+
+/* Initializes with the given dimension and control points. */
+DynamicBspline::DynamicBspline(const unsigned short dim,
+			       const unsigned int num, float **c_in,
+			       const bool l)
+    : DynamicBspline(dim, l)
+{
+    Reserve(num);
+    for ( unsigned int i = 0 ; i < num ; i++ )
+	Append_Control(c_in[i]);
+}
+
+
+unsigned int
+DynamicBspline::N(void)
+{
+    return With([](auto &c) { return c.N(); });
+}
+
+void
+DynamicBspline::C(unsigned int index, float *pt)
+{
+    With([&](auto &c) { c.C(index, pt); });
+}
+
+bool
+DynamicBspline::Loop(void)
+{
+    return With([](auto &c) { return c.Loop(); });
+}
+
+
+void
+DynamicBspline::Set_Control(const float *pt, const unsigned int posn)
+{
+    With([&](auto &c) { c.Set_Control(pt, posn); });
+}
+
+void
+DynamicBspline::Reserve(const unsigned int num)
+{
+    With([&](auto &c) { c.Reserve(num); });
+}
+
+void
+DynamicBspline::Append_Control(const float *pt)
+{
+    With([&](auto &c) { c.Append_Control(pt); });
+}
+
+void
+DynamicBspline::Insert_Control(const float *pt, const unsigned int posn)
+{
+    With([&](auto &c) { c.Insert_Control(pt, posn); });
+}
+
+void
+DynamicBspline::Delete_Control(const unsigned int posn)
+{
+    With([&](auto &c) { c.Delete_Control(posn); });
+}
+
+
+void
+DynamicBspline::Evaluate_Point(const float t, float *pt)
+{
+    With([&](auto &c) { c.Evaluate_Point(t, pt); });
+}
+
+void
+DynamicBspline::Evaluate_Derivative(const float t, float *deriv)
+{
+    With([&](auto &c) { c.Evaluate_Derivative(t, deriv); });
+}
+
+void
+DynamicBspline::Evaluate_Points(const float *t, size_t count, float *pts)
+{
+    With([&](auto &c) { c.Evaluate_Points(t, count, pts); });
+}
+
+void
+DynamicBspline::Evaluate_Derivatives(const float *t, size_t count,
+				     float *pts, float *first, float *second)
+{
+    With([&](auto &c) { c.Evaluate_Derivatives(t, count, pts, first, second); });
+}
+
+
+/* Copies this curve into the result, whatever its dimension was, and
+** refines it there. */
+void
+DynamicBspline::Refine(DynamicBspline &result)
+{
+    if ( &result != this )
+	result = *this;
+    result.Refine();
+}
+
+void
+DynamicBspline::Refine_Tolerance(DynamicBspline &result, const float tolerance)
+{
+    if ( &result != this )
+	result = DynamicBspline(d, Loop());
+
+    switch ( d )
+    {
+	case 1: c1.Refine_Tolerance(result.c1, tolerance); break;
+	case 2: c2.Refine_Tolerance(result.c2, tolerance); break;
+	case 4: c4.Refine_Tolerance(result.c4, tolerance); break;
+	default: c3.Refine_Tolerance(result.c3, tolerance); break;
+    }
+}
+
+void
+DynamicBspline::Refine(void)
+{
+    With([](auto &c) { c.Refine(); });
+}
+
+
+void
+DynamicBspline::Build_Arc_Length(const unsigned short steps)
+{
+    With([&](auto &c) { c.Build_Arc_Length(steps); });
+}
+
+float
+DynamicBspline::Length(void)
+{
+    return With([](auto &c) { return c.Length(); });
+}
+
+float
+DynamicBspline::Arc_Length(const float t)
+{
+    return With([&](auto &c) { return c.Arc_Length(t); });
+}
+
+float
+DynamicBspline::Arc_Parameter(const float s)
+{
+    return With([&](auto &c) { return c.Arc_Parameter(s); });
+}
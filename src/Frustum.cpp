@@ -0,0 +1,153 @@
+/*
+ * Frustum.cpp: The camera's view volume, for culling.
+ */
+
+#include <algorithm>
+#include "Frustum.h"
+
+// SSE2 is part of x86-64, so the batch test needs no check for it.
+#if defined(__x86_64__) || defined(_M_X64)
+#define FRUSTUM_SSE 1
+#include <immintrin.h>
+#endif
+
+
+BoundingSphere
+Bounding_Union(const BoundingSphere &a, const BoundingSphere &b)
+{
+    glm::vec3   between = b.centre - a.centre;
+    float       d = glm::length(between);
+
+    // One inside the other
+    if ( d + b.radius <= a.radius )
+        return a;
+    if ( d + a.radius <= b.radius )
+        return b;
+
+    // Otherwise, from the far side of one to the far side of the other
+    BoundingSphere  both;
+    both.radius = ( d + a.radius + b.radius ) * 0.5f;
+    both.centre = a.centre + between * ( ( both.radius - a.radius ) / d );
+    return both;
+}
+
+
+BoundingSphere
+Bounding_Transform(const glm::mat4 &m, const BoundingSphere &sphere)
+{
+    BoundingSphere  placed;
+    float           scale = std::max(glm::length(glm::vec3(m[0].x, m[0].y, m[0].z))
+                                    , std::max(glm::length(glm::vec3(m[1].x, m[1].y, m[1].z))
+                                              , glm::length(glm::vec3(m[2].x, m[2].y, m[2].z))));
+
+    placed.centre = glm::vec3(m * glm::vec4(sphere.centre, 1.0f));
+    placed.radius = sphere.radius * scale;
+    return placed;
+}
+
+
+Frustum::Frustum(void)
+{
+    for ( int i = 0 ; i < 6 ; i++ )
+        planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    tested = culled = 0;
+}
+
+
+void
+Frustum::Set(const glm::mat4 &m)
+{
+    // A point is on screen when -w <= x, y, z <= w after projection, and
+    // each of those is a plane in the rows of the matrix.
+    glm::vec4   x(m[0].x, m[1].x, m[2].x, m[3].x);
+    glm::vec4   y(m[0].y, m[1].y, m[2].y, m[3].y);
+    glm::vec4   z(m[0].z, m[1].z, m[2].z, m[3].z);
+    glm::vec4   w(m[0].w, m[1].w, m[2].w, m[3].w);
+
+    planes[0] = w + x;      // Left
+    planes[1] = w - x;      // Right
+    planes[2] = w + y;      // Bottom
+    planes[3] = w - y;      // Top
+    planes[4] = w + z;      // Near
+    planes[5] = w - z;      // Far
+
+    // Unit normals, so the distances compare with radii.
+    for ( int i = 0 ; i < 6 ; i++ )
+        planes[i] /= glm::length(glm::vec3(planes[i].x, planes[i].y, planes[i].z));
+
+    Reset();
+}
+
+
+bool
+Frustum::Visible(const BoundingSphere &sphere)
+{
+    tested++;
+    for ( int i = 0 ; i < 6 ; i++ )
+    {
+        const glm::vec4 &p = planes[i];
+        if ( p.x * sphere.centre.x + p.y * sphere.centre.y + p.z * sphere.centre.z + p.w
+             < -sphere.radius )
+        {
+            culled++;
+            return false;
+        }
+    }
+    return true;
+}
+
+
+size_t
+Frustum::Cull(const float *x, const float *y, const float *z, const float *radius
+             , size_t count, uint8_t *visible)
+{
+    size_t  i = 0;
+    size_t  seen = 0;
+
+#ifdef FRUSTUM_SSE
+    // Four spheres to a register, every plane in turn. A lane stays set
+    // while its sphere is in front of, or crosses, every plane so far.
+    for ( ; i + 4 <= count ; i += 4 )
+    {
+        __m128  cx = _mm_loadu_ps(x + i);
+        __m128  cy = _mm_loadu_ps(y + i);
+        __m128  cz = _mm_loadu_ps(z + i);
+        __m128  behind = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+        __m128  inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+        for ( int j = 0 ; j < 6 ; j++ )
+        {
+            const glm::vec4 &p = planes[j];
+            __m128  d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(p.x))
+                                             , _mm_mul_ps(cy, _mm_set1_ps(p.y)))
+                                  , _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(p.z))
+                                              , _mm_set1_ps(p.w)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, behind));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        for ( int k = 0 ; k < 4 ; k++ )
+        {
+            visible[i + k] = ( mask >> k ) & 1;
+            seen += visible[i + k];
+        }
+    }
+#endif
+
+    // What is left over, or all of them
+    for ( ; i < count ; i++ )
+    {
+        uint8_t in = 1;
+        for ( int j = 0 ; j < 6 && in ; j++ )
+        {
+            const glm::vec4 &p = planes[j];
+            in = p.x * x[i] + p.y * y[i] + p.z * z[i] + p.w >= -radius[i];
+        }
+        visible[i] = in;
+        seen += in;
+    }
+
+    tested += count;
+    culled += count - seen;
+    return seen;
+}
@@ -9,158 +9,66 @@
 #include <math.h>
 #include <iostream>
 #include "Globe.h"
-#include "libtarga.h"
-
-// Destructor
-Globe::~Globe(void)
-{
-    if ( initialized )
-    {
-        glDeleteTextures(1, &texture_obj);
-        CleanupBuffers();
-    }
-}
+#include "MeshShader.h"
 
 void
-Globe::CleanupBuffers()
+Globe::Index(const std::vector<Vertex> &vertex_data, const std::vector<GLuint> &indices)
 {
-    glDeleteBuffers(1, &vertexbuffer);
-    glDeleteBuffers(1, &uvbuffer);
-    glDeleteBuffers(1, &normalbuffer);
-    glDeleteBuffers(1, &indexbuffer);
+    // one interleaved buffer, straight from vertex_data, reusing the old
+    // buffers if there are any
+    buffer.Upload(vertex_data.data(), vertex_data.size(), indices.data(), indices.size()
+                 , VERTEX_FLOAT);
 }
 
-void
-Globe::Index()
+// Decodes the texture. This touches no GL state, so it
+// can run on a loader thread ahead of Initialize().
+bool
+Globe::Load(void)
 {
-    // cleanup old data
-    CleanupBuffers();
-    vertices.clear();
-    uvs     .clear();
-    normals .clear();
-
-    for (int i = 0; i < vertex_data.size(); ++i)
-    {
-        vertices.push_back(vertex_data[i].pos);
-        uvs     .push_back(vertex_data[i].uv);
-        normals .push_back(vertex_data[i].normal);
-    }
-
-    glGenBuffers(1, &vertexbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
-
-    glGenBuffers(1, &uvbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-    glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(glm::vec2), &uvs[0], GL_STATIC_DRAW);
-
-    glGenBuffers(1, &normalbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-    glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(glm::vec3), &normals[0], GL_STATIC_DRAW);
-
-    glGenBuffers(1, &indexbuffer);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexbuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
+    if ( ! texture )
+        texture = TextureCache::Shared().Acquire("2k_earth_daymap.tga", REPEAT_LINEAR);
+    return texture != nullptr;
 }
 
+
 // Initializer. Returns false if something went wrong, like not being able to
 // load the texture.
 bool
 Globe::Initialize(void)
 {
-    // Load textures
-    ubyte   *image_data;
-    int	    image_height, image_width;
-    if ( ! ( image_data = (ubyte*)tga_load("2k_earth_daymap.tga", &image_width, &image_height, TGA_TRUECOLOR_24) ) )
-    {
-        fprintf(stderr, "Globe::Initialize: Couldn't load 2k_earth_daymap.tga\n");
+    // Decode the texture, unless Load() already did
+    if ( ! Load() )
         return false;
-    }
 
-    // create texture object
-    glGenTextures(1, &texture_obj);
-    glBindTexture(GL_TEXTURE_2D, texture_obj);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    // upload the texture, unless another object already did
+    if ( ! texture->Upload() )
+        return false;
 
-    // set the texture wrapping/filtering options (on the currently bound texture object)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // the mesh is drawn with the mesh shader
+    if ( ! MeshShader::Shared().Initialize() )
+        return false;
 
     // multiply texture by underlying color
     glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE); 
 
-    // load and generate the texture
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, image_width, image_height, 0, GL_RGB, GL_UNSIGNED_BYTE, image_data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    // free the image data
-    free(image_data);
-
-    // scale the octahedron
-    for ( auto &vertex : vertex_data )
-    {
-        vertex.pos = radius * vertex.pos;
-    }
-
-    // index the octahedron and make buffers
-    Index(); 
-
     // We only do all this stuff once, when the GL context is first set up.
     initialized = true;
 
+    // index the octahedron and make buffers; Update() steps degree 5
+    // round to 0
+    degree = 5;
+    Update();
+
     return true;
 }
 
 
-// Draw just calls the display list we set up earlier.
+// Draws the mesh with the texture; white, because the texture supplies
+// the color.
 void
-Globe::Draw(void)
+Globe::Draw(const glm::mat4 &model, RenderQueue &queue)
 {
-    //glShadeModel(GL_FLAT);
-
-    // Enable 2D texturing
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, texture_obj);
-
-    // Enable client states for vertex,
-    // texture coordinate,
-    // normal arrays,
-    // and index arrays
-    glEnableClientState(GL_VERTEX_ARRAY);
-    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-    glEnableClientState(GL_NORMAL_ARRAY);
-
-    // Bind the vertex buffer
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-    glVertexPointer(3, GL_FLOAT, 0, (void*)0);
-
-    // Bind the texture coordinate buffer
-    glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-    glTexCoordPointer(2, GL_FLOAT, 0, (void*)0);
-
-    // Bind the normal buffer
-    glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-    glNormalPointer(GL_FLOAT, 0, (void*)0);
-
-    // Bind the index buffer
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexbuffer);
-
-    // Draw the sphere
-    glColor3f(1.0f, 1.0f, 1.0f); // using GL_MODULATE
-
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, (void*)0);
-
-    // Disable client states
-    glDisableClientState(GL_VERTEX_ARRAY);
-    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-    glDisableClientState(GL_NORMAL_ARRAY);
-
-    // Disable 2D texturing
-    glDisable(GL_TEXTURE_2D);
-
-    //glShadeModel(GL_SMOOTH);
+    queue.Submit(buffer, texture.get(), model, glm::vec4(1.0f));
 }
 
 // Update
@@ -196,12 +104,8 @@ Globe::Update()
         );
     }
 
-    // replace old
-    vertex_data = std::move(new_data);
-    indices = std::move(new_indices);
-
-    // reindex and remake buffers
-    Index();
+    // reindex and remake buffers; the new data goes when we return
+    Index(new_data, new_indices);
 }
 
 //          1
@@ -267,3 +171,10 @@ Globe::Subdivide(GLuint i1, GLuint i2, GLuint i3
     Subdivide(i31, i23, i3, vertices, indices, degree - 1);
     Subdivide(i12, i23, i31, vertices, indices, degree - 1);
 }
+
+
+void
+Globe::Print_Stats(FILE *out) const
+{
+    buffer.Print_Stats(out, "globe", 0);
+}
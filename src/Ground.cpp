@@ -8,7 +8,6 @@
 #include <stdio.h>
 #include <GL/glu.h>
 #include "Ground.h"
-#include "libtarga.h"
 
 // Destructor
 Ground::~Ground(void)
@@ -16,46 +15,34 @@ Ground::~Ground(void)
     if ( initialized )
     {
         glDeleteLists(display_list, 1);
-        glDeleteTextures(1, &texture_obj);
     }
 }
 
 
+// Decodes the texture. This touches no GL state, so it
+// can run on a loader thread ahead of Initialize().
+bool
+Ground::Load(void)
+{
+    // The grass is repeated over the ground, so it needs mipmaps.
+    if ( ! texture )
+        texture = TextureCache::Shared().Acquire("grass.tga", REPEAT_MIPMAPPED);
+    return texture != nullptr;
+}
+
+
 // Initializer. Returns false if something went wrong, like not being able to
 // load the texture.
 bool
 Ground::Initialize(void)
 {
-    ubyte   *image_data;
-    int	    image_height, image_width;
-
-    // Load the image for the texture. The texture file has to be in
-    // a place where it will be found.
-    if ( ! ( image_data = (ubyte*)tga_load("grass.tga", &image_width,
-					   &image_height, TGA_TRUECOLOR_24) ) )
-    {
-        fprintf(stderr, "Ground::Initialize: Couldn't load grass.tga\n");
+    // Decode the texture, unless Load() already did
+    if ( ! Load() )
         return false;
-    }
 
-    // This creates a texture object and binds it, so the next few operations
-    // apply to this texture.
-    glGenTextures(1, &texture_obj);
-    glBindTexture(GL_TEXTURE_2D, texture_obj);
-
-    // This sets a parameter for how the texture is loaded and interpreted.
-    // basically, it says that the data is packed tightly in the image array.
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-    // This sets up the texture with high quality filtering. First it builds
-    // mipmaps from the image data, then it sets the filtering parameters
-    // and the wrapping parameters. We want the grass to be repeated over the
-    // ground.
-    gluBuild2DMipmaps(GL_TEXTURE_2D,3, image_width, image_height, GL_RGB, GL_UNSIGNED_BYTE, image_data);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+    // Upload the texture, with its mipmaps, unless the hill already did.
+    if ( ! texture->Upload() )
+        return false;
 
     // This says what to do with the texture. Modulate will multiply the
     // texture by the underlying color.
@@ -72,7 +59,7 @@ Ground::Initialize(void)
 
 	// Turn on texturing and bind the grass texture.
 	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, texture_obj);
+	texture->Bind();
 
 	// Draw the ground as a quadrilateral, specifying texture coordinates.
 	glBegin(GL_QUADS);
@@ -0,0 +1,85 @@
+/*
+ * InstanceBuffer.cpp: Per-instance data drawn with a mesh.
+ */
+
+#include <GL/glew.h>
+#include "InstanceBuffer.h"
+
+InstanceBuffer::InstanceBuffer(void)
+{
+    buffer = 0;
+    capacity = 0;
+    uploaded = 0;
+    dirty = true;
+}
+
+InstanceBuffer::~InstanceBuffer(void)
+{
+    if ( buffer )
+        glDeleteBuffers(1, &buffer);
+}
+
+
+void
+InstanceBuffer::Clear(void)
+{
+    instances.clear();
+    dirty = true;
+}
+
+void
+InstanceBuffer::Add(const glm::mat4 &model, const glm::vec4 &color)
+{
+    MeshInstance instance = { model, color };
+
+    instances.push_back(instance);
+    dirty = true;
+}
+
+
+void
+InstanceBuffer::Upload(void)
+{
+    if ( ! dirty && buffer )
+        return;
+    dirty = false;
+
+    Send(instances);
+}
+
+void
+InstanceBuffer::Upload(const uint8_t *visible)
+{
+    shown.clear();
+    for ( size_t i = 0 ; i < instances.size() ; i++ )
+        if ( visible[i] )
+            shown.push_back(instances[i]);
+
+    // All of them is what a plain Upload() sends, and may already be there.
+    if ( shown.size() == instances.size() )
+    {
+        Upload();
+        return;
+    }
+    dirty = true;
+    Send(shown);
+}
+
+
+void
+InstanceBuffer::Send(const std::vector<MeshInstance> &sending)
+{
+    if ( ! buffer )
+        glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    // Grow by doubling; otherwise give the driver a fresh store to fill, so
+    // it needn't wait for last frame's draws to finish with the old one.
+    if ( sending.size() > capacity )
+        capacity = sending.size() > capacity * 2 ? sending.size() : capacity * 2;
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(MeshInstance), nullptr, GL_STREAM_DRAW);
+    if ( ! sending.empty() )
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sending.size() * sizeof(MeshInstance)
+                       , sending.data());
+    uploaded = (GLsizei)sending.size();
+}
@@ -0,0 +1,148 @@
+/*
+ * MappedFile.cpp: A read-only memory-mapped file.
+ *
+ * POSIX systems get a real mapping. Elsewhere the file is read into the
+ * heap in one go, which still beats reading it a token at a time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "MappedFile.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+bool
+MappedFile::Open(const char *filename)
+{
+    Close();
+
+#ifndef _WIN32
+    int fd = open(filename, O_RDONLY);
+    if ( fd < 0 )
+        return false;
+
+    struct stat st;
+    if ( fstat(fd, &st) != 0 || st.st_size <= 0 )
+    {
+        close(fd);
+        return false;
+    }
+
+    // Fault the pages in now, so a file mapped on a loader thread doesn't
+    // stall whichever thread reads it later.
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    flags |= MAP_POPULATE;
+#endif
+
+    void *map = mmap(nullptr, (size_t)st.st_size, PROT_READ, flags, fd, 0);
+    close(fd);  // the mapping keeps its own reference
+    if ( map == MAP_FAILED )
+        return false;
+
+    // We read front to back, so let the kernel read ahead aggressively.
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    data = (const char*)map;
+    size = (size_t)st.st_size;
+    heap = false;
+#else
+    FILE *file = fopen(filename, "rb");
+    if ( ! file )
+        return false;
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if ( length <= 0 )
+    {
+        fclose(file);
+        return false;
+    }
+
+    char *buf = (char*)malloc((size_t)length);
+    if ( ! buf || fread(buf, 1, (size_t)length, file) != (size_t)length )
+    {
+        free(buf);
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+
+    data = buf;
+    size = (size_t)length;
+    heap = true;
+#endif
+
+    return true;
+}
+
+void
+MappedFile::Close(void)
+{
+    if ( ! data )
+        return;
+
+#ifndef _WIN32
+    if ( ! heap )
+        munmap((void*)data, size);
+    else
+#endif
+        free((void*)data);
+
+    data = nullptr;
+    size = 0;
+    heap = false;
+}
+
+
+// Hashes the bytes eight at a time. This only has to notice that a source
+// file changed, so it trades strength for speed.
+uint64_t
+MappedFile::Hash(void) const
+{
+    const uint64_t  prime = 0x100000001B3ull;
+    uint64_t        h = 0xCBF29CE484222325ull ^ size;
+    size_t          i = 0;
+
+    for ( ; i + 8 <= size ; i += 8 )
+    {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        h = ( h ^ word ) * prime;
+        h ^= h >> 29;
+    }
+    for ( ; i < size ; ++i )
+        h = ( h ^ (unsigned char)data[i] ) * prime;
+
+    return h;
+}
+
+bool
+MappedFile::Write(const char *filename, const char *bytes, size_t length)
+{
+    std::string temp = std::string(filename) + ".tmp";
+    FILE *file = fopen(temp.c_str(), "wb");
+    if ( ! file )
+        return false;
+
+    bool ok = fwrite(bytes, 1, length, file) == length;
+    ok = fclose(file) == 0 && ok;
+#ifdef _WIN32
+    remove(filename);
+#endif
+    if ( ! ok || rename(temp.c_str(), filename) != 0 )
+    {
+        remove(temp.c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,334 @@
+/*
+ * MeshBuffer.cpp: A compiled mesh uploaded to the GPU.
+ */
+
+#include <GL/glew.h>
+#include <math.h>
+#include <cstddef>
+#include <glm/gtc/packing.hpp>
+#include "MeshBuffer.h"
+
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex must be tightly packed");
+
+const float PACKED_RANGE = 32767.0f;
+
+static int16_t
+Quantize(float value)
+{
+    value = value < -1.0f ? -1.0f : value > 1.0f ? 1.0f : value;
+    return (int16_t)lrintf(value * PACKED_RANGE);
+}
+
+// Projects a direction onto the octahedron |x| + |y| + |z| = 1, and folds
+// the lower half out over the corners of the upper, so that x and y alone
+// say where it points. MeshShader unfolds it again.
+static glm::vec2
+Octahedral(const glm::vec3 &normal)
+{
+    float       sum = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+    if ( sum == 0.0f )
+        return glm::vec2(0.0f);
+
+    glm::vec2   p = glm::vec2(normal.x, normal.y) / sum;
+    if ( normal.z < 0.0f )
+        p = glm::vec2(( 1.0f - fabsf(p.y) ) * ( p.x >= 0.0f ? 1.0f : -1.0f )
+                     , ( 1.0f - fabsf(p.x) ) * ( p.y >= 0.0f ? 1.0f : -1.0f ));
+    return p;
+}
+
+
+bool
+Mesh_Instancing(void)
+{
+    return GLEW_VERSION_3_3 || GLEW_ARB_instanced_arrays;
+}
+
+
+MeshBuffer::MeshBuffer(void)
+{
+    vertexarray = vertexbuffer = indexbuffer = 0;
+    index_type = GL_UNSIGNED_SHORT;
+    count = 0;
+    format = VERTEX_FLOAT;
+    bytes = index_bytes = 0;
+    num_vertices = 0;
+    pos_offset = glm::vec3(0.0f);
+    pos_scale = glm::vec3(1.0f);
+    centre = glm::vec3(0.0f);
+    radius = 0.0f;
+}
+
+MeshBuffer::~MeshBuffer(void)
+{
+    if ( vertexarray )
+        glDeleteVertexArrays(1, &vertexarray);
+    if ( vertexbuffer )
+        glDeleteBuffers(1, &vertexbuffer);
+    if ( indexbuffer )
+        glDeleteBuffers(1, &indexbuffer);
+}
+
+
+void
+MeshBuffer::Pack(const Vertex *vertices, size_t num_vertices, std::vector<PackedVertex> &out
+                , glm::vec3 &pos_offset, glm::vec3 &pos_scale)
+{
+    glm::vec3   pos_lo(0.0f), pos_hi(0.0f);
+
+    if ( num_vertices )
+        pos_lo = pos_hi = vertices[0].pos;
+    for ( size_t i = 0 ; i < num_vertices ; i++ )
+    {
+        pos_lo = glm::min(pos_lo, vertices[i].pos);
+        pos_hi = glm::max(pos_hi, vertices[i].pos);
+    }
+
+    // A flat side still needs a scale the shader can multiply by.
+    pos_offset = ( pos_lo + pos_hi ) * 0.5f;
+    pos_scale = glm::max(( pos_hi - pos_lo ) * 0.5f, glm::vec3(1e-6f)) / PACKED_RANGE;
+
+    out.resize(num_vertices);
+    for ( size_t i = 0 ; i < num_vertices ; i++ )
+    {
+        const Vertex    &v = vertices[i];
+        PackedVertex    &p = out[i];
+        glm::vec3       pos = ( v.pos - pos_offset ) / ( pos_scale * PACKED_RANGE );
+        glm::vec2       normal = Octahedral(v.normal);
+
+        for ( int j = 0 ; j < 3 ; j++ )
+            p.pos[j] = Quantize(pos[j]);
+        p.pad = 0;
+        p.normal[0] = Quantize(normal.x);
+        p.normal[1] = Quantize(normal.y);
+        p.uv[0] = glm::packHalf1x16(v.uv.x);
+        p.uv[1] = glm::packHalf1x16(v.uv.y);
+    }
+}
+
+
+void
+MeshBuffer::Upload_Vertices(const Vertex *vertices, size_t num_vertices)
+{
+    this->num_vertices = num_vertices;
+    std::vector<PackedVertex>   packed;
+    const void                  *data = vertices;
+
+    bytes = num_vertices * sizeof(Vertex);
+    if ( format == VERTEX_PACKED )
+    {
+        Pack(vertices, num_vertices, packed, pos_offset, pos_scale);
+        data = packed.data();
+        bytes = packed.size() * sizeof(PackedVertex);
+    }
+
+    // vertexbuffer, interleaved
+    if ( ! vertexbuffer )
+        glGenBuffers(1, &vertexbuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+    glBufferData(GL_ARRAY_BUFFER, bytes, data, GL_STATIC_DRAW);
+}
+
+void
+MeshBuffer::Upload_Indices(const void *indices, size_t num_indices, size_t index_size)
+{
+    // indexbuffer
+    if ( ! indexbuffer )
+        glGenBuffers(1, &indexbuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexbuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, num_indices * index_size, indices, GL_STATIC_DRAW);
+    index_type = index_size == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    count = (GLsizei)num_indices;
+    index_bytes = num_indices * index_size;
+
+    // Just the one level, until told otherwise.
+    Lod lod = { count, 0, 0.0f };
+    lods.assign(1, lod);
+}
+
+
+// Records where each attribute is in the vertex buffer, and the index
+// buffer, in the vertex array.
+void
+MeshBuffer::Upload_Layout(void)
+{
+    if ( ! vertexarray )
+        glGenVertexArrays(1, &vertexarray);
+    glBindVertexArray(vertexarray);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+
+    if ( format == VERTEX_PACKED )
+    {
+        // Positions and normals are unpacked in the shader; half floats
+        // the GL reads as they are.
+        glVertexAttribPointer(MESH_ATTRIB_POSITION, 3, GL_SHORT, GL_FALSE, sizeof(PackedVertex)
+                             , (void*)offsetof(PackedVertex, pos));
+        glVertexAttribPointer(MESH_ATTRIB_NORMAL, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex)
+                             , (void*)offsetof(PackedVertex, normal));
+        glVertexAttribPointer(MESH_ATTRIB_UV, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex)
+                             , (void*)offsetof(PackedVertex, uv));
+    }
+    else
+    {
+        glVertexAttribPointer(MESH_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex)
+                             , (void*)offsetof(Vertex, pos));
+        glVertexAttribPointer(MESH_ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex)
+                             , (void*)offsetof(Vertex, normal));
+        glVertexAttribPointer(MESH_ATTRIB_UV, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex)
+                             , (void*)offsetof(Vertex, uv));
+    }
+    glEnableVertexAttribArray(MESH_ATTRIB_POSITION);
+    glEnableVertexAttribArray(MESH_ATTRIB_NORMAL);
+    glEnableVertexAttribArray(MESH_ATTRIB_UV);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexbuffer);
+    glBindVertexArray(0);
+}
+
+
+bool
+MeshBuffer::Upload(const CompiledMesh &mesh, VertexFormat vertex_format)
+{
+    format = vertex_format;
+    Upload_Vertices(mesh.Vertices(), mesh.Num_Vertices());
+
+    // The indices are already as small as they can be.
+    Upload_Indices(mesh.Indices(), mesh.Num_Indices(), mesh.Index_Size());
+
+    lods.clear();
+    for ( uint32_t i = 0 ; i < mesh.Num_Lods() ; i++ )
+    {
+        const PMeshLod  &level = mesh.Lod(i);
+        Lod             lod = { (GLsizei)level.num_indices
+                              , (size_t)level.first_index * mesh.Index_Size(), level.error };
+        lods.push_back(lod);
+    }
+    centre = ( mesh.Bounds_Min() + mesh.Bounds_Max() ) * 0.5f;
+    radius = glm::length(mesh.Bounds_Max() - centre);
+
+    Upload_Layout();
+    return true;
+}
+
+bool
+MeshBuffer::Upload(const Vertex *vertices, size_t num_vertices
+                  , const GLuint *indices, size_t num_indices, VertexFormat vertex_format)
+{
+    format = vertex_format;
+    Upload_Vertices(vertices, num_vertices);
+
+    // Halve the indices when they fit in shorts.
+    if ( num_vertices <= 0x10000 )
+    {
+        std::vector<GLushort> shorts(indices, indices + num_indices);
+        Upload_Indices(shorts.data(), num_indices, sizeof(GLushort));
+    }
+    else
+        Upload_Indices(indices, num_indices, sizeof(GLuint));
+
+    // No bounds come with these, so find them.
+    glm::vec3   lo(0.0f), hi(0.0f);
+    for ( size_t i = 0 ; i < num_vertices ; i++ )
+    {
+        lo = i ? glm::min(lo, vertices[i].pos) : vertices[i].pos;
+        hi = i ? glm::max(hi, vertices[i].pos) : vertices[i].pos;
+    }
+    centre = ( lo + hi ) * 0.5f;
+    radius = glm::length(hi - centre);
+
+    Upload_Layout();
+    return true;
+}
+
+
+void
+MeshBuffer::Attach(const InstanceBuffer &instances)
+{
+    if ( ! Mesh_Instancing() )
+        return;
+
+    // The extension's entry points are the core ones under other names.
+    PFNGLVERTEXATTRIBDIVISORPROC    divisor = GLEW_VERSION_3_3
+                                            ? glVertexAttribDivisor : glVertexAttribDivisorARB;
+
+    glBindVertexArray(vertexarray);
+    glBindBuffer(GL_ARRAY_BUFFER, instances.Object());
+
+    // A mat4 takes four attributes, one a column.
+    for ( GLuint i = 0 ; i < 4 ; i++ )
+    {
+        GLuint attribute = MESH_ATTRIB_INSTANCE_MODEL + i;
+        glVertexAttribPointer(attribute, 4, GL_FLOAT, GL_FALSE, sizeof(MeshInstance)
+                             , (void*)( offsetof(MeshInstance, model) + i * sizeof(glm::vec4) ));
+        divisor(attribute, 1);
+        glEnableVertexAttribArray(attribute);
+    }
+    glVertexAttribPointer(MESH_ATTRIB_INSTANCE_COLOR, 4, GL_FLOAT, GL_FALSE, sizeof(MeshInstance)
+                         , (void*)offsetof(MeshInstance, color));
+    divisor(MESH_ATTRIB_INSTANCE_COLOR, 1);
+    glEnableVertexAttribArray(MESH_ATTRIB_INSTANCE_COLOR);
+
+    glBindVertexArray(0);
+}
+
+
+void
+MeshBuffer::Bind(void) const
+{
+    glBindVertexArray(vertexarray);
+}
+
+void
+MeshBuffer::Draw(GLsizei lod) const
+{
+    glDrawElements(GL_TRIANGLES, lods[lod].count, index_type, (void*)lods[lod].offset);
+}
+
+void
+MeshBuffer::Draw(GLsizei lod, GLsizei instances) const
+{
+    if ( GLEW_VERSION_3_3 )
+        glDrawElementsInstanced(GL_TRIANGLES, lods[lod].count, index_type
+                               , (void*)lods[lod].offset, instances);
+    else
+        glDrawElementsInstancedARB(GL_TRIANGLES, lods[lod].count, index_type
+                                  , (void*)lods[lod].offset, instances);
+}
+
+void
+MeshBuffer::Unbind(void) const
+{
+    glBindVertexArray(0);
+}
+
+
+// Measured at the nearest the bounding sphere comes to the eye.
+GLsizei
+MeshBuffer::Select_Lod(const glm::mat4 &modelview, float pixels_per_unit) const
+{
+    if ( lods.size() < 2 )
+        return 0;
+
+    const glm::mat4 &m = modelview;
+    float   scale = glm::length(glm::vec3(m[0].x, m[0].y, m[0].z));
+    float   depth = -( m[0].z * centre.x + m[1].z * centre.y + m[2].z * centre.z + m[3].z )
+                  - radius * scale;
+    if ( depth <= 0.0f )
+        return 0;
+
+    float   pixels = scale * pixels_per_unit / depth;
+    GLsizei lod = 0;
+    while ( lod + 1 < (GLsizei)lods.size() && lods[lod + 1].error * pixels < MESH_LOD_PIXELS )
+        lod++;
+    return lod;
+}
+
+
+void
+MeshBuffer::Print_Stats(FILE *out, const char *name, size_t cpu_bytes) const
+{
+    cpu_bytes += lods.capacity() * sizeof(Lod);
+
+    fprintf(out, "    %-24s %zu vertices, %d triangles, %d levels, %zu KB on the GPU, %zu KB on the CPU\n"
+           , name, num_vertices, count / 3, (int)lods.size()
+           , ( bytes + index_bytes + 1023 ) / 1024, ( cpu_bytes + 1023 ) / 1024);
+}
@@ -0,0 +1,278 @@
+/*
+ * MeshOptimizer.cpp: Reordering indexed meshes for the GPU.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include "MeshOptimizer.h"
+
+// Forsyth's scoring. The LRU cache it models is bigger than any real one,
+// which makes it a good order across cache sizes.
+const int   FORSYTH_CACHE_SIZE = 32;
+const float FORSYTH_LAST_TRIANGLE = 0.75f;  // Score of the last triangle's vertices
+const float FORSYTH_CACHE_DECAY = 1.5f;
+const float FORSYTH_VALENCE_SCALE = 2.0f;   // Favours finishing off vertices
+const float FORSYTH_VALENCE_POWER = 0.5f;
+
+static float
+Forsyth_Score(int cache_pos, unsigned int remaining)
+{
+    float   score = 0.0f;
+
+    if ( remaining == 0 )
+        return -1.0f;       // nothing left to draw with it
+
+    if ( cache_pos >= 0 )
+    {
+        if ( cache_pos < 3 )
+            score = FORSYTH_LAST_TRIANGLE;
+        else
+            score = powf(1.0f - ( cache_pos - 3 ) / (float)( FORSYTH_CACHE_SIZE - 3 )
+                        , FORSYTH_CACHE_DECAY);
+    }
+    return score + FORSYTH_VALENCE_SCALE * powf((float)remaining, -FORSYTH_VALENCE_POWER);
+}
+
+
+MeshCacheStats
+Mesh_Cache_Stats(const std::vector<unsigned int> &indices, size_t num_vertices
+                , unsigned int cache_size)
+{
+    std::vector<size_t> stamp(num_vertices, 0);     // When each entered the cache
+    size_t              misses = 0;
+    size_t              used = 0;
+    MeshCacheStats      stats = { 0.0f, 0.0f };
+
+    // A vertex is in the FIFO if fewer than cache_size misses have happened
+    // since it went in.
+    for ( unsigned int index : indices )
+    {
+        if ( stamp[index] == 0 )
+            used++;
+        if ( stamp[index] == 0 || misses - stamp[index] + 1 > cache_size )
+        {
+            misses++;
+            stamp[index] = misses;
+        }
+    }
+
+    if ( indices.size() >= 3 )
+        stats.acmr = (float)misses / ( indices.size() / 3 );
+    if ( used )
+        stats.atvr = (float)misses / used;
+    return stats;
+}
+
+
+void
+Optimize_Vertex_Cache(std::vector<unsigned int> &indices, size_t num_vertices)
+{
+    size_t  num_triangles = indices.size() / 3;
+
+    if ( num_triangles == 0 )
+        return;
+
+    // The triangles using each vertex; the first remaining[v] of them are
+    // the ones not drawn yet.
+    std::vector<unsigned int>   remaining(num_vertices, 0);
+    std::vector<unsigned int>   first(num_vertices + 1, 0);
+    std::vector<unsigned int>   adjacent(indices.size());
+
+    for ( unsigned int index : indices )
+        remaining[index]++;
+    for ( size_t v = 0 ; v < num_vertices ; v++ )
+        first[v + 1] = first[v] + remaining[v];
+    {
+        std::vector<unsigned int> fill(first.begin(), first.end() - 1);
+        for ( size_t i = 0 ; i < indices.size() ; i++ )
+            adjacent[fill[indices[i]]++] = (unsigned int)( i / 3 );
+    }
+
+    std::vector<float>  vertex_score(num_vertices);
+    std::vector<float>  triangle_score(num_triangles, 0.0f);
+    std::vector<bool>   drawn(num_triangles, false);
+
+    for ( size_t v = 0 ; v < num_vertices ; v++ )
+        vertex_score[v] = Forsyth_Score(-1, remaining[v]);
+    for ( size_t t = 0 ; t < num_triangles ; t++ )
+        for ( int k = 0 ; k < 3 ; k++ )
+            triangle_score[t] += vertex_score[indices[t * 3 + k]];
+
+    std::vector<unsigned int>   output;
+    std::vector<unsigned int>   cache, next_cache;
+    size_t                      cursor = 0;     // Where to look when the cache runs dry
+    long                        best = -1;
+
+    output.reserve(indices.size());
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    next_cache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    while ( output.size() < indices.size() )
+    {
+        if ( best < 0 )
+        {
+            // Nothing in the cache has a triangle left; take the next
+            // undrawn one in the old order.
+            while ( drawn[cursor] )
+                cursor++;
+            best = (long)cursor;
+        }
+
+        const unsigned int  *tri = &indices[best * 3];
+        drawn[best] = true;
+        for ( int k = 0 ; k < 3 ; k++ )
+        {
+            unsigned int    v = tri[k];
+            unsigned int    *list = &adjacent[first[v]];
+            unsigned int    *slot = std::find(list, list + remaining[v], (unsigned int)best);
+
+            // Swap the drawn triangle out of the live part of the list.
+            std::swap(*slot, list[--remaining[v]]);
+            output.push_back(v);
+        }
+
+        // The triangle's vertices go to the front, the rest move back.
+        next_cache.assign(tri, tri + 3);
+        for ( unsigned int v : cache )
+            if ( v != tri[0] && v != tri[1] && v != tri[2] )
+                next_cache.push_back(v);
+        cache.swap(next_cache);
+
+        for ( size_t i = 0 ; i < cache.size() ; i++ )
+        {
+            unsigned int    v = cache[i];
+            int             pos = i < (size_t)FORSYTH_CACHE_SIZE ? (int)i : -1;
+            float           score = Forsyth_Score(pos, remaining[v]);
+            float           delta = score - vertex_score[v];
+
+            vertex_score[v] = score;
+            for ( unsigned int j = 0 ; j < remaining[v] ; j++ )
+                triangle_score[adjacent[first[v] + j]] += delta;
+        }
+        if ( cache.size() > (size_t)FORSYTH_CACHE_SIZE )
+            cache.resize(FORSYTH_CACHE_SIZE);
+
+        // The next triangle is the best one touching the cache.
+        best = -1;
+        float best_score = -1.0f;
+        for ( unsigned int v : cache )
+            for ( unsigned int j = 0 ; j < remaining[v] ; j++ )
+            {
+                unsigned int t = adjacent[first[v] + j];
+                if ( triangle_score[t] > best_score )
+                {
+                    best = t;
+                    best_score = triangle_score[t];
+                }
+            }
+    }
+
+    indices.swap(output);
+}
+
+
+void
+Optimize_Overdraw(const std::vector<Vertex> &vertices, std::vector<unsigned int> &indices
+                 , float threshold)
+{
+    size_t  num_triangles = indices.size() / 3;
+
+    if ( num_triangles < 2 )
+        return;
+
+    // Split where the cache order starts afresh: at a triangle none of
+    // whose vertices were in the cache. Moving whole clusters about costs
+    // little, since each one starts cold anyway.
+    std::vector<size_t> starts;
+    {
+        std::vector<size_t> stamp(vertices.size(), 0);
+        size_t              misses = 0;
+
+        for ( size_t t = 0 ; t < num_triangles ; t++ )
+        {
+            int cold = 0;
+            for ( int k = 0 ; k < 3 ; k++ )
+            {
+                unsigned int v = indices[t * 3 + k];
+                if ( stamp[v] == 0 || misses - stamp[v] + 1 > MESH_STATS_CACHE_SIZE )
+                {
+                    misses++;
+                    stamp[v] = misses;
+                    cold++;
+                }
+            }
+            if ( t == 0 || cold == 3 )
+                starts.push_back(t);
+        }
+    }
+    if ( starts.size() < 2 )
+        return;
+    starts.push_back(num_triangles);
+
+    // Sort the clusters by how far they face out from the middle of the
+    // mesh: those are the ones most likely to hide the others.
+    glm::vec3   mesh_centre(0.0f);
+    for ( const Vertex &vertex : vertices )
+        mesh_centre += vertex.pos;
+    mesh_centre /= (float)vertices.size();
+
+    std::vector<std::pair<float, size_t>>   order;
+    for ( size_t c = 0 ; c + 1 < starts.size() ; c++ )
+    {
+        glm::vec3   centre(0.0f), normal(0.0f);
+        float       area = 0.0f;
+
+        for ( size_t t = starts[c] ; t < starts[c + 1] ; t++ )
+        {
+            const glm::vec3 &a = vertices[indices[t * 3]].pos;
+            const glm::vec3 &b = vertices[indices[t * 3 + 1]].pos;
+            const glm::vec3 &d = vertices[indices[t * 3 + 2]].pos;
+            glm::vec3       n = glm::cross(b - a, d - a);   // twice the area
+            float           twice_area = glm::length(n);
+
+            centre += ( a + b + d ) * ( twice_area / 3.0f );
+            normal += n;
+            area += twice_area;
+        }
+        if ( area > 0.0f )
+            centre /= area;
+        if ( glm::length(normal) > 0.0f )
+            normal = glm::normalize(normal);
+
+        order.push_back(std::make_pair(-glm::dot(centre - mesh_centre, normal), c));
+    }
+    std::stable_sort(order.begin(), order.end());
+
+    std::vector<unsigned int> sorted;
+    sorted.reserve(indices.size());
+    for ( auto &cluster : order )
+        sorted.insert(sorted.end(), indices.begin() + starts[cluster.second] * 3
+                     , indices.begin() + starts[cluster.second + 1] * 3);
+
+    float before = Mesh_Cache_Stats(indices, vertices.size()).acmr;
+    float after = Mesh_Cache_Stats(sorted, vertices.size()).acmr;
+    if ( after <= before * threshold )
+        indices.swap(sorted);
+}
+
+
+void
+Optimize_Vertex_Fetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+    const unsigned int          UNUSED = ~0u;
+    std::vector<unsigned int>   remap(vertices.size(), UNUSED);
+    std::vector<Vertex>         reordered;
+
+    reordered.reserve(vertices.size());
+    for ( unsigned int &index : indices )
+    {
+        if ( remap[index] == UNUSED )
+        {
+            remap[index] = (unsigned int)reordered.size();
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices.swap(reordered);
+}
@@ -0,0 +1,352 @@
+/*
+ * MeshShader.cpp: The shader that draws MeshBuffers.
+ */
+
+#include <GL/glew.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include <glm/gtc/type_ptr.hpp>
+#include "MeshShader.h"
+
+// GLSL 1.30, which GL 3.0 brought, is the oldest with in and out. Without
+// instanced arrays the instance attributes are never read.
+static const char *MESH_VERTEX_SHADER = R"(
+#version 130
+
+in vec3 position;
+in vec3 normal;
+in vec2 uv;
+in mat4 instance_model;
+in vec4 instance_color;
+
+uniform bool instanced;
+uniform bool tinted;
+uniform bool octahedral;
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform mat3 normal_matrix;
+
+// Unpacking: pos = offset + packed * scale
+uniform vec3 pos_offset;
+uniform vec3 pos_scale;
+
+out vec3 world_normal;
+out vec2 tex_coord;
+out vec4 tint;
+
+// Undoes MeshBuffer's fold of a normal onto an octahedron: the corners
+// beyond |x| + |y| = 1 are the lower half, folded back under.
+vec3 unfold(vec2 folded)
+{
+    vec3 n = vec3(folded, 1.0 - abs(folded.x) - abs(folded.y));
+    float under = max(-n.z, 0.0);
+
+    n.xy += vec2(n.x >= 0.0 ? -under : under, n.y >= 0.0 ? -under : under);
+    return normalize(n);
+}
+
+void main()
+{
+    // Instance transforms are rigid, so their own rotation turns normals.
+    mat4 placed = instanced ? model * instance_model : model;
+    mat3 normals = instanced ? normal_matrix * mat3(instance_model) : normal_matrix;
+    vec4 world = placed * vec4(pos_offset + position * pos_scale, 1.0);
+
+    world_normal = normals * ( octahedral ? unfold(normal.xy) : normal );
+    tex_coord = uv;
+    tint = instanced && tinted ? instance_color : vec4(1.0);
+    gl_Position = projection * ( view * world );
+}
+)";
+
+static const char *MESH_FRAGMENT_SHADER = R"(
+#version 130
+
+in vec3 world_normal;
+in vec2 tex_coord;
+in vec4 tint;
+
+uniform vec3 light_dir;
+uniform float ambient;
+uniform vec4 color;
+uniform bool textured;
+uniform sampler2D tex;
+
+out vec4 frag_color;
+
+void main()
+{
+    float diffuse = max(dot(normalize(world_normal), light_dir), 0.0);
+    vec4 base = color * tint;
+    vec4 lit = vec4(base.rgb * min(ambient + diffuse, 1.0), base.a);
+
+    frag_color = textured ? lit * texture(tex, tex_coord) : lit;
+}
+)";
+
+
+MeshShader::MeshShader(void)
+{
+    program = 0;
+    tried = false;
+    instancing = false;
+    u_instanced = u_tinted = u_octahedral = -1;
+    u_model = u_view = u_projection = u_normal_matrix = -1;
+    u_pos_offset = u_pos_scale = -1;
+    u_light_dir = u_ambient = u_color = u_textured = u_texture = -1;
+    view = projection = glm::mat4(1.0f);
+    light_dir = glm::vec3(0.0f, 0.0f, 1.0f);
+    pixels_per_unit = 0.0f;
+    color = glm::vec4(1.0f);
+}
+
+
+MeshShader&
+MeshShader::Shared(void)
+{
+    static MeshShader shader;
+    return shader;
+}
+
+
+GLuint
+MeshShader::Compile(GLenum type, const char *source)
+{
+    GLuint  shader = glCreateShader(type);
+    GLint   ok = GL_FALSE;
+
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if ( ! ok )
+    {
+        GLint length = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+        std::vector<char> log(length + 1, '\0');
+        glGetShaderInfoLog(shader, length, nullptr, log.data());
+        fprintf(stderr, "MeshShader::Compile: %s shader: %s\n"
+               , type == GL_VERTEX_SHADER ? "Vertex" : "Fragment", log.data());
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+
+bool
+MeshShader::Initialize(void)
+{
+    if ( tried )
+        return program != 0;
+    tried = true;
+
+    if ( ! GLEW_VERSION_3_0 )
+    {
+        fprintf(stderr, "MeshShader::Initialize: Needs OpenGL 3.0\n");
+        return false;
+    }
+    instancing = Mesh_Instancing();
+
+    GLuint vertex = Compile(GL_VERTEX_SHADER, MESH_VERTEX_SHADER);
+    GLuint fragment = Compile(GL_FRAGMENT_SHADER, MESH_FRAGMENT_SHADER);
+    if ( ! vertex || ! fragment )
+    {
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+        return false;
+    }
+
+    program = glCreateProgram();
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    glBindAttribLocation(program, MESH_ATTRIB_POSITION, "position");
+    glBindAttribLocation(program, MESH_ATTRIB_NORMAL, "normal");
+    glBindAttribLocation(program, MESH_ATTRIB_UV, "uv");
+    glBindAttribLocation(program, MESH_ATTRIB_INSTANCE_MODEL, "instance_model");
+    glBindAttribLocation(program, MESH_ATTRIB_INSTANCE_COLOR, "instance_color");
+    glBindFragDataLocation(program, 0, "frag_color");
+    glLinkProgram(program);
+
+    // The program keeps what it needs.
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+
+    GLint ok = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if ( ! ok )
+    {
+        GLint length = 0;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+        std::vector<char> log(length + 1, '\0');
+        glGetProgramInfoLog(program, length, nullptr, log.data());
+        fprintf(stderr, "MeshShader::Initialize: Link: %s\n", log.data());
+        glDeleteProgram(program);
+        program = 0;
+        return false;
+    }
+
+    u_instanced = glGetUniformLocation(program, "instanced");
+    u_tinted = glGetUniformLocation(program, "tinted");
+    u_octahedral = glGetUniformLocation(program, "octahedral");
+    u_model = glGetUniformLocation(program, "model");
+    u_view = glGetUniformLocation(program, "view");
+    u_projection = glGetUniformLocation(program, "projection");
+    u_normal_matrix = glGetUniformLocation(program, "normal_matrix");
+    u_pos_offset = glGetUniformLocation(program, "pos_offset");
+    u_pos_scale = glGetUniformLocation(program, "pos_scale");
+    u_light_dir = glGetUniformLocation(program, "light_dir");
+    u_ambient = glGetUniformLocation(program, "ambient");
+    u_color = glGetUniformLocation(program, "color");
+    u_textured = glGetUniformLocation(program, "textured");
+    u_texture = glGetUniformLocation(program, "tex");
+
+    return true;
+}
+
+
+void
+MeshShader::Begin_Frame(const glm::mat4 &view_matrix, const glm::mat4 &projection_matrix
+                       , const glm::vec3 &light, int viewport_height)
+{
+    view = view_matrix;
+    projection = projection_matrix;
+    light_dir = glm::normalize(light);
+    pixels_per_unit = projection[1][1] * viewport_height * 0.5f;
+    frustum.Set(projection * view);
+}
+
+
+void
+MeshShader::Use(void)
+{
+    glUseProgram(program);
+
+    // The camera could go once a frame, but it is a handful of floats, and
+    // this way nothing can draw with last frame's.
+    glUniformMatrix4fv(u_view, 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(u_projection, 1, GL_FALSE, glm::value_ptr(projection));
+    glUniform3fv(u_light_dir, 1, glm::value_ptr(light_dir));
+    glUniform1f(u_ambient, MESH_AMBIENT);
+    glUniform1i(u_texture, 0);
+}
+
+
+void
+MeshShader::Bind(const MeshBuffer &buffer)
+{
+    glUniform3fv(u_pos_offset, 1, glm::value_ptr(buffer.Pos_Offset()));
+    glUniform3fv(u_pos_scale, 1, glm::value_ptr(buffer.Pos_Scale()));
+    glUniform1i(u_octahedral, buffer.Format() == VERTEX_PACKED);
+
+    buffer.Bind();
+}
+
+
+void
+MeshShader::Set_Material(const glm::vec4 &material, bool textured)
+{
+    color = material;
+    glUniform4fv(u_color, 1, glm::value_ptr(color));
+    glUniform1i(u_textured, textured);
+}
+
+
+void
+MeshShader::Set_Model(const glm::mat4 &model)
+{
+    glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(model)));
+
+    glUniformMatrix4fv(u_model, 1, GL_FALSE, glm::value_ptr(model));
+    glUniformMatrix3fv(u_normal_matrix, 1, GL_FALSE, glm::value_ptr(normal_matrix));
+}
+
+void
+MeshShader::Draw(const MeshBuffer &buffer, const glm::mat4 &model)
+{
+    Set_Model(model);
+    glUniform1i(u_instanced, GL_FALSE);
+
+    buffer.Draw(buffer.Select_Lod(view * model, pixels_per_unit));
+}
+
+void
+MeshShader::Draw(const MeshBuffer &buffer, const glm::mat4 &model
+                , InstanceBuffer &instances, bool tinted)
+{
+    const std::vector<MeshInstance> &all = instances.Instances();
+    size_t  count = all.size();
+
+    if ( count == 0 )
+        return;
+
+    // Where each instance's bounds are in the world, as a batch
+    cull_x.resize(count);
+    cull_y.resize(count);
+    cull_z.resize(count);
+    cull_radius.resize(count);
+    cull_visible.resize(count);
+    for ( size_t i = 0 ; i < count ; i++ )
+    {
+        BoundingSphere  placed = Bounding_Transform(model * all[i].model, buffer.Bounds());
+        cull_x[i] = placed.centre.x;
+        cull_y[i] = placed.centre.y;
+        cull_z[i] = placed.centre.z;
+        cull_radius[i] = placed.radius;
+    }
+    if ( frustum.Cull(cull_x.data(), cull_y.data(), cull_z.data(), cull_radius.data()
+                     , count, cull_visible.data()) == 0 )
+        return;
+
+    if ( ! instancing )
+    {
+        Draw_Each(buffer, model, all, tinted);
+        return;
+    }
+    instances.Upload(cull_visible.data());
+
+    Set_Model(model);
+    glUniform1i(u_instanced, GL_TRUE);
+    glUniform1i(u_tinted, tinted);
+
+    // One level for them all: the finest any of them needs.
+    GLsizei     lod = buffer.Num_Lods() - 1;
+    glm::mat4   modelview = view * model;
+    for ( size_t i = 0 ; i < count && lod > 0 ; i++ )
+        if ( cull_visible[i] )
+            lod = std::min(lod, buffer.Select_Lod(modelview * all[i].model, pixels_per_unit));
+
+    buffer.Draw(lod, instances.Uploaded());
+}
+
+// Without instanced arrays, each visible instance is an ordinary draw,
+// with its own transform, tint and level of detail.
+void
+MeshShader::Draw_Each(const MeshBuffer &buffer, const glm::mat4 &model
+                     , const std::vector<MeshInstance> &all, bool tinted)
+{
+    glUniform1i(u_instanced, GL_FALSE);
+    for ( size_t i = 0 ; i < all.size() ; i++ )
+    {
+        if ( ! cull_visible[i] )
+            continue;
+
+        glm::mat4   placed = model * all[i].model;
+        Set_Model(placed);
+        if ( tinted )
+            glUniform4fv(u_color, 1, glm::value_ptr(color * all[i].color));
+        buffer.Draw(buffer.Select_Lod(view * placed, pixels_per_unit));
+    }
+
+    // The next draw may share the material.
+    if ( tinted )
+        glUniform4fv(u_color, 1, glm::value_ptr(color));
+}
+
+void
+MeshShader::Unbind(const MeshBuffer &buffer)
+{
+    buffer.Unbind();
+    glUseProgram(0);
+}
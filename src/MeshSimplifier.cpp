@@ -0,0 +1,373 @@
+/*
+ * MeshSimplifier.cpp: Levels of detail by quadric error edge collapse.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <queue>
+#include "MeshSimplifier.h"
+
+// A collapsed triangle that turns further than this is a fold; the
+// collapse is refused. (The cosine of about 75 degrees.)
+const float MIN_NORMAL_DOT = 0.25f;
+
+// A symmetric 4x4 matrix, stored as its upper triangle. The sum of squared
+// distances from a point to a set of planes, each weighted by its
+// triangle's area.
+struct Quadric {
+    double  a[10];
+    double  weight;     // The total area
+
+    Quadric(void) { std::fill(a, a + 10, 0.0); weight = 0.0; };
+
+    void    Add_Plane(const glm::vec3 &n, double d, double w)
+    {
+        double p[4] = { n.x, n.y, n.z, d };
+        int    k = 0;
+
+        for ( int i = 0 ; i < 4 ; i++ )
+            for ( int j = i ; j < 4 ; j++ )
+                a[k++] += w * p[i] * p[j];
+        weight += w;
+    };
+
+    void    Add(const Quadric &other)
+    {
+        for ( int k = 0 ; k < 10 ; k++ )
+            a[k] += other.a[k];
+        weight += other.weight;
+    };
+
+    double  Error(const glm::vec3 &p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double e = a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x
+                 + a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y
+                 + a[7] * z * z + 2 * a[8] * z
+                 + a[9];
+        return e > 0.0 ? e : 0.0;
+    };
+};
+
+// A possible collapse of from onto to, tagged with both vertices'
+// versions so it can be dropped once either has changed.
+struct Collapse {
+    double          cost;       // The quadric error; favours small areas
+    double          distance;   // The mean squared distance moved
+    unsigned int    from, to;
+    unsigned int    from_version, to_version;
+
+    bool    operator<(const Collapse &other) const { return cost > other.cost; };
+};
+
+class Simplifier {
+  private:
+    const std::vector<Vertex>           &vertices;
+    std::vector<unsigned int>           tris;       // Corners, as vertex numbers
+    std::vector<bool>                   alive;      // Per triangle
+    size_t                              live;       // Triangles alive
+
+    std::vector<unsigned int>           position;   // The first vertex at each one's position
+    std::vector<bool>                   locked;     // Per vertex: may not be moved
+    std::vector<Quadric>                quadrics;   // Per position
+    std::vector<std::vector<unsigned int>>  around; // Per position: triangles that used it
+    std::vector<unsigned int>           version;    // Per position
+    std::priority_queue<Collapse>       queue;
+    double                              worst;      // The furthest collapse so far
+
+    glm::vec3   Normal(const unsigned int*, unsigned int from, unsigned int to) const;
+    bool        Has_Position(unsigned int t, unsigned int p) const;
+    void        Queue_Around(unsigned int p);
+    bool        Try(const Collapse&);
+
+  public:
+    Simplifier(const std::vector<Vertex>&, const std::vector<unsigned int>&);
+
+    size_t  Live(void) const { return live; };
+    float   Error(void) const { return (float)sqrt(worst); };
+
+    // Collapses edges until no more than target triangles are left, or no
+    // collapse is allowed. Returns false in the second case.
+    bool    Run(size_t target);
+
+    // The triangles still alive.
+    void    Indices(std::vector<unsigned int>&) const;
+};
+
+
+Simplifier::Simplifier(const std::vector<Vertex> &v, const std::vector<unsigned int> &indices)
+    : vertices(v), tris(indices)
+{
+    size_t  n = vertices.size();
+    size_t  num_tris = tris.size() / 3;
+
+    alive.assign(num_tris, true);
+    live = num_tris;
+    worst = 0.0;
+
+    // Weld positions, by sorting the vertices on them.
+    std::vector<unsigned int>   order(n);
+    for ( size_t i = 0 ; i < n ; i++ )
+        order[i] = (unsigned int)i;
+    auto less = [&] (unsigned int a, unsigned int b)
+    {
+        const glm::vec3 &p = vertices[a].pos, &q = vertices[b].pos;
+        return p.x < q.x || ( p.x == q.x && ( p.y < q.y || ( p.y == q.y && p.z < q.z ) ) );
+    };
+    std::sort(order.begin(), order.end(), less);
+
+    position.resize(n);
+    locked.assign(n, false);
+    for ( size_t i = 0, j ; i < n ; i = j )
+    {
+        for ( j = i + 1 ; j < n && ! less(order[i], order[j]) ; j++ )
+            ;
+        unsigned int first = *std::min_element(order.begin() + i, order.begin() + j);
+        for ( size_t k = i ; k < j ; k++ )
+        {
+            position[order[k]] = first;
+            locked[order[k]] = j - i > 1;   // a seam
+        }
+    }
+
+    // Lock both ends of every edge that doesn't have exactly two triangles.
+    std::vector<std::pair<unsigned int, unsigned int>> edges;
+    edges.reserve(tris.size());
+    for ( size_t t = 0 ; t < num_tris ; t++ )
+        for ( int k = 0 ; k < 3 ; k++ )
+        {
+            unsigned int a = position[tris[t * 3 + k]];
+            unsigned int b = position[tris[t * 3 + ( k + 1 ) % 3]];
+            edges.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+        }
+    std::sort(edges.begin(), edges.end());
+    for ( size_t i = 0, j ; i < edges.size() ; i = j )
+    {
+        for ( j = i + 1 ; j < edges.size() && edges[j] == edges[i] ; j++ )
+            ;
+        if ( j - i != 2 )
+            locked[edges[i].first] = locked[edges[i].second] = true;
+    }
+    // A position is locked if any of its vertices is.
+    for ( size_t i = 0 ; i < n ; i++ )
+        if ( locked[i] )
+            locked[position[i]] = true;
+    for ( size_t i = 0 ; i < n ; i++ )
+        locked[i] = locked[position[i]];
+
+    quadrics.resize(n);
+    around.resize(n);
+    version.assign(n, 0);
+    for ( size_t t = 0 ; t < num_tris ; t++ )
+    {
+        const unsigned int  *tri = &tris[t * 3];
+        const glm::vec3     &a = vertices[tri[0]].pos;
+        glm::vec3           normal = glm::cross(vertices[tri[1]].pos - a, vertices[tri[2]].pos - a);
+        float               length = glm::length(normal);
+
+        if ( length > 0.0f )
+        {
+            // weighted by area, so slivers count for little
+            normal /= length;
+            for ( int k = 0 ; k < 3 ; k++ )
+                quadrics[position[tri[k]]].Add_Plane(normal, -glm::dot(normal, a), length * 0.5);
+        }
+        for ( int k = 0 ; k < 3 ; k++ )
+            around[position[tri[k]]].push_back((unsigned int)t);
+    }
+
+    for ( size_t i = 0 ; i < n ; i++ )
+        if ( position[i] == i )
+            Queue_Around((unsigned int)i);
+}
+
+glm::vec3
+Simplifier::Normal(const unsigned int *tri, unsigned int from, unsigned int to) const
+{
+    glm::vec3 p[3];
+
+    for ( int k = 0 ; k < 3 ; k++ )
+        p[k] = vertices[tri[k] == from ? to : tri[k]].pos;
+    return glm::cross(p[1] - p[0], p[2] - p[0]);
+}
+
+bool
+Simplifier::Has_Position(unsigned int t, unsigned int p) const
+{
+    return position[tris[t * 3]] == p || position[tris[t * 3 + 1]] == p
+        || position[tris[t * 3 + 2]] == p;
+}
+
+// Queues every collapse along the edges of the triangles around a
+// position, in whichever directions are allowed.
+void
+Simplifier::Queue_Around(unsigned int p)
+{
+    for ( unsigned int t : around[p] )
+    {
+        if ( ! alive[t] )
+            continue;
+        for ( int k = 0 ; k < 3 ; k++ )
+        {
+            unsigned int a = tris[t * 3 + k], b = tris[t * 3 + ( k + 1 ) % 3];
+
+            for ( int dir = 0 ; dir < 2 ; dir++, std::swap(a, b) )
+            {
+                if ( locked[a] || ( position[a] != p && position[b] != p ) )
+                    continue;
+
+                Quadric q = quadrics[a];
+                q.Add(quadrics[position[b]]);
+
+                double   cost = q.Error(vertices[b].pos);
+                Collapse c = { cost, q.weight > 0.0 ? cost / q.weight : 0.0, a, b
+                             , version[a], version[position[b]] };
+                queue.push(c);
+            }
+        }
+    }
+}
+
+bool
+Simplifier::Try(const Collapse &c)
+{
+    unsigned int    from = c.from, to = c.to, to_pos = position[to];
+
+    // An unlocked vertex is alone at its position, so from is its own.
+    if ( locked[from] || c.from_version != version[from] || c.to_version != version[to_pos] )
+        return false;
+
+    // The triangles on the edge must all use the same vertex at to's
+    // position, or the edge would drag a seam along.
+    int         shared = 0;
+    for ( unsigned int t : around[from] )
+        if ( alive[t] && Has_Position(t, to_pos) )
+        {
+            shared++;
+            for ( int k = 0 ; k < 3 ; k++ )
+                if ( position[tris[t * 3 + k]] == to_pos && tris[t * 3 + k] != to )
+                    return false;
+        }
+    if ( shared != 2 )
+        return false;
+
+    // The link condition: the ends may only share the two neighbours
+    // across the edge, or the collapse would pinch the surface.
+    std::vector<unsigned int> from_ring, to_ring, common;
+    for ( unsigned int t : around[from] )
+        if ( alive[t] )
+            for ( int k = 0 ; k < 3 ; k++ )
+                from_ring.push_back(position[tris[t * 3 + k]]);
+    for ( unsigned int t : around[to_pos] )
+        if ( alive[t] )
+            for ( int k = 0 ; k < 3 ; k++ )
+                to_ring.push_back(position[tris[t * 3 + k]]);
+    std::sort(from_ring.begin(), from_ring.end());
+    from_ring.erase(std::unique(from_ring.begin(), from_ring.end()), from_ring.end());
+    std::sort(to_ring.begin(), to_ring.end());
+    to_ring.erase(std::unique(to_ring.begin(), to_ring.end()), to_ring.end());
+    std::set_intersection(from_ring.begin(), from_ring.end(), to_ring.begin(), to_ring.end()
+                         , std::back_inserter(common));
+    if ( common.size() != 4 )   // the two neighbours, and the ends themselves
+        return false;
+
+    // No triangle left may fold over.
+    for ( unsigned int t : around[from] )
+    {
+        if ( ! alive[t] || Has_Position(t, to_pos) )
+            continue;
+
+        glm::vec3 before = Normal(&tris[t * 3], from, from);
+        glm::vec3 after = Normal(&tris[t * 3], from, to);
+        float     lengths = glm::length(before) * glm::length(after);
+
+        if ( lengths == 0.0f || glm::dot(before, after) < MIN_NORMAL_DOT * lengths )
+            return false;
+    }
+
+    for ( unsigned int t : around[from] )
+    {
+        if ( ! alive[t] )
+            continue;
+        if ( Has_Position(t, to_pos) )
+        {
+            alive[t] = false;
+            live--;
+            continue;
+        }
+        for ( int k = 0 ; k < 3 ; k++ )
+            if ( tris[t * 3 + k] == from )
+                tris[t * 3 + k] = to;
+        around[to_pos].push_back(t);
+    }
+    around[from].clear();
+    locked[from] = true;    // it's gone; never try to move it again
+    version[from]++;        // nor onto it
+
+    quadrics[to_pos].Add(quadrics[from]);
+    version[to_pos]++;
+    worst = std::max(worst, c.distance);
+
+    Queue_Around(to_pos);
+    return true;
+}
+
+bool
+Simplifier::Run(size_t target)
+{
+    while ( live > target )
+    {
+        if ( queue.empty() )
+            return false;
+
+        Collapse c = queue.top();
+        queue.pop();
+        Try(c);
+    }
+    return true;
+}
+
+void
+Simplifier::Indices(std::vector<unsigned int> &out) const
+{
+    out.clear();
+    for ( size_t t = 0 ; t < alive.size() ; t++ )
+        if ( alive[t] )
+            out.insert(out.end(), &tris[t * 3], &tris[t * 3] + 3);
+}
+
+
+void
+Build_Lod_Chain(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices
+               , unsigned int max_levels, std::vector<MeshLod> &lods)
+{
+    lods.clear();
+    if ( max_levels == 0 )
+        return;
+
+    MeshLod full = { indices, 0.0f };
+    lods.push_back(full);
+
+    Simplifier  simplifier(vertices, indices);
+    size_t      target = indices.size() / 3;
+
+    while ( lods.size() < max_levels )
+    {
+        size_t  before = simplifier.Live();
+
+        target = (size_t)( target * MESH_LOD_RATIO );
+        bool reached = simplifier.Run(target);
+
+        // A level that barely differs from the last isn't worth keeping.
+        if ( simplifier.Live() > before * ( 1.0f + MESH_LOD_RATIO ) / 2.0f )
+            break;
+
+        MeshLod lod;
+        simplifier.Indices(lod.indices);
+        lod.error = simplifier.Error();
+        lods.push_back(lod);
+
+        if ( ! reached )
+            break;
+    }
+}
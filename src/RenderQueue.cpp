@@ -0,0 +1,112 @@
+/*
+ * RenderQueue.cpp: The queue every mesh is drawn through.
+ */
+
+#include <GL/glew.h>
+#include <algorithm>
+#include "MeshShader.h"
+#include "RenderQueue.h"
+
+static const uint64_t   RENDER_DEPTH_MAX = ( 1 << 28 ) - 1;
+
+
+uint64_t
+RenderQueue::Key(RenderPass pass, GLuint texture, GLuint buffer, float depth)
+{
+    uint64_t    d = (uint64_t)( std::min(std::max(depth / RENDER_DEPTH_RANGE, 0.0f), 1.0f)
+                              * RENDER_DEPTH_MAX );
+    uint64_t    t = texture & 0xFFFF;
+    uint64_t    b = buffer & 0xFFFF;
+
+    if ( pass == RENDER_BLENDED )
+        return ( (uint64_t)pass << 60 ) | ( ( RENDER_DEPTH_MAX - d ) << 32 ) | ( t << 16 ) | b;
+    return ( (uint64_t)pass << 60 ) | ( t << 44 ) | ( b << 28 ) | d;
+}
+
+
+void
+RenderQueue::Add(const Item &item, RenderPass pass)
+{
+    // How far in front of the camera the mesh's centre is
+    glm::vec3   centre = item.buffer->Bounds().centre;
+    glm::vec4   eye = MeshShader::Shared().View() * ( item.model * glm::vec4(centre, 1.0f) );
+    GLuint      texture = item.texture ? item.texture->Object() : 0;
+
+    order.push_back(std::make_pair(Key(pass, texture, item.buffer->Object(), -eye.z)
+                                  , (uint32_t)items.size()));
+    items.push_back(item);
+}
+
+
+void
+RenderQueue::Submit(const MeshBuffer &buffer, const TextureCache::Texture *texture
+                   , const glm::mat4 &model, const glm::vec4 &color, RenderPass pass)
+{
+    if ( ! MeshShader::Shared().View_Frustum().Visible(Bounding_Transform(model, buffer.Bounds())) )
+        return;
+
+    Item    item = { &buffer, texture, model, color, nullptr, false };
+    Add(item, pass);
+}
+
+void
+RenderQueue::Submit(const MeshBuffer &buffer, const TextureCache::Texture *texture
+                   , const glm::mat4 &model, const glm::vec4 &color
+                   , InstanceBuffer &instances, bool tinted, RenderPass pass)
+{
+    if ( instances.Count() == 0 )
+        return;
+
+    Item    item = { &buffer, texture, model, color, &instances, tinted };
+    Add(item, pass);
+}
+
+
+void
+RenderQueue::Flush(void)
+{
+    binds = saved = 0;
+    if ( items.empty() )
+        return;
+
+    std::sort(order.begin(), order.end());
+
+    // Drawn one at a time, each would bind the program, its buffer and its
+    // texture, if it has one. Here only the first draw binds the program.
+    MeshShader                  &shader = MeshShader::Shared();
+    const MeshBuffer            *buffer = nullptr;
+    const TextureCache::Texture *texture = nullptr;
+    size_t                      naive = 0;
+
+    shader.Use();
+    binds++;
+    for ( const auto &entry : order )
+    {
+        const Item  &item = items[entry.second];
+
+        naive += item.texture ? 3 : 2;
+        if ( item.texture && item.texture != texture )
+        {
+            item.texture->Bind();
+            texture = item.texture;
+            binds++;
+        }
+        if ( item.buffer != buffer )
+        {
+            shader.Bind(*item.buffer);
+            buffer = item.buffer;
+            binds++;
+        }
+
+        shader.Set_Material(item.color, item.texture != nullptr);
+        if ( item.instances )
+            shader.Draw(*item.buffer, item.model, *item.instances, item.tinted);
+        else
+            shader.Draw(*item.buffer, item.model);
+    }
+    shader.Unbind(*buffer);
+    saved = naive - binds;
+
+    items.clear();
+    order.clear();
+}
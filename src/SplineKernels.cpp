@@ -0,0 +1,274 @@
+/*
+ * SplineKernels.cpp: Evaluating a uniform cubic B-spline at many parameter
+ * values at once.
+ *
+ * Both kernels work out the blending functions for each parameter once,
+ * for all three outputs, and find the four control points by stepping on
+ * from the first rather than taking a remainder for each. The AVX2 kernel
+ * keeps eight parameters in a register, gathers each coordinate of their
+ * control points, and hands whatever is left over to the scalar one.
+ */
+
+#include <math.h>
+#include "SplineKernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SPLINE_KERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && ! defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(SPLINE_KERNELS_X86) && defined(__GNUC__)
+#define SPLINE_TARGET_AVX2  __attribute__((target("avx2")))
+#else
+#define SPLINE_TARGET_AVX2
+#endif
+
+static int  SplineIsaLimit = SPLINE_ISA_COUNT - 1;
+
+
+// The blending functions for a point, and their first and second
+// derivatives, at u within a span, all times 6.
+static inline void
+Blend(float u, float basis[4], float first[4], float second[4])
+{
+    float   u_sq = u * u;
+    float   u_cube = u * u_sq;
+
+    basis[0] = -u_cube + 3.0f * u_sq - 3.0f * u + 1.0f;
+    basis[1] = 3.0f * u_cube - 6.0f * u_sq + 4.0f;
+    basis[2] = -3.0f * u_cube + 3.0f * u_sq + 3.0f * u + 1.0f;
+    basis[3] = u_cube;
+
+    first[0] = -3.0f * u_sq + 6.0f * u - 3.0f;
+    first[1] = 9.0f * u_sq - 12.0f * u;
+    first[2] = -9.0f * u_sq + 6.0f * u + 3.0f;
+    first[3] = 3.0f * u_sq;
+
+    second[0] = -6.0f * u + 6.0f;
+    second[1] = 18.0f * u - 12.0f;
+    second[2] = -18.0f * u + 6.0f;
+    second[3] = 6.0f * u;
+}
+
+// Sums the four control points times the blending functions, then divides
+// through by 6, in the order CubicBspline::Evaluate_Point() does.
+static inline void
+Sum(const float *c[4], unsigned int d, const float blend[4], float *out)
+{
+    for ( unsigned int j = 0 ; j < d ; j++ )
+    {
+        float   sum = 0.0f;
+        for ( int i = 0 ; i < 4 ; i++ )
+            sum += c[i][j] * blend[i];
+        out[j] = sum / 6.0f;
+    }
+}
+
+
+static void
+Evaluate_Scalar(const float *controls, unsigned int d, unsigned int n
+               , const float *t, size_t count, float *points, float *first, float *second)
+{
+    for ( size_t k = 0 ; k < count ; k++ )
+    {
+        float           posn = floorf(t[k]);
+        float           basis[4], first_basis[4], second_basis[4];
+        const float     *c[4];
+        unsigned int    index;
+
+        // The span's first control point, wrapped, then the next three
+        index = (unsigned int)( posn - n * floorf(posn / n) );
+        for ( int i = 0 ; i < 4 ; i++, index = index + 1 == n ? 0 : index + 1 )
+            c[i] = controls + (size_t)index * d;
+
+        Blend(t[k] - posn, basis, first_basis, second_basis);
+        if ( points )
+            Sum(c, d, basis, points + k * d);
+        if ( first )
+            Sum(c, d, first_basis, first + k * d);
+        if ( second )
+            Sum(c, d, second_basis, second + k * d);
+    }
+}
+
+
+#ifdef SPLINE_KERNELS_X86
+
+// Eight sums of control points times blending functions, stored
+// interleaved with the other coordinates.
+SPLINE_TARGET_AVX2
+static inline void
+Sum_8(const float *controls, unsigned int d, const __m256i offset[4], const __m256 blend[4]
+     , float *out)
+{
+    alignas(32) float   lanes[8];
+
+    for ( unsigned int j = 0 ; j < d ; j++ )
+    {
+        __m256  sum = _mm256_setzero_ps();
+        for ( int i = 0 ; i < 4 ; i++ )
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_i32gather_ps(controls + j, offset[i], 4)
+                                                  , blend[i]));
+        _mm256_store_ps(lanes, _mm256_div_ps(sum, _mm256_set1_ps(6.0f)));
+        for ( int l = 0 ; l < 8 ; l++ )
+            out[l * d + j] = lanes[l];
+    }
+}
+
+SPLINE_TARGET_AVX2
+static void
+Evaluate_Avx2(const float *controls, unsigned int d, unsigned int n
+             , const float *t, size_t count, float *points, float *first, float *second)
+{
+    const __m256    one = _mm256_set1_ps(1.0f), three = _mm256_set1_ps(3.0f);
+    const __m256    four = _mm256_set1_ps(4.0f), six = _mm256_set1_ps(6.0f);
+    const __m256    nine = _mm256_set1_ps(9.0f), twelve = _mm256_set1_ps(12.0f);
+    const __m256    eighteen = _mm256_set1_ps(18.0f);
+    const __m256    span_count = _mm256_set1_ps((float)n);
+    const __m256i   last = _mm256_set1_epi32((int)n - 1);
+    const __m256i   wrap = _mm256_set1_epi32((int)n);
+    const __m256i   stride = _mm256_set1_epi32((int)d);
+    size_t          k = 0;
+
+    for ( ; k + 8 <= count ; k += 8 )
+    {
+        __m256  tk = _mm256_loadu_ps(t + k);
+        __m256  posn = _mm256_floor_ps(tk);
+        __m256  u = _mm256_sub_ps(tk, posn);
+        __m256  u_sq = _mm256_mul_ps(u, u);
+        __m256  u_cube = _mm256_mul_ps(u, u_sq);
+
+        // The four control points' offsets, wrapped
+        __m256i index = _mm256_cvttps_epi32(
+                            _mm256_sub_ps(posn, _mm256_mul_ps(span_count
+                                         , _mm256_floor_ps(_mm256_div_ps(posn, span_count)))));
+        __m256i offset[4];
+        for ( int i = 0 ; i < 4 ; i++ )
+        {
+            offset[i] = _mm256_mullo_epi32(index, stride);
+            index = _mm256_add_epi32(index, _mm256_set1_epi32(1));
+            index = _mm256_sub_epi32(index, _mm256_and_si256(_mm256_cmpgt_epi32(index, last), wrap));
+        }
+
+        // The blending functions, term by term as Blend() has them
+        __m256  u3 = _mm256_mul_ps(three, u), u_sq3 = _mm256_mul_ps(three, u_sq);
+        __m256  u_cube3 = _mm256_mul_ps(three, u_cube);
+        __m256  u6 = _mm256_mul_ps(six, u);
+        if ( points )
+        {
+            __m256  blend[4];
+            blend[0] = _mm256_add_ps(_mm256_sub_ps(_mm256_add_ps(_mm256_sub_ps(_mm256_setzero_ps(), u_cube)
+                                                                , u_sq3), u3), one);
+            blend[1] = _mm256_add_ps(_mm256_sub_ps(u_cube3, _mm256_mul_ps(six, u_sq)), four);
+            blend[2] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(-3.0f), u_cube)
+                                                                , u_sq3), u3), one);
+            blend[3] = u_cube;
+            Sum_8(controls, d, offset, blend, points + k * d);
+        }
+        if ( first )
+        {
+            __m256  blend[4];
+            blend[0] = _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(-3.0f), u_sq), u6), three);
+            blend[1] = _mm256_sub_ps(_mm256_mul_ps(nine, u_sq), _mm256_mul_ps(twelve, u));
+            blend[2] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(-9.0f), u_sq), u6), three);
+            blend[3] = u_sq3;
+            Sum_8(controls, d, offset, blend, first + k * d);
+        }
+        if ( second )
+        {
+            __m256  blend[4];
+            blend[0] = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(-6.0f), u), six);
+            blend[1] = _mm256_sub_ps(_mm256_mul_ps(eighteen, u), twelve);
+            blend[2] = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(-18.0f), u), six);
+            blend[3] = u6;
+            Sum_8(controls, d, offset, blend, second + k * d);
+        }
+    }
+
+    Evaluate_Scalar(controls, d, n, t + k, count - k
+                   , points ? points + k * d : nullptr, first ? first + k * d : nullptr
+                   , second ? second + k * d : nullptr);
+}
+
+#endif
+
+
+// What the CPU, and the OS, can actually run
+static int
+Spline_Cpu_Isa(void)
+{
+#if defined(SPLINE_KERNELS_X86) && defined(__GNUC__)
+    if ( __builtin_cpu_supports("avx2") )
+        return SPLINE_ISA_AVX2;
+#elif defined(SPLINE_KERNELS_X86) && defined(_MSC_VER)
+    int info[4];
+
+    __cpuid(info, 0);
+    if ( info[0] >= 7 )
+    {
+        __cpuid(info, 1);
+        // AVX needs the OS to save the ymm registers too.
+        if ( ( info[2] & ( 1 << 27 ) ) && ( info[2] & ( 1 << 28 ) )
+          && ( _xgetbv(0) & 0x6 ) == 0x6 )
+        {
+            __cpuidex(info, 7, 0);
+            if ( info[1] & ( 1 << 5 ) )
+                return SPLINE_ISA_AVX2;
+        }
+    }
+#endif
+    return SPLINE_ISA_SCALAR;
+}
+
+
+int
+Spline_Kernel_Isa(void)
+{
+    static const int    isa = Spline_Cpu_Isa();
+
+    return isa < SplineIsaLimit ? isa : SplineIsaLimit;
+}
+
+void
+Spline_Limit_Kernel_Isa(int isa)
+{
+    if ( isa < SPLINE_ISA_SCALAR )
+        isa = SPLINE_ISA_SCALAR;
+    if ( isa >= SPLINE_ISA_COUNT )
+        isa = SPLINE_ISA_COUNT - 1;
+    SplineIsaLimit = isa;
+}
+
+
+SplineKernel
+Spline_Get_Kernel(int isa)
+{
+    switch ( isa )
+    {
+        case SPLINE_ISA_SCALAR:
+            return Evaluate_Scalar;
+#ifdef SPLINE_KERNELS_X86
+        case SPLINE_ISA_AVX2:
+            return Evaluate_Avx2;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+const char*
+Spline_Isa_Name(int isa)
+{
+    switch ( isa )
+    {
+        case SPLINE_ISA_SCALAR:
+            return "scalar";
+        case SPLINE_ISA_AVX2:
+            return "avx2";
+        default:
+            return "unknown";
+    }
+}
@@ -0,0 +1,128 @@
+/*
+ * SweptMesh.cpp: Meshes made by sweeping a circle along a curve.
+ */
+
+#include <math.h>
+#include "SweptMesh.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Reflects v in the plane through the origin with the given normal, whose
+// length squared is c.
+static glm::vec3
+Reflect(const glm::vec3 &v, const glm::vec3 &normal, float c)
+{
+    return v - normal * ( 2.0f / c * glm::dot(normal, v) );
+}
+
+// The frame at the next point: reflect in the plane between the points,
+// which maps the position over but leaves the tangent wrong, then in the
+// plane that takes that tangent onto the right one.
+static glm::vec3
+Next_Normal(const SweepFrame &from, const glm::vec3 &point, const glm::vec3 &tangent)
+{
+    glm::vec3   v1 = point - from.point;
+    float       c1 = glm::dot(v1, v1);
+
+    if ( c1 == 0.0f )
+        return from.normal;
+
+    glm::vec3   normal = Reflect(from.normal, v1, c1);
+    glm::vec3   v2 = tangent - Reflect(from.tangent, v1, c1);
+    float       c2 = glm::dot(v2, v2);
+
+    if ( c2 == 0.0f )
+        return normal;
+    return Reflect(normal, v2, c2);
+}
+
+// Rotates v, which is across the unit axis, by angle about it.
+static glm::vec3
+Rotate_Across(const glm::vec3 &v, const glm::vec3 &axis, float angle)
+{
+    return v * cosf(angle) + glm::cross(axis, v) * sinf(angle);
+}
+
+
+void
+Sweep_Frames(const std::vector<glm::vec3> &points, const std::vector<glm::vec3> &tangents
+            , bool loop, std::vector<SweepFrame> &frames)
+{
+    size_t  n = points.size();
+
+    frames.resize(n);
+    if ( n == 0 )
+        return;
+
+    for ( size_t i = 0 ; i < n ; i++ )
+    {
+        frames[i].point = points[i];
+        frames[i].tangent = glm::normalize(tangents[i]);
+    }
+
+    // Up, less any part along the tangent; or x, for a start straight up.
+    glm::vec3   t = frames[0].tangent;
+    glm::vec3   up = fabsf(t.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+    frames[0].normal = glm::normalize(up - t * glm::dot(up, t));
+
+    for ( size_t i = 1 ; i < n ; i++ )
+        frames[i].normal = glm::normalize(Next_Normal(frames[i - 1], points[i], frames[i].tangent));
+
+    if ( ! loop || n < 2 )
+        return;
+
+    // Carried on round to the start, the normal comes back turned by some
+    // angle about the first tangent. Turn each frame back by its share.
+    glm::vec3   end = Next_Normal(frames[n - 1], points[0], frames[0].tangent);
+    float       angle = atan2f(glm::dot(glm::cross(end, frames[0].normal), frames[0].tangent)
+                              , glm::dot(end, frames[0].normal));
+
+    for ( size_t i = 1 ; i < n ; i++ )
+        frames[i].normal = Rotate_Across(frames[i].normal, frames[i].tangent, angle * i / n);
+}
+
+
+void
+Sweep_Tube(const std::vector<SweepFrame> &frames, float radius, int sides, bool loop
+          , std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+    size_t          n = frames.size();
+    size_t          rings = loop ? n + 1 : n;  // A loop repeats its first, for the seam
+    unsigned int    first = (unsigned int)vertices.size();
+    float           v = 0.0f;
+
+    if ( n < 2 )
+        return;
+
+    for ( size_t i = 0 ; i < rings ; i++ )
+    {
+        const SweepFrame    &frame = frames[i % n];
+        glm::vec3           binormal = glm::cross(frame.tangent, frame.normal);
+
+        if ( i > 0 )
+            v += glm::length(frame.point - frames[i - 1].point);
+
+        // One more vertex than sides, for the seam in u
+        for ( int k = 0 ; k <= sides ; k++ )
+        {
+            float       angle = 2.0f * (float)M_PI * k / sides;
+            glm::vec3   out = frame.normal * cosf(angle) + binormal * sinf(angle);
+
+            vertices.push_back(Vertex{ frame.point + out * radius
+                                     , glm::vec2((float)k / sides, v), out });
+        }
+    }
+
+    // Counter-clockwise seen from outside
+    unsigned int    stride = sides + 1;
+    for ( unsigned int i = 0 ; i + 1 < rings ; i++ )
+        for ( unsigned int k = 0 ; k < (unsigned int)sides ; k++ )
+        {
+            unsigned int    a = first + i * stride + k, b = a + stride;
+
+            indices.insert(indices.end(), { a, a + 1, b + 1 });
+            indices.insert(indices.end(), { a, b + 1, b });
+        }
+}
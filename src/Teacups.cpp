@@ -7,13 +7,15 @@
 #include <FL/math.h>
 #include <GL/glu.h>
 #include <cmath>
+#include <cstddef>
 #include <stdio.h>
 #include <iostream>
 #include <math.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
 #include "Teacups.h"
-#include "GenericException.h"
-#include "objloader.h"
-#include "libtarga.h"
+#include "CompiledMesh.h"
+#include "MeshShader.h"
 
 // Destructor
 Teacups::~Teacups(void)
@@ -21,49 +23,42 @@ Teacups::~Teacups(void)
     if ( initialized )
     {
         glDeleteLists(track_list, 1);
-        glDeleteTextures(1, &texture_obj);
-        glDeleteBuffers(1, &vertexbuffer);
-        glDeleteBuffers(1, &uvbuffer);
-        glDeleteBuffers(1, &normalbuffer);
     }
 }
 
 
+// Decodes the texture and maps the model. This touches no GL state, so it
+// can run on a loader thread ahead of Initialize().
+bool
+Teacups::Load(void)
+{
+    if ( ! texture && ! ( texture = TextureCache::Shared().Acquire("teacup_tex.tga", REPEAT_LINEAR) ) )
+        return false;
+    if ( ! teacup_mesh.Loaded() && ! teacup_mesh.Load("teacup_car.obj") )
+        return false;
+    return true;
+}
+
+
 // Initializer. Would return false if anything could go wrong.
 bool
 Teacups::Initialize(void)
 {
-    // Load textures
-    ubyte   *image_data;
-    int	    image_height, image_width;
-    if ( ! ( image_data = (ubyte*)tga_load("teacup_tex.tga", &image_width, &image_height, TGA_TRUECOLOR_24) ) )
-    {
-        fprintf(stderr, "Ground::Initialize: Couldn't load teacup_tex.tga\n");
+    // Decode the texture and map the model, unless Load() already did
+    if ( ! Load() )
         return false;
-    }
 
-    // create texture object
-    glGenTextures(1, &texture_obj);
-    glBindTexture(GL_TEXTURE_2D, texture_obj);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    // the teacups are drawn with the mesh shader
+    if ( ! MeshShader::Shared().Initialize() )
+        return false;
 
-    // set the texture wrapping/filtering options (on the currently bound texture object)
-    //gluBuild2DMipmaps(GL_TEXTURE_2D,3, image_width, image_height, GL_RGB, GL_UNSIGNED_BYTE, image_data);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // upload the texture, unless another object already did
+    if ( ! texture->Upload() )
+        return false;
 
     // multiply texture by underlying color
     glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE); 
 
-    // load and generate the texture
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, image_width, image_height, 0, GL_RGB, GL_UNSIGNED_BYTE, image_data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    // free the image data
-    free(image_data);
-
     // make the spinning track
     GLUquadric* quad = gluNewQuadric();
     gluQuadricNormals(quad, GLU_SMOOTH);
@@ -84,66 +79,19 @@ Teacups::Initialize(void)
     // Destroy the quadratics object
     gluDeleteQuadric(quad);
 
-    // Load the teacup model
-    if (!ObjLoader("teacup_car.obj", teacup_vertices, teacup_uvs, teacup_normals))
-        throw new GenericException("Teacups::C - Failed to load teacup");
+    // vertex and index buffers, with the vertices packed to half size, and
+    // the VAO that records their layout
+    if ( ! teacup_buffer.Upload(teacup_mesh, VERTEX_PACKED) )
+        return false;
+
+    // and every teacup in one draw
+    teacup_instances.Upload();
+    teacup_buffer.Attach(teacup_instances);
 
-    /*
-    // verify uvs are correct: they are all [0, 1]
-    for (auto &uv : teacup_uvs)
-    {
-        std::cerr << uv.x << ' ' << uv.y << std::endl;
-    }
-    // verify all sizes are the same: they are
-    std::cerr << teacup_vertices.size() << ' ' << teacup_uvs.size() << ' ' << teacup_normals.size() << std::endl;
-    */
-
-    // Binding to a VAO is breaking the object
-    //glGenVertexArrays(1, &VAO);
-    //glBindVertexArray(VAO);
-
-    // The VAO should allow me to do
-    // glEnableVertexAttribArray(); and glVertexAttribPointer(); calls once during initialization
-    // instead of every Draw() call. The buffers would be bound to the VAO then I just bind the VAO 
-    // in the Draw() function and call glDrawElements() instead of glDrawArrays() but I believe this
-    // breaking because I have no shaders so instead I have to used the fixed function pipeline
-    // and call glVertexPointer(3, GL_FLOAT, 0, nullptr); glTexCoordPointer(2, GL_FLOAT, 0, nullptr);
-    // glNormalPointer(GL_FLOAT, 0, nullptr); to specify how the objects are stored followed by a call
-    // to glDrawArrays(). OpenGL implicitly binds these to a vertex array object each time anyway, but 
-    // it would just be more efficient to make my own and the glDeleteVertexArrays() would also do the 
-    // cleanup. I just can't figure out how to do it properly without a broken object. Our lighting 
-    // simple system is also causing issues. The nullptr in the previous function calls just makes
-    // openGL look at the currently bound GL_ARRAY_BUFFER instead of another array.
-
-    // vertexbuffer
-    glGenBuffers(1, &vertexbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-    glBufferData(
-        GL_ARRAY_BUFFER, 
-        teacup_vertices.size() * sizeof(glm::vec3), 
-        teacup_vertices.data(), 
-        GL_STATIC_DRAW
-    );
-
-    // uvbuffer
-	glGenBuffers(1, &uvbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-	glBufferData(
-        GL_ARRAY_BUFFER, 
-        teacup_uvs.size() * sizeof(glm::vec2), 
-        teacup_uvs.data(), 
-        GL_STATIC_DRAW
-    );
-
-    // normalbuffer
-	glGenBuffers(1, &normalbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-	glBufferData(
-        GL_ARRAY_BUFFER, 
-        teacup_normals.size() * sizeof(glm::vec3), 
-        teacup_normals.data(), 
-        GL_STATIC_DRAW
-    );
+    Update_Bounds();
+
+    // The GL has its own copy now
+    teacup_mesh.Close();
 
     initialized = true;
 
@@ -152,72 +100,32 @@ Teacups::Initialize(void)
 
 // Draw
 void
-Teacups::Draw(void)
+Teacups::Draw(const glm::mat4 &model, RenderQueue &queue)
 {
+    if ( ! initialized )
+        return;
+
     // Draw the track
+    glm::mat4 spin = glm::rotate(model, glm::radians((float)theta), glm::vec3(0.0f, 0.0f, 1.0f));
     glPushMatrix();
-    glRotatef(theta, 0.0f, 0.0f, 1.0f);
+    glMultMatrixf(glm::value_ptr(spin));
     glCallList(track_list);
+    glPopMatrix();
 
-    // Draw the teacups VAO is breaking
-    //glBindVertexArray(VAO);
-    
-    // If I could get the VAO working glEnableVertexAttribArray(); and glVertexAttribPointer();
-    // would only need to be done once in Initialize();
-
-    // Draw the teacups
-	// Use white, because the texture supplies the color.
-    glColor3f(1.0f, 1.0f, 1.0f);
-
-    // Enable 2D texturing
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, texture_obj);
-
-    // Enable client states for vertex,
-    // texture coordinate,
-    // and normal arrays
-    glEnableClientState(GL_VERTEX_ARRAY);
-    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-    glEnableClientState(GL_NORMAL_ARRAY);
-
-    // Bind the vertex buffer
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-    glVertexPointer(3, GL_FLOAT, 0, (void*)0);
-
-    // Bind the texture coordinate buffer
-    glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-    glTexCoordPointer(2, GL_FLOAT, 0, (void*)0);
-
-    // Bind the normal buffer
-    glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-    glNormalPointer(GL_FLOAT, 0, (void*)0);
-
-    // Draw the teacups
-    glColor3f(1.0f, 1.0f, 1.0f); // using GL_MODULATE
-
-    glPushMatrix();
-    glTranslatef(0.0f, 0.0f, 1.0f);
-
+    // Where each teacup is on the track
+    teacup_instances.Clear();
     for (int i = 0; i < num_teacups; ++i)
     {
-        glPushMatrix();
-        glRotatef(step * i, 0.0f, 0.0f, 1.0f);
-        glTranslatef(dist, 0.0f, 0.0f);
-        glRotatef(theta * 3, 0.0f, 0.0f, 1.0f);
-        glDrawArrays(GL_TRIANGLES, 0, teacup_vertices.size());
-        glPopMatrix();
+        glm::mat4 teacup = glm::rotate(glm::mat4(1.0f), glm::radians((float)( step * i )), glm::vec3(0.0f, 0.0f, 1.0f));
+        teacup = glm::translate(teacup, glm::vec3((float)dist, 0.0f, 0.0f));
+        teacup = glm::rotate(teacup, glm::radians((float)( theta * 3 )), glm::vec3(0.0f, 0.0f, 1.0f));
+        teacup_instances.Add(teacup);
     }
-    
-    glPopMatrix();  // translating teacups upwards
-    glPopMatrix();  // global object rotation
-
-    // Disable client states
-    glDisableClientState(GL_VERTEX_ARRAY);
-    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-    glDisableClientState(GL_NORMAL_ARRAY);
 
-    // Disable 2D texturing
-    glDisable(GL_TEXTURE_2D);
+    // Draw the teacups, all at once, translated upwards. White, because
+    // the texture supplies the color.
+    queue.Submit(teacup_buffer, texture.get(), glm::translate(spin, glm::vec3(0.0f, 0.0f, 1.0f))
+                , glm::vec4(1.0f), teacup_instances, false);
 }
 
 
@@ -232,3 +140,37 @@ Teacups::Update(float dt)
 }
 
 
+// The mapping is only held until Initialize() has uploaded it.
+void
+Teacups::Print_Stats(FILE *out) const
+{
+    teacup_buffer.Print_Stats(out, "teacup_car.obj", teacup_mesh.Loaded() ? teacup_mesh.Resident_Bytes() : 0);
+}
+
+
+// Around the track, and the ring the cups sweep out as they spin.
+void
+Teacups::Update_Bounds(void)
+{
+    BoundingSphere  cup = teacup_buffer.Bounds();
+    BoundingSphere  track = { glm::vec3(0.0f, 0.0f, height * 0.5f)
+                            , glm::length(glm::vec2(radius, height * 0.5f)) };
+    BoundingSphere  ring = { glm::vec3(0.0f, 0.0f, 1.0f + cup.centre.z)
+                           , (float)dist + glm::length(glm::vec2(cup.centre.x, cup.centre.y)) + cup.radius };
+    bounds = Bounding_Union(track, ring);
+}
+
+
+// A rebaked model is mapped on the watcher's thread and uploaded into the
+// same buffers.
+void
+Teacups::Watch(AssetWatcher &watcher)
+{
+    watcher.Watch(CompiledMesh::Cache_Name("teacup_car.obj")
+                 , [this] { return teacup_mesh.Load("teacup_car.obj"); }
+                 , [this] {
+                       teacup_buffer.Upload(teacup_mesh, VERTEX_PACKED);
+                       teacup_mesh.Close();
+                       Update_Bounds();
+                   });
+}
@@ -0,0 +1,309 @@
+/*
+ * TextureCache.cpp: Textures shared between scene objects.
+ */
+
+#include <GL/glew.h>
+#include <stdio.h>
+#include <tuple>
+#include <vector>
+#include "TextureCache.h"
+
+bool
+TextureSampler::operator<(const TextureSampler &other) const
+{
+    return std::tie(wrap_s, wrap_t, min_filter, mag_filter)
+         < std::tie(other.wrap_s, other.wrap_t, other.min_filter, other.mag_filter);
+}
+
+bool
+TextureSampler::Mipmapped(void) const
+{
+    return min_filter != GL_NEAREST && min_filter != GL_LINEAR;
+}
+
+
+// Decodes the file, if nobody has tried yet. Threads asking for the same
+// image at once wait for the first one.
+bool
+TextureCache::Image::Decode(const std::string &filename, bool compressed_ok)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if ( ! tried )
+    {
+        tried = true;
+        baked.Load(filename.c_str());
+    }
+    if ( baked.Loaded() && ! Use_Baked(compressed_ok) )
+    {
+        baked.Close();
+        baked.Load(filename.c_str(), true);
+    }
+    if ( ! Use_Baked(compressed_ok) && ! pixels.Loaded() )
+        pixels.Load(filename.c_str(), TGA_TRUECOLOR_24);
+
+    return Use_Baked(compressed_ok) || pixels.Loaded();
+}
+
+bool
+TextureCache::Image::Use_Baked(bool compressed_ok) const
+{
+    return baked.Loaded() && ( compressed_ok || ! baked.Compressed() );
+}
+
+
+TextureCache::Texture::~Texture(void)
+{
+    if ( object )
+        glDeleteTextures(1, &object);
+}
+
+bool
+TextureCache::Texture::Upload(void)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    // Drivers without S3TC get the plain copy of a compressed .ptex.
+    bool    compressed_ok = GLEW_EXT_texture_compression_s3tc;
+
+    if ( object && ! image )
+        return true;
+    if ( ! image || ! image->Decode(filename, compressed_ok) )
+        return false;
+
+    // A reload goes into the same texture object.
+    if ( ! object )
+        glGenTextures(1, &object);
+    glBindTexture(GL_TEXTURE_2D, object);
+    bytes = 0;
+
+    // The rows are packed tightly, 3 bytes a pixel.
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, sampler.wrap_s);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, sampler.wrap_t);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, sampler.min_filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, sampler.mag_filter);
+
+    if ( image->Use_Baked(compressed_ok) )
+        Upload_Baked(image->baked);
+    else
+        Upload_Pixels(image->pixels);
+
+    // The pixels are on the GPU now. The last texture made from the image
+    // frees it.
+    image.reset();
+
+    return true;
+}
+
+// Uploads the levels of a .ptex as they are: all of them for a mipmapped
+// sampler, otherwise just the top one.
+void
+TextureCache::Texture::Upload_Baked(const CompiledTexture &baked)
+{
+    GLenum      internal = baked.Format() == PTEX_BC3 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+                                                      : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    uint32_t    levels = sampler.Mipmapped() ? baked.Num_Levels() : 1;
+
+    for ( uint32_t i = 0 ; i < levels ; i++ )
+    {
+        const PTexLevel &level = baked.Level(i);
+
+        if ( baked.Compressed() )
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, internal, level.width, level.height, 0
+                                  , (GLsizei)level.size, baked.Level_Data(i));
+        else
+            glTexImage2D(GL_TEXTURE_2D, i, GL_RGB, level.width, level.height, 0
+                        , GL_RGB, GL_UNSIGNED_BYTE, baked.Level_Data(i));
+        bytes += level.size;
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+}
+
+void
+TextureCache::Texture::Upload_Pixels(const TgaImage &pixels)
+{
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, pixels.Width(), pixels.Height(), 0
+                , GL_RGB, GL_UNSIGNED_BYTE, pixels.Data());
+    bytes = (size_t)pixels.Width() * pixels.Height() * 3;
+
+    // Only build mipmaps for samplers that read them; the chain costs
+    // another third.
+    if ( sampler.Mipmapped() )
+    {
+        glGenerateMipmap(GL_TEXTURE_2D);
+        bytes += bytes / 3;
+    }
+}
+
+void
+TextureCache::Texture::Bind(void) const
+{
+    glBindTexture(GL_TEXTURE_2D, object);
+}
+
+
+TextureCache&
+TextureCache::Shared(void)
+{
+    static TextureCache cache;
+    return cache;
+}
+
+TextureCache::Handle
+TextureCache::Acquire(const char *filename, const TextureSampler &sampler)
+{
+    Handle  texture;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        std::weak_ptr<Texture>  &slot = textures[Key(filename, sampler)];
+        texture = slot.lock();
+        if ( texture )
+            hits++;
+        else
+        {
+            // Another sampler may be using the same file.
+            std::weak_ptr<Image>    &image_slot = images[filename];
+            std::shared_ptr<Image>  image = image_slot.lock();
+            if ( ! image )
+            {
+                image = std::make_shared<Image>();
+                image_slot = image;
+                decodes++;
+            }
+
+            texture = std::make_shared<Texture>(filename, sampler, image);
+            slot = texture;
+            misses++;
+        }
+    }
+
+    // Decode outside the cache's lock, so different files can go at once.
+    std::shared_ptr<Image>  image;
+    {
+        std::lock_guard<std::mutex> guard(texture->lock);
+        image = texture->image;
+    }
+    if ( image && ! image->Decode(texture->filename) )
+        return nullptr;
+
+    return texture;
+}
+
+uint32_t
+TextureCache::Hits(void)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return hits;
+}
+
+uint32_t
+TextureCache::Misses(void)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return misses;
+}
+
+uint32_t
+TextureCache::Decodes(void)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return decodes;
+}
+
+void
+TextureCache::Print_Stats(FILE *out)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    fprintf(out, "TextureCache: %u requests, %u hits, %u misses, %u images read\n"
+           , hits + misses, hits, misses, decodes);
+
+    for ( auto &entry : textures )
+    {
+        Handle texture = entry.second.lock();
+        if ( ! texture )
+            continue;
+
+        // less the one held just here
+        fprintf(out, "    %-24s %ld handles, %zu KB\n", texture->filename.c_str()
+               , texture.use_count() - 1, texture->bytes / 1024);
+    }
+}
+
+
+bool
+TextureCache::Reload(const std::string &filename)
+{
+    // A fresh image, so nothing still uploading from the old one notices.
+    std::shared_ptr<Image>  image = std::make_shared<Image>();
+
+    if ( ! image->Decode(filename) )
+    {
+        fprintf(stderr, "TextureCache::Reload: Can't read %s, keeping the old one\n"
+               , filename.c_str());
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    bool live = false;
+    for ( auto &entry : textures )
+    {
+        Handle texture = entry.second.lock();
+        if ( ! texture || texture->filename != filename )
+            continue;
+
+        std::lock_guard<std::mutex> texture_guard(texture->lock);
+        texture->image = image;
+        live = true;
+    }
+    images[filename] = image;
+    decodes++;
+
+    return live;
+}
+
+void
+TextureCache::Refresh(const std::string &filename)
+{
+    std::vector<Handle> reloaded;
+
+    // Upload outside the cache's lock; a loader thread may want it.
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        for ( auto &entry : textures )
+        {
+            Handle texture = entry.second.lock();
+            if ( texture && texture->filename == filename )
+                reloaded.push_back(texture);
+        }
+    }
+    for ( auto &texture : reloaded )
+        texture->Upload();
+}
+
+void
+TextureCache::Watch(AssetWatcher &watcher)
+{
+    std::vector<std::string>    filenames;
+
+    // The map is sorted by file name, so samplers of one file are together.
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        for ( auto &entry : textures )
+            if ( ! entry.second.expired()
+              && ( filenames.empty() || filenames.back() != entry.first.first ) )
+                filenames.push_back(entry.first.first);
+    }
+
+    for ( auto &filename : filenames )
+        watcher.Watch(CompiledTexture::Cache_Name(filename.c_str())
+                     , [this, filename] { return Reload(filename); }
+                     , [this, filename] { Refresh(filename); });
+}
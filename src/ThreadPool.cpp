@@ -0,0 +1,48 @@
+/*
+ * ThreadPool.cpp: A fixed-size pool of worker threads.
+ */
+
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int threads)
+{
+    stopping = false;
+
+    if ( threads == 0 )
+        threads = std::thread::hardware_concurrency();
+    if ( threads == 0 )
+        threads = 2;
+
+    for ( unsigned int i = 0 ; i < threads ; i++ )
+        workers.emplace_back(&ThreadPool::Work, this);
+}
+
+ThreadPool::~ThreadPool(void)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for ( auto &worker : workers )
+        worker.join();
+}
+
+void
+ThreadPool::Work(void)
+{
+    for ( ;; )
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [this] { return stopping || ! jobs.empty(); });
+            if ( jobs.empty() )
+                return;     // stopping, and nothing left to do
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
@@ -9,12 +9,13 @@
 #include <iostream>
 #include <FL/math.h>
 #include <GL/glew.h>
-#include <GL/glu.h>
 #include <cmath>
+#include <cstddef>
+#include <glm/gtc/matrix_transform.hpp>
 #include "Track.h"
-#include "GenericException.h"
-#include "objloader.h"
-#include "libtarga.h"
+#include "CompiledMesh.h"
+#include "MeshShader.h"
+#include "SweptMesh.h"
 
 
 // The control points for the track spline.
@@ -26,6 +27,12 @@ const float Track::TRACK_CONTROLS[TRACK_NUM_CONTROLS][3] =
 // The carriage energy and mass
 const float Track::TRAIN_ENERGY = 250.0f;
 
+// The cars in the train. The first is where the camera rides.
+const int   Track::TRAIN_NUM_CARS = 3;
+
+// The rails and supports
+static const glm::vec4  TRACK_COLOR(0.6f, 0.6f, 0.6f, 1.0f);
+
 
 // Normalize a 3d vector.
 static void
@@ -45,15 +52,20 @@ Normalize_3(float v[3])
 // Destructor
 Track::~Track(void)
 {
-    if ( initialized )
-    {
-        glDeleteLists(track_list, 1);
-        glDeleteLists(train_list, 1);
-        glDeleteTextures(1, &texture_obj);
-        glDeleteBuffers(1, &vertexbuffer);
-        glDeleteBuffers(1, &uvbuffer);
-        glDeleteBuffers(1, &normalbuffer);
-    }
+    delete track;
+}
+
+
+// Decodes the texture and maps the model. This touches no GL state, so it
+// can run on a loader thread ahead of Initialize().
+bool
+Track::Load(void)
+{
+    if ( ! texture && ! ( texture = TextureCache::Shared().Acquire("car_tex.tga", REPEAT_LINEAR) ) )
+        return false;
+    if ( ! train_mesh.Loaded() && ! train_mesh.Load("train_car_uv.obj") )
+        return false;
+    return true;
 }
 
 
@@ -61,48 +73,35 @@ Track::~Track(void)
 bool
 Track::Initialize(void)
 {
-    // Load textures
-    ubyte   *image_data;
-    int	    image_height, image_width;
-    if ( ! ( image_data = (ubyte*)tga_load("car_tex.tga", &image_width, &image_height, TGA_TRUECOLOR_24) ) )
-    {
-        fprintf(stderr, "Ground::Initialize: Couldn't load car_tex.tga\n");
+    // Decode the texture and map the model, unless Load() already did
+    if ( ! Load() )
         return false;
-    }
 
-    // create texture object
-    glGenTextures(1, &texture_obj);
-    glBindTexture(GL_TEXTURE_2D, texture_obj);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    // upload the texture, unless another object already did
+    if ( ! texture->Upload() )
+        return false;
 
-    // set the texture wrapping/filtering options (on the currently bound texture object)
-    //gluBuild2DMipmaps(GL_TEXTURE_2D,3, image_width, image_height, GL_RGB, GL_UNSIGNED_BYTE, image_data);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // the train is drawn with the mesh shader
+    if ( ! MeshShader::Shared().Initialize() )
+        return false;
 
     // multiply texture by underlying color
     glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE); 
 
-    // load and generate the texture
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, image_width, image_height, 0, GL_RGB, GL_UNSIGNED_BYTE, image_data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    // free the image data
-    free(image_data);
-
     // Track spline.
-    CubicBspline    refined(3, true);
+    CubicBspline<3> refined(true);
     int		    n_refined;
     float	    p[3];
     int		    i;
 
     // Create the track spline.
-    track = new CubicBspline(3, true);
+    track = new CubicBspline<3>(true);
     for (i = 0; i < TRACK_NUM_CONTROLS; i++)
         track->Append_Control(TRACK_CONTROLS[i]);
 
+    // The train moves by distance along it.
+    track->Build_Arc_Length();
+
     // Refine it down to a fixed tolerance. This means that any point on
     // the track that is drawn will be less than 0.1 units from its true
     // location. In fact, it's even closer than that.
@@ -126,122 +125,68 @@ Track::Initialize(void)
     glEndList();
     */
 
-    // Create a quadratic object
-    GLUquadric* quad = gluNewQuadric();
-    gluQuadricNormals(quad, GLU_SMOOTH);
-    float       j{};
-    float       step{ 0.25 };
-    float       tangent[3];
-    float       axis[3];
-    double      angle{ 0.0 };
-    GLdouble    radius{ 0.15 };
-    GLdouble    height{ 0.4 };
-    GLint       slices{ 8 };
-    GLint       stacks{ 2 };
-
-    // Create the display list for the track as a swept object
-    track_list = glGenLists(1);
-    glNewList(track_list, GL_COMPILE);
-	glColor3f(0.6f, 0.6f, 0.6f);    // gray
-	for ( j = 0.0 ; j <= n_refined ; j+=step ) // loop over n_refined control points
-	{
-        // Find the point along the BSpline.
-		refined.Evaluate_Point((float)j, p);
-        glPushMatrix();
-
-        glTranslatef(p[0], p[1], p[2]);
-
-        // Find the tangent to the BSpline.
-		refined.Evaluate_Derivative((float)j, tangent);
-		Normalize_3(tangent);
-
-        // We want to orient +z in the direction of the tangent line.
-        // Find (0, 0, 1) x (t1, t2, t3). This will be our axis of rotation.
-        axis[0] = -tangent[1];
-        axis[1] = tangent[0];
-        axis[2] = 0.0f;
-        Normalize_3(axis);
-
-        // From the dot product we find the angle between +z and the tangent line to the BSpline.
-        // Rotate around 'axis', 'angle' degrees.
-        angle = acos(tangent[2]) * 180.0 / M_PI;
-        glRotatef((float)angle, axis[0], axis[1], axis[2]);
-
-        // draw the Cylinder
-        //gluCylinder(quad, radius, radius, height, slices, stacks);
-
-		glPopMatrix();
-        
-        // draw inner track
-        glPushMatrix();
-            glTranslatef(0.95 * p[0], 0.95 * p[1], p[2]);
-            glRotatef((float)angle, axis[0], axis[1], axis[2]);
-            gluCylinder(quad, radius, radius, height, slices, stacks);
-		glPopMatrix();
-
-        // draw outer track
-        glPushMatrix();
-            glTranslatef(1.05 * p[0], 1.05 * p[1], p[2]);
-            glRotatef((float)angle, axis[0], axis[1], axis[2]);
-            gluCylinder(quad, radius, radius, height, slices, stacks);
-		glPopMatrix();
-       
-        // draw cross beams
-        /*
-        if ( std::fmod(j, 1.0) == 0.0 )
-        {
-            // don't know how
-        }
-        */
+    // Sample the refined curve for the rails. Each rail is the curve
+    // pulled in or pushed out from the middle, so its tangent is scaled
+    // the same way.
+    float                   j;
+    float                   step{ 0.25f };
+    float                   radius{ 0.15f };
+    int                     slices{ 8 };
+    std::vector<float>      params, points, tangents;
+    std::vector<glm::vec3>  inner, outer, inner_tangents, outer_tangents;
+    std::vector<SweepFrame> frames;
+    std::vector<Vertex>     vertices;
+    std::vector<GLuint>     indices;
+
+    for ( j = 0.0f ; j < n_refined ; j += step )    // the loop's end is its start
+        params.push_back(j);
+    points.resize(params.size() * 3);
+    tangents.resize(params.size() * 3);
+    refined.Evaluate_Derivatives(params.data(), params.size(), points.data(), tangents.data(), NULL);
+
+    for ( size_t k = 0 ; k < params.size() ; k++ )
+    {
+        const float *p = &points[k * 3];
+        const float *tangent = &tangents[k * 3];
 
-        // add supports
-        if ( std::fmod(j, 10.0) == 0.0 )
-        {
-			glPushMatrix();
-			glTranslatef(p[0], p[1], 0.0);
-			// Draw the Support Cylinder
-			gluCylinder(quad, radius, radius, p[2], slices, stacks);
-			glPopMatrix();
-        }
-	}
-    glEndList();
+        inner.push_back(glm::vec3(0.95f * p[0], 0.95f * p[1], p[2]));
+        outer.push_back(glm::vec3(1.05f * p[0], 1.05f * p[1], p[2]));
+        inner_tangents.push_back(glm::vec3(0.95f * tangent[0], 0.95f * tangent[1], tangent[2]));
+        outer_tangents.push_back(glm::vec3(1.05f * tangent[0], 1.05f * tangent[1], tangent[2]));
+    }
 
-    // Destroy the quadratics object
-    gluDeleteQuadric(quad);
-
-    // Load my train model
-    if (!ObjLoader("train_car_uv.obj", train_vertices, train_uvs, train_normals))
-        throw new GenericException("Track::C - Failed to load track car");
-
-    // vertexbuffer
-    glGenBuffers(1, &vertexbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-    glBufferData(
-        GL_ARRAY_BUFFER, 
-        train_vertices.size() * sizeof(glm::vec3), 
-        train_vertices.data(), 
-        GL_STATIC_DRAW
-    );
-    
-    // uvbuffer
-	glGenBuffers(1, &uvbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-	glBufferData(
-        GL_ARRAY_BUFFER, 
-        train_uvs.size() * sizeof(glm::vec2), 
-        train_uvs.data(), 
-        GL_STATIC_DRAW
-    );
-
-    // normalbuffer
-	glGenBuffers(1, &normalbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-	glBufferData(
-        GL_ARRAY_BUFFER, 
-        train_normals.size() * sizeof(glm::vec3), 
-        train_normals.data(), 
-        GL_STATIC_DRAW
-    );
+    // Both rails as tubes swept along the curve, in one mesh
+    Sweep_Frames(inner, inner_tangents, true, frames);
+    Sweep_Tube(frames, radius, slices, true, vertices, indices);
+    Sweep_Frames(outer, outer_tangents, true, frames);
+    Sweep_Tube(frames, radius, slices, true, vertices, indices);
+    rails_buffer.Upload(vertices.data(), vertices.size(), indices.data(), indices.size(), VERTEX_PACKED);
+
+    // A support from the ground up to the middle of the track every ten
+    // units of the curve, in another
+    vertices.clear();
+    indices.clear();
+    for ( j = 0.0f ; j < n_refined ; j += 10.0f )
+    {
+        refined.Evaluate_Point(j, p);
+        SweepFrame  ground = { glm::vec3(p[0], p[1], 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)
+                             , glm::vec3(1.0f, 0.0f, 0.0f) };
+        SweepFrame  top = ground;
+        top.point.z = p[2];
+
+        frames.assign({ ground, top });
+        Sweep_Tube(frames, radius, slices, false, vertices, indices);
+    }
+    supports_buffer.Upload(vertices.data(), vertices.size(), indices.data(), indices.size(), VERTEX_PACKED);
+
+    // vertex and index buffers, with the vertices packed to half size
+    if ( ! train_buffer.Upload(train_mesh, VERTEX_PACKED) )
+        return false;
+
+    Update_Bounds();
+
+    // The GL has its own copy now
+    train_mesh.Close();
 
     initialized = true;
 
@@ -251,89 +196,59 @@ Track::Initialize(void)
 
 // Draw
 void
-Track::Draw(void)
+Track::Draw(RenderQueue &queue)
 {
-    float   posn[3];
-    float   tangent[3];
+    float   cars[TRAIN_NUM_CARS];
+    float   posns[TRAIN_NUM_CARS][3];
+    float   tangents[TRAIN_NUM_CARS][3];
     double  angle;
 
     if ( ! initialized )
 	return;
 
-    glPushMatrix();
+    // Draw the track, gray
+    queue.Submit(rails_buffer, nullptr, glm::mat4(1.0f), TRACK_COLOR);
+    queue.Submit(supports_buffer, nullptr, glm::mat4(1.0f), TRACK_COLOR);
 
-    // Draw the track
-    glCallList(track_list);
+    // Each car follows a car length behind the one in front, by distance
+    // along the track, so they stay evenly spaced however it curves. The
+    // car's bounding sphere is at least as wide as it is long, so they
+    // never touch.
+    float   car_length = 2.0f * train_buffer.Bounds().radius;
 
-    for (int i = 0; i < 1; ++i)
+    cars[0] = posn_on_track;
+    for (int i = 1; i < TRAIN_NUM_CARS; ++i)
+        cars[i] = track->Arc_Parameter(dist_on_track - car_length * i);
+
+    // Figure out where the cars are, and which way they're going
+    track->Evaluate_Derivatives(cars, TRAIN_NUM_CARS, posns[0], tangents[0], NULL);
+
+    for (int i = 0; i < TRAIN_NUM_CARS; ++i)
     {
-        glPushMatrix();
-        
-        //float train_pos = posn_on_track + 0.11 * i;
-        //if ( train_pos > track->N() )
-        //train_pos -= track->N();
-        
-        // Figure out where the train is
-        track->Evaluate_Point(posn_on_track, posn);
+        float   *posn = posns[i];
+        float   *tangent = tangents[i];
 
         // Translate the train to the point
         // move it a little above the track
-        glTranslatef(posn[0], posn[1], posn[2]+0.3);
+        glm::mat4 car = glm::translate(glm::mat4(1.0f), glm::vec3(posn[0], posn[1], posn[2] + 0.3f));
 
         // ...and what it's orientation is
-        track->Evaluate_Derivative(posn_on_track, tangent);
         Normalize_3(tangent);
 
         // Rotate it to point along the track, but stay horizontal
-        angle = atan2(tangent[1], tangent[0]) * 180.0 / M_PI;
-        glRotatef((float)angle, 0.0f, 0.0f, 1.0f);
+        angle = atan2(tangent[1], tangent[0]);
+        car = glm::rotate(car, (float)angle, glm::vec3(0.0f, 0.0f, 1.0f));
 
         // Another rotation to get the tilt right.
-        angle = asin(-tangent[2]) * 180.0 / M_PI;
-        glRotatef((float)angle, 0.0f, 1.0f, 0.0f);
+        angle = asin(-tangent[2]);
+        car = glm::rotate(car, (float)angle, glm::vec3(0.0f, 1.0f, 0.0f));
 
         // Because the car was sideways
-        glRotatef((float)90, 0.0f, 0.0f, -1.0f);
-
-        // Use white, because the texture supplies the color.
-        glColor3f(1.0f, 1.0f, 1.0f);
-
-        // Enable 2D texturing
-        glEnable(GL_TEXTURE_2D);
-        glBindTexture(GL_TEXTURE_2D, texture_obj);
-
-        // Enable client states for vertex,
-        // texture coordinate,
-        // and normal arrays
-        glEnableClientState(GL_VERTEX_ARRAY);
-        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-        glEnableClientState(GL_NORMAL_ARRAY);
-
-        // Bind the vertex buffer
-        glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-        glVertexPointer(3, GL_FLOAT, 0, (void*)0);
-
-        // Bind the texture coordinate buffer
-        glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-        glTexCoordPointer(2, GL_FLOAT, 0, (void*)0);
-
-        // Bind the normal buffer
-        glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-        glNormalPointer(GL_FLOAT, 0, (void*)0);
-
-        // Draw the train car
-        glDrawArrays(GL_TRIANGLES, 0, train_vertices.size());
-        
-        // Disable client states
-        glDisableClientState(GL_VERTEX_ARRAY);
-        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-        glDisableClientState(GL_NORMAL_ARRAY);
-
-        glPopMatrix();
-        glPopMatrix();
-
-        // Disable 2D texturing
-        glDisable(GL_TEXTURE_2D);
+        car = glm::rotate(car, glm::radians(90.0f), glm::vec3(0.0f, 0.0f, -1.0f));
+
+        // Draw the train car. Use white, because the texture supplies the
+        // color.
+        queue.Submit(train_buffer, texture.get(), car, glm::vec4(1.0f));
     }
 }
 
@@ -341,48 +256,63 @@ Track::Draw(void)
 void
 Track::Update(float dt, float *pos, float *dir)
 {
-    float   point[3];
-    float   deriv[3];
-    double  length;
-    double  parametric_speed;
-
     if ( ! initialized )
 	return;
 
     // First we move the train along the track with its current speed.
-
-    // Get the derivative at the current location on the track.
-    track->Evaluate_Derivative(posn_on_track, deriv);
-
-    // Get its length.
-    length = sqrt(deriv[0]*deriv[0] + deriv[1]*deriv[1] + deriv[2]*deriv[2]);
-    if ( length == 0.0 )
-	return;
-
-    // The parametric speed is the world train speed divided by the length
-    // of the tangent vector.
-    parametric_speed = speed / length;
-
-    // Now just evaluate dist = speed * time, for the parameter.
-    posn_on_track += (float)(parametric_speed * dt);
+    // Just evaluate dist = speed * time, and look up the parameter there.
+    dist_on_track += speed * dt;
 
     // If we've just gone around the track, reset back to the start.
-    if ( posn_on_track > track->N() )
-	posn_on_track -= track->N();
+    if ( dist_on_track > track->Length() )
+	dist_on_track -= track->Length();
+    posn_on_track = track->Arc_Parameter(dist_on_track);
+
+    // Get camera parameters, the point and direction in one go
+    track->Evaluate_Derivatives(&posn_on_track, 1, pos, dir, NULL);
+    Normalize_3(dir);
 
     // As the second step, we use conservation of energy to set the speed
     // for the next time.
     // The total energy = z * gravity + 1/2 speed * speed, assuming unit mass
-    track->Evaluate_Point(posn_on_track, point);
-    if ( TRAIN_ENERGY - 9.81 * point[2] < 0.0 )
+    if ( TRAIN_ENERGY - 9.81 * pos[2] < 0.0 )
 	speed = 0.0;
     else
-	speed = (float)sqrt(2.0 * ( TRAIN_ENERGY - 9.81 * point[2] ));
+	speed = (float)sqrt(2.0 * ( TRAIN_ENERGY - 9.81 * pos[2] ));
+}
 
-    // Get camera parameters
-	track->Evaluate_Point(posn_on_track, pos);
-    track->Evaluate_Derivative(posn_on_track, dir);
-    Normalize_3(dir);
+
+// The mapping is only held until Initialize() has uploaded it.
+void
+Track::Print_Stats(FILE *out) const
+{
+    train_buffer.Print_Stats(out, "train_car_uv.obj", train_mesh.Loaded() ? train_mesh.Resident_Bytes() : 0);
+    rails_buffer.Print_Stats(out, "track rails", 0);
+    supports_buffer.Print_Stats(out, "track supports", 0);
+}
+
+
+// Around the rails and supports, grown by the car riding on them.
+void
+Track::Update_Bounds(void)
+{
+    BoundingSphere  car = train_buffer.Bounds();
+
+    bounds = Bounding_Union(rails_buffer.Bounds(), supports_buffer.Bounds());
+    bounds.radius += 0.3f + glm::length(car.centre) + car.radius;
 }
 
 
+// A rebaked model is mapped on the watcher's thread and uploaded into the
+// same buffers.
+void
+Track::Watch(AssetWatcher &watcher)
+{
+    watcher.Watch(CompiledMesh::Cache_Name("train_car_uv.obj")
+                 , [this] { return train_mesh.Load("train_car_uv.obj"); }
+                 , [this] {
+                       train_buffer.Upload(train_mesh, VERTEX_PACKED);
+                       train_mesh.Close();
+                       Update_Bounds();
+                   });
+}
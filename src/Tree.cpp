@@ -3,10 +3,19 @@
  */
 
 
+#include <GL/glew.h>
 #include <stdio.h>
-#include <GL/glu.h>
+#include <math.h>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
 #include "Tree.h"
-#include "libtarga.h"
+#include "MeshShader.h"
+#include "Vertex.h"
+
+// Sides around the trunk and the foliage, as the old quadrics had.
+const int       TREE_SLICES = 16;
+
+const glm::vec4 TRUNK_COLOR(0.2f, 0.15f, 0.1f, 1.0f);  // brown
 
 // create a map of (Season, color array) pairs; this will set the foliage color based on season.
 const std::map<Season, std::array<GLfloat, 3>> Tree::foliageColors = {
@@ -16,11 +25,65 @@ const std::map<Season, std::array<GLfloat, 3>> Tree::foliageColors = {
         {WINTER, {0.6f, 0.6f, 0.6f}}    // snowy
 };
 
+
+// The side of a cylinder or cone around z, like gluCylinder: smooth
+// normals, leaning out by the slope, and no ends.
+static void
+Add_Cylinder(std::vector<Vertex> &vertices, std::vector<GLuint> &indices
+            , GLfloat base_radius, GLfloat top_radius, GLfloat base, GLfloat height)
+{
+    GLuint  first = (GLuint)vertices.size();
+    GLfloat slope = ( base_radius - top_radius ) / height;
+
+    for ( int i = 0 ; i <= TREE_SLICES ; i++ )
+    {
+        float       angle = 2.0f * (float)M_PI * i / TREE_SLICES;
+        glm::vec3   out(cosf(angle), sinf(angle), 0.0f);
+        glm::vec3   normal = glm::normalize(glm::vec3(out.x, out.y, slope));
+        float       u = (float)i / TREE_SLICES;
+
+        vertices.push_back(Vertex{ out * base_radius + glm::vec3(0.0f, 0.0f, base)
+                                 , glm::vec2(u, 0.0f), normal });
+        vertices.push_back(Vertex{ out * top_radius + glm::vec3(0.0f, 0.0f, base + height)
+                                 , glm::vec2(u, 1.0f), normal });
+    }
+
+    for ( GLuint i = 0 ; i < (GLuint)TREE_SLICES ; i++ )
+    {
+        GLuint  bottom = first + i * 2, top = bottom + 1;
+
+        indices.insert(indices.end(), { bottom, bottom + 2, top + 2 });
+        if ( top_radius > 0.0f )    // a cone's point has nothing above it
+            indices.insert(indices.end(), { bottom, top + 2, top });
+    }
+}
+
+// A disk facing down, like gluDisk with GLU_INSIDE.
+static void
+Add_Disk(std::vector<Vertex> &vertices, std::vector<GLuint> &indices
+        , GLfloat radius, GLfloat height)
+{
+    GLuint      centre = (GLuint)vertices.size();
+    glm::vec3   down(0.0f, 0.0f, -1.0f);
+
+    vertices.push_back(Vertex{ glm::vec3(0.0f, 0.0f, height), glm::vec2(0.5f, 0.5f), down });
+    for ( int i = 0 ; i <= TREE_SLICES ; i++ )
+    {
+        float   angle = 2.0f * (float)M_PI * i / TREE_SLICES;
+        float   c = cosf(angle), s = sinf(angle);
+
+        vertices.push_back(Vertex{ glm::vec3(c * radius, s * radius, height)
+                                 , glm::vec2(0.5f + 0.5f * c, 0.5f + 0.5f * s), down });
+    }
+
+    for ( GLuint i = 0 ; i < (GLuint)TREE_SLICES ; i++ )
+        indices.insert(indices.end(), { centre, centre + i + 2, centre + i + 1 });
+}
+
+
 // Constructor
 Tree::Tree(Season s, GLfloat trunkHeight, GLfloat trunkRadius, GLfloat foliageHeight, GLfloat foliageRadius)
-    : display_list { 0 }
-    //, texture_obj{0}
-    , initialized{ false }
+    : initialized{ false }
     , season{ s }
     , trunkHeight{ trunkHeight }
     , trunkRadius{ trunkRadius }
@@ -28,16 +91,6 @@ Tree::Tree(Season s, GLfloat trunkHeight, GLfloat trunkRadius, GLfloat foliageHe
     , foliageRadius{ foliageRadius } 
 {}
 
-// Destructor
-Tree::~Tree(void)
-{
-    if ( initialized )
-    {
-		glDeleteLists(display_list, 1);
-		//glDeleteTextures(1, &texture_obj);
-    }
-}
-
 
 // Initializer. Returns false if something went wrong
 bool
@@ -45,42 +98,57 @@ Tree::Initialize(void)
 {
     if (initialized) return true;   // already initialized
 
-    // Create the display list.
-    display_list = glGenLists(1);
-    glNewList(display_list, GL_COMPILE);
-
-    // Create a quadratic object
-    GLUquadric *quad = gluNewQuadric();
-    gluQuadricNormals(quad, GLU_SMOOTH);
+    // the trees are drawn with the mesh shader
+    if ( ! MeshShader::Shared().Initialize() )
+        return false;
 
-    // Draw the trunk as a cylinder
-    glColor3f(0.2f, 0.15f, 0.1f);   // brown
-    gluCylinder(quad, trunkRadius, trunkRadius, trunkHeight, 16, 4);
+    std::vector<Vertex> vertices;
+    std::vector<GLuint> indices;
 
-    // Draw the foliage as a cone
-    glColor3fv(foliageColors.at(season).data());    // foliage color based on season
-    glTranslatef(0.0f, 0.0f, trunkHeight);          // place foliage on top of the trunk
-    gluCylinder(quad, foliageRadius, 0.0f, foliageHeight, 16, 4);
+    // The trunk as a cylinder
+    Add_Cylinder(vertices, indices, trunkRadius, trunkRadius, 0.0f, trunkHeight);
+    trunk.Upload(vertices.data(), vertices.size(), indices.data(), indices.size(), VERTEX_FLOAT);
 
-    // Draw the bottom of the foliage as a disk
-    gluQuadricOrientation(quad, GLU_INSIDE);   // have normals face -z
-    gluDisk(quad, 0.0f, foliageRadius, 16, 1);
+    // The foliage as a cone on top of the trunk, with a disk underneath
+    vertices.clear();
+    indices.clear();
+    Add_Cylinder(vertices, indices, foliageRadius, 0.0f, trunkHeight, foliageHeight);
+    Add_Disk(vertices, indices, foliageRadius, trunkHeight);
+    foliage.Upload(vertices.data(), vertices.size(), indices.data(), indices.size(), VERTEX_FLOAT);
 
-    // Destroy the quadratics object
-    gluDeleteQuadric(quad);
-
-    glEndList();
+    // Both read the same instances
+    instances.Upload();
+    trunk.Attach(instances);
+    foliage.Attach(instances);
 
     initialized = true;
     return true;
 }
 
 
-// Draw just calls the display list we set up earlier.
 void
-Tree::Draw(void)
+Tree::Plant(const glm::vec3 &position)
+{
+    Plant(position, season);
+}
+
+void
+Tree::Plant(const glm::vec3 &position, Season s)
+{
+    const std::array<GLfloat, 3> &color = foliageColors.at(s);
+
+    instances.Add(glm::translate(glm::mat4(1.0f), position)
+                 , glm::vec4(color[0], color[1], color[2], 1.0f));
+}
+
+
+// Queues the trunks, and the foliage tinted by each tree's season.
+void
+Tree::Draw(RenderQueue &queue)
 {
-    glPushMatrix();
-    glCallList(display_list);
-    glPopMatrix();
+    if ( ! initialized )
+        return;
+
+    queue.Submit(trunk, nullptr, glm::mat4(1.0f), TRUNK_COLOR, instances, false);
+    queue.Submit(foliage, nullptr, glm::mat4(1.0f), glm::vec4(1.0f), instances, true);
 }
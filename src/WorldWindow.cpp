@@ -8,11 +8,22 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <future>
+#include <vector>
 #include <GL/glew.h>
 #include <FL/math.h>
 #include <FL/gl.h>
+#include <FL/fl_ask.H>
 #include <GL/glu.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
 #include "WorldWindow.h"
+#include "Assets.h"
+#include "MeshShader.h"
+#include "TextureCache.h"
+#include "ThreadPool.h"
 
 const double WorldWindow::FOV_X = 45.0;
 
@@ -36,6 +47,7 @@ WorldWindow::WorldWindow(int x, int y, int width, int height, char *label)
     train_dir[0] = train_dir[1] = train_dir[2] = 0.0f; 
 
     camera = FREE_CAM;
+    frame_tested = frame_culled = 0;
     // Initial viewing parameters.
     phi = 45.0f;
     theta = 0.0f;
@@ -43,6 +55,59 @@ WorldWindow::WorldWindow(int x, int y, int width, int height, char *label)
     x_at = 0.0f;
     y_at = 0.0f;
 
+    // Plant the forests
+    for (unsigned int i = 0; i < springForest.size(); i += 3)
+        springTree.Plant(glm::vec3(springForest.at(i), springForest.at(i+1), springForest.at(i+2)));
+    for (unsigned int i = 0; i < summerForest.size(); i += 3)
+        summerTree.Plant(glm::vec3(summerForest.at(i), summerForest.at(i+1), summerForest.at(i+2)));
+    for (unsigned int i = 0; i < fallForest.size(); i += 3)
+        fallTree.Plant(glm::vec3(fallForest.at(i), fallForest.at(i+1), fallForest.at(i+2)));
+    for (unsigned int i = 0; i < winterForest.size(); i += 3)
+        winterTree.Plant(glm::vec3(winterForest.at(i), winterForest.at(i+1), winterForest.at(i+2)));
+}
+
+
+void
+WorldWindow::Load_Assets(void)
+{
+    auto    start = std::chrono::steady_clock::now();
+
+    // Each object only touches its own members and the texture cache, which
+    // locks, in Load(), so they can all go at once. Anything that fails here
+    // is reported by the object and caught again when Initialize() retries it.
+    std::vector<std::future<bool>>  loads;
+    {
+        ThreadPool  pool;
+
+        loads.push_back(pool.Submit([this] { return ground.Load(); }));
+        loads.push_back(pool.Submit([this] { return traintrack.Load(); }));
+        loads.push_back(pool.Submit([this] { return teacups.Load(); }));
+        loads.push_back(pool.Submit([this] { return carousel.Load(); }));
+        loads.push_back(pool.Submit([this] { return globe.Load(); }));
+        loads.push_back(pool.Submit([this] { return hill.Load(); }));
+    }
+
+    int failed = 0;
+    for ( auto &load : loads )
+    {
+        try {
+            if ( ! load.get() )
+                failed++;
+        }
+        catch ( ... ) {
+            failed++;
+        }
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "WorldWindow::Load_Assets: %zu objects in %.2f ms"
+           , loads.size(), ms);
+    if ( failed )
+        fprintf(stderr, ", %d failed", failed);
+    fprintf(stderr, "\n");
+
+    TextureCache::Shared().Print_Stats(stderr);
 }
 
 
@@ -66,6 +131,17 @@ WorldWindow::draw(void)
             fprintf(stderr, "Error: %s\n", glewGetErrorString(err));
         }
 
+        // The rides, trees, globe and hill are all drawn with the mesh
+        // shader, and without it each would quietly fail to initialize.
+        // Say so once, here, and stop, rather than show an empty park.
+        if ( ! MeshShader::Shared().Initialize() )
+        {
+            fprintf(stderr, "WorldWindow: The mesh shader needs OpenGL 3.0\n");
+            fl_alert("This park needs OpenGL 3.0, which this display can't give it.\n"
+                     "The terminal says why.");
+            exit(1);
+        }
+
         double	fov_y;
 
         // Sets the clear color to sky blue.
@@ -94,11 +170,12 @@ WorldWindow::draw(void)
         // Set up the viewport.
         glViewport(0, 0, w(), h());
 
-        // Set up the persepctive transformation.
-        glMatrixMode(GL_PROJECTION);
-        glLoadIdentity();
+        // Set up the persepctive transformation. The mesh shader is given
+        // the same matrix.
         fov_y = 360.0f / M_PI * atan(h() * tan(FOV_X * M_PI / 360.0) / w());
-        gluPerspective(fov_y, w() / (float)h(), 1.0, 1000.0);
+        projection = glm::perspective(glm::radians((float)fov_y), w() / (float)h(), 1.0f, 1000.0f);
+        glMatrixMode(GL_PROJECTION);
+        glLoadMatrixf(glm::value_ptr(projection));
 
         // Do some light stuff. Diffuse color, and zero specular color
         // turns off specular lighting.
@@ -107,7 +184,8 @@ WorldWindow::draw(void)
         color[0] = 0.0f; color[1] = 0.0f; color[2] = 0.0f; color[3] = 1.0f;
         glLightfv(GL_LIGHT0, GL_SPECULAR, color);
 
-        // Initialize all the objects.
+        // Read the assets in parallel, then initialize all the objects.
+        Load_Assets();
         ground.Initialize();
         //horizon.Initialize();
         traintrack.Initialize();
@@ -119,11 +197,31 @@ WorldWindow::draw(void)
         winterTree.Initialize();
         globe.Initialize();
         hill.Initialize();
+
+        // The CPU copies should all be gone now.
+        fprintf(stderr, "WorldWindow: meshes after upload\n");
+        traintrack.Print_Stats(stderr);
+        teacups.Print_Stats(stderr);
+        carousel.Print_Stats(stderr);
+        globe.Print_Stats(stderr);
+        hill.Print_Stats(stderr);
+
+        // Pick up assets rebaked while we run.
+        if ( ! watcher.Started() && watcher.Start(PARK_ASSET_DIR) )
+        {
+            TextureCache::Shared().Watch(watcher);
+            traintrack.Watch(watcher);
+            teacups.Watch(watcher);
+            carousel.Watch(watcher);
+        }
     }
 
     // Stuff out here relies on a coordinate system or must be done on every
     // frame.
 
+    // Swap in any assets that were rebaked since the last frame.
+    watcher.Poll();
+
     // Clear the screen. Color and depth.
     glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
 
@@ -137,9 +235,8 @@ WorldWindow::draw(void)
             eye[0] = x_at + dist * cos(theta * M_PI / 180.0) * cos(phi * M_PI / 180.0);
             eye[1] = y_at + dist * sin(theta * M_PI / 180.0) * cos(phi * M_PI / 180.0);
             eye[2] = 2.0 + dist * sin(phi * M_PI / 180.0);
-            glMatrixMode(GL_MODELVIEW);
-            glLoadIdentity();
-            gluLookAt(eye[0], eye[1], eye[2], x_at, y_at, 2.0, 0.0, 0.0, 1.0);
+            view = glm::lookAt(glm::vec3(eye[0], eye[1], eye[2]), glm::vec3(x_at, y_at, 2.0f)
+                              , glm::vec3(0.0f, 0.0f, 1.0f));
             break;
         case TRAIN_CAM:
             // Set up the viewing transformation. The viewer is sitting in the train.
@@ -156,82 +253,57 @@ WorldWindow::draw(void)
             x = train_pos[0] + train_dir[0];
             y = train_pos[1] + train_dir[1];
             z = train_pos[2] + train_dir[2];
-            glMatrixMode(GL_MODELVIEW);
-            glLoadIdentity();
-            gluLookAt(
-                train_pos[0], train_pos[1], train_pos[2]    // eye
-                , x, y, z                                   // reference point
-                , 0.0, 0.0, 1.0                             // up direction
+            view = glm::lookAt(
+                glm::vec3(train_pos[0], train_pos[1], train_pos[2])     // eye
+                , glm::vec3(x, y, z)                                    // reference point
+                , glm::vec3(0.0f, 0.0f, 1.0f)                           // up direction
             );
             break;
     }
 
+    // The fixed-function objects and the mesh shader share the camera.
+    glMatrixMode(GL_MODELVIEW);
+    glLoadMatrixf(glm::value_ptr(view));
+
     // Position the light source. This has to happen after the viewing
     // transformation is set up, so that the light stays fixed in world
     // space. This is a directional light - note the 0 in the w component.
     dir[0] = 1.0; dir[1] = 1.0; dir[2] = 1.0; dir[3] = 0.0;
     glLightfv(GL_LIGHT0, GL_POSITION, dir);
+    MeshShader::Shared().Begin_Frame(view, projection, glm::vec3(dir[0], dir[1], dir[2]), h());
+
+    // Draw stuff. Everything the camera can see. The ground is under all
+    // of it, so it always can; the hill and the globe are single meshes,
+    // which the queue culls for itself. The rest of the fixed-function
+    // parts draw now, and the meshes all go in the queue, to be drawn
+    // together once everything is in.
+    Frustum     &frustum = MeshShader::Shared().View_Frustum();
+    glm::mat4   teacups_at = glm::translate(glm::mat4(1.0f), glm::vec3(23.0f, 23.0f, 0.0f));
+    glm::mat4   carousel_at = glm::translate(glm::mat4(1.0f), glm::vec3(-13.0f, -33.0f, 0.0f));
 
-    // Draw stuff. Everything.
     ground.Draw();
 	//horizon.Draw();
-    traintrack.Draw();
-
-    glPushMatrix();
-    glTranslatef(40.0f, -40.0f, 0.0f);
-    hill.Draw();
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslatef(0.0f, 0.0f, 10.0f);
-    globe.Draw();
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslatef(23.0f, 23.0f, 0.0f);
-	teacups.Draw();
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslatef(-13.0f, -33.0f, 0.0f);
-    carousel.Draw();
-    glPopMatrix();
-
-    // Spring Forest
-    for (unsigned int i = 0; i < springForest.size(); i += 3)
-    {
-        glPushMatrix();
-        glTranslatef(springForest.at(i), springForest.at(i+1), springForest.at(i+2));
-        springTree.Draw();
-        glPopMatrix();
-    }
-
-    // Summer Forest
-    for (unsigned int i = 0; i < summerForest.size(); i += 3)
-    {
-        glPushMatrix();
-        glTranslatef(summerForest.at(i), summerForest.at(i+1), summerForest.at(i+2));
-        summerTree.Draw();
-        glPopMatrix();
-    }
-
-    // Fall Forest
-    for (unsigned int i = 0; i < fallForest.size(); i += 3)
-    {
-        glPushMatrix();
-        glTranslatef(fallForest.at(i), fallForest.at(i+1), fallForest.at(i+2));
-        fallTree.Draw();
-        glPopMatrix();
-    }
-
-    // Winter Forest
-    for (unsigned int i = 0; i < winterForest.size(); i += 3)
-    {
-        glPushMatrix();
-        glTranslatef(winterForest.at(i), winterForest.at(i+1), winterForest.at(i+2));
-        winterTree.Draw();
-        glPopMatrix();
-    }
+    if ( frustum.Visible(traintrack.Bounds()) )
+        traintrack.Draw(queue);
+
+    hill.Draw(glm::translate(glm::mat4(1.0f), glm::vec3(40.0f, -40.0f, 0.0f)), queue);
+    globe.Draw(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 10.0f)), queue);
+    if ( frustum.Visible(Bounding_Transform(teacups_at, teacups.Bounds())) )
+        teacups.Draw(teacups_at, queue);
+    if ( frustum.Visible(Bounding_Transform(carousel_at, carousel.Bounds())) )
+        carousel.Draw(carousel_at, queue);
+
+    // The forests, each shape of tree in one go, less the trees out of view
+    springTree.Draw(queue);
+    summerTree.Draw(queue);
+    fallTree.Draw(queue);
+    winterTree.Draw(queue);
+
+    queue.Flush();
+
+    // Objects, meshes and instances alike
+    frame_tested = frustum.Tested();
+    frame_culled = frustum.Culled();
 }
 
 
@@ -338,6 +410,12 @@ WorldWindow::handle(int event)
                 case 's':
                     globe.Update();
                     break;
+                case 'f':
+                    fprintf(stderr, "WorldWindow: culled %zu of %zu objects last frame\n"
+                           , frame_culled, frame_tested);
+                    fprintf(stderr, "WorldWindow: %zu binds last frame, %zu saved by sorting\n"
+                           , queue.Binds(), queue.Saved_Binds());
+                    break;
                 default:
                     break;
             }
@@ -0,0 +1,62 @@
+/*
+ * AssetWatcher.h: Header file for reloading baked assets while the program
+ * runs.
+ *
+ * The watcher listens to the baked asset directory with inotify. When
+ * park_bake rewrites a .pmesh or .ptex that something has asked to watch,
+ * the file is read again on a worker thread, and the next Poll() on the GL
+ * thread swaps it into the texture or buffer already in use. Nothing else
+ * is read or uploaded, however many assets there are.
+ *
+ * Elsewhere than Linux there is no inotify, and Start() just says no.
+ */
+
+#pragma once
+
+#include <functional>
+#include <future>
+#include <string>
+#include <vector>
+#include "ThreadPool.h"
+
+class AssetWatcher {
+  public:
+    typedef std::function<bool(void)>   Reader;     // Runs on a worker thread
+    typedef std::function<void(void)>   Uploader;   // Runs on the GL thread
+
+  private:
+    struct Watched {
+        std::string         name;       // The file, without its directory
+        Reader              read;
+        Uploader            upload;
+        bool                changed;    // Since it was last read
+        std::future<bool>   reading;    // Valid while a read is going
+    };
+
+    int                 fd;         // The inotify instance, -1 if none
+    std::string         dir;
+    std::vector<Watched>    watches;
+    ThreadPool          pool;
+
+    void    Changed(const char *name);
+
+  public:
+    AssetWatcher(void);
+    ~AssetWatcher(void);
+
+    AssetWatcher(const AssetWatcher&) = delete;
+    AssetWatcher& operator=(const AssetWatcher&) = delete;
+
+    // Starts listening to a directory, "" meaning the current one. Returns
+    // false, and reports why, if it can't.
+    bool    Start(const char *dir);
+    bool    Started(void) const { return fd >= 0; };
+
+    // Calls read, then upload, each time the file changes. Only the file's
+    // name is compared, so it may be given with any directory.
+    void    Watch(const std::string &filename, Reader read, Uploader upload);
+
+    // Starts reading whatever has changed, and uploads whatever has been
+    // read. Called once a frame on the GL thread; it never blocks.
+    void    Poll(void);
+};
@@ -0,0 +1,27 @@
+/*
+ * Assets.h: Header file for finding baked assets.
+ *
+ * park_bake turns the OBJ models and TGA textures into .pmesh and .ptex
+ * files in one directory at build time. The program is built with that
+ * directory as PARK_ASSET_DIR and looks there first, so it never has to
+ * read the sources at all.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+// Where baked assets live. Without one they sit next to their sources.
+#ifndef PARK_ASSET_DIR
+#define PARK_ASSET_DIR ""
+#endif
+
+// The baked file name for a source asset: its extension is replaced, and
+// if dir is given, its directory too.
+std::string Asset_Name(const char *source, const char *extension, const char *dir);
+
+// Whether a baked file's record of its source still matches the source:
+// the size and mtime if they agree, else the hash of the contents. A
+// missing source matches, so baked assets can be used without them.
+bool    Source_Matches(const char *source, uint64_t size, int64_t mtime, uint64_t hash);
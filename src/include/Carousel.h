@@ -8,6 +8,11 @@
 #include <FL/gl.h>
 #include <vector>
 #include <glm/glm.hpp>
+#include "AssetWatcher.h"
+#include "CompiledMesh.h"
+#include "Frustum.h"
+#include "MeshBuffer.h"
+#include "RenderQueue.h"
 
 class Carousel {
     private:
@@ -30,14 +35,12 @@ class Carousel {
         GLdouble        horse_offset;   // horse offset
 
         // my horse model
-        std::vector<glm::vec3> horse_vertices;
-        std::vector<glm::vec2> horse_uvs;
-        std::vector<glm::vec3> horse_normals;
+        CompiledMesh    horse_mesh;     // The mapped model, until it is uploaded.
+        MeshBuffer      horse_buffer;   // The uploaded model
+        InstanceBuffer  horse_instances;    // Where each horse is this frame
+        BoundingSphere  bounds;         // Around it all, however it turns
 
-        // my horse buffers
-        GLuint vertexbuffer;
-        GLuint uvbuffer;
-        GLuint normalbuffer;
+        void    Update_Bounds(void);    // Refits bounds to the uploaded horse.
 
     public:
         // Constructor
@@ -58,13 +61,18 @@ class Carousel {
             up = true;
             max_horse_height = column_height - 4.0f;
             horse_offset = 0.0f;
+            bounds = { glm::vec3(0.0f), 0.0f };
         };
 
         // Destructor
         ~Carousel(void);
 
+        bool    Load(void);         // Reads the files. Safe off the GL thread.
         bool    Initialize(void);	// Gets everything set up for drawing.
         void    Update(float);	// Updates the location of the horse
-        void    Draw(void);		// Draws everything.
+        void    Draw(const glm::mat4&, RenderQueue&);  // Draws the frame and queues the horses, placed in the world.
+        const BoundingSphere&   Bounds(void) const { return bounds; };  // Set by Initialize() and reloads
+        void    Print_Stats(FILE*) const;  // Reports what the model costs.
+        void    Watch(AssetWatcher&);  // Reloads the model when it is rebaked.
 };
 
@@ -0,0 +1,108 @@
+/*
+ * CompiledMesh.h: Header file for compiled meshes (.pmesh files).
+ *
+ * A .pmesh holds a model exactly as the GPU wants it: interleaved Vertex
+ * data followed by the index buffer, both reordered by MeshOptimizer for
+ * the vertex cache, with the bounding box and a hash of the OBJ it was
+ * compiled from. The index buffer holds a chain of simplified levels of
+ * detail after the full mesh, all drawing from the same vertices. Loading
+ * one is a single mmap, and the vertex and index pointers can go straight
+ * to glBufferData.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Assets.h"
+#include "MappedFile.h"
+#include "Vertex.h"
+
+// Bump this whenever the layout below or the way meshes are built changes,
+// so old caches are recompiled instead of misread.
+const uint32_t PMESH_VERSION = 3;
+
+// The most levels of detail a .pmesh holds, the full mesh included.
+const uint32_t PMESH_MAX_LODS = 4;
+
+// A level of detail: a run of the index buffer, over the same vertices.
+struct PMeshLod {
+    uint32_t    first_index;
+    uint32_t    num_indices;
+    float       error;          // How far the surface may have moved, in model units
+    uint32_t    reserved;
+};
+
+// The file header. Everything is stored in host byte order; a file from a
+// machine of the other endianness fails the version check and is rebuilt.
+struct PMeshHeader {
+    char        magic[4];       // "PMSH"
+    uint32_t    version;        // PMESH_VERSION
+    uint64_t    source_hash;    // Hash of the OBJ file's contents
+    uint64_t    source_size;    // Size of the OBJ file in bytes
+    int64_t     source_mtime;   // Modification time of the OBJ file
+    uint32_t    num_vertices;
+    uint32_t    num_indices;    // For all the levels together
+    uint32_t    index_size;     // 2 or 4 bytes per index
+    uint32_t    vertex_size;    // sizeof(Vertex)
+    float       bounds_min[3];
+    float       bounds_max[3];
+    uint64_t    vertex_offset;  // Offsets from the start of the file
+    uint64_t    index_offset;
+    uint32_t    num_lods;       // 1 to PMESH_MAX_LODS, most detailed first
+    uint32_t    reserved;
+    PMeshLod    lods[PMESH_MAX_LODS];
+};
+
+class CompiledMesh {
+  private:
+    MappedFile          file;   // The mapped .pmesh
+    std::vector<char>   blob;   // Used instead if the cache couldn't be written
+    const PMeshHeader   *header;
+
+    bool    Validate(const char*, size_t);
+
+  public:
+    CompiledMesh(void) { header = nullptr; };
+
+    // Gets the compiled form of an OBJ model. Its .pmesh is used if it is
+    // up to date; otherwise the OBJ is compiled and the cache rewritten. A
+    // .pmesh without its OBJ is trusted as is.
+    bool    Load(const char*);
+
+    // Maps a .pmesh directly. Returns false if it isn't a valid one.
+    bool    Open(const char*);
+
+    // Releases the mapping.
+    void    Close(void);
+
+    bool            Loaded(void) const { return header != nullptr; };
+
+    // Whether the open .pmesh was compiled from the given OBJ as it is now.
+    bool            Matches(const char*) const;
+
+    const Vertex*   Vertices(void) const;
+    const void*     Indices(void) const;
+    uint32_t        Num_Vertices(void) const { return header->num_vertices; };
+    uint32_t        Num_Indices(void) const { return header->num_indices; };
+    uint32_t        Index_Size(void) const { return header->index_size; };
+    uint32_t        Num_Lods(void) const { return header->num_lods; };
+    const PMeshLod& Lod(uint32_t i) const { return header->lods[i]; };
+    size_t          Vertex_Bytes(void) const { return (size_t)header->num_vertices * header->vertex_size; };
+    size_t          Index_Bytes(void) const { return (size_t)header->num_indices * header->index_size; };
+    size_t          Resident_Bytes(void) const { return blob.empty() ? file.Size() : blob.size(); };
+    glm::vec3       Bounds_Min(void) const;
+    glm::vec3       Bounds_Max(void) const;
+
+    // Builds the .pmesh image of an OBJ model in memory.
+    static bool     Compile(const char*, std::vector<char>&);
+
+    // Compiles an OBJ model and writes the result to the given file.
+    static bool     Compile(const char*, const char*);
+
+    // The cache file name for an OBJ model: its extension becomes .pmesh,
+    // and it goes in the baked asset directory, if there is one.
+    static std::string  Cache_Name(const char*, const char *dir = PARK_ASSET_DIR);
+};
@@ -0,0 +1,104 @@
+/*
+ * CompiledTexture.h: Header file for baked textures (.ptex files).
+ *
+ * A .ptex holds a TGA texture ready for the GPU: every mip level down to
+ * 1x1, either as plain RGB or block compressed (BC1, or BC3 for textures
+ * with alpha), with a hash of the TGA it was baked from. Loading one is a
+ * single mmap, and each level goes straight to glTexImage2D or
+ * glCompressedTexImage2D.
+ *
+ * Baking is slow, so unlike .pmesh files these are only made at build
+ * time, by park_bake. A compressed one has a plain RGB copy beside it, for
+ * drivers without S3TC. Without an up to date one the TGA is used.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "Assets.h"
+#include "MappedFile.h"
+
+// Bump this whenever the layout below or the way textures are baked
+// changes, so old files are ignored instead of misread.
+const uint32_t PTEX_VERSION = 1;
+
+// Enough levels for a 32768 x 32768 texture.
+const uint32_t PTEX_MAX_LEVELS = 16;
+
+// How the levels are stored.
+enum PTexFormat : uint32_t {
+    PTEX_RGB8 = 0,      // 3 bytes a pixel, rows packed tightly
+    PTEX_BC1 = 1,       // 8 bytes a 4x4 block, opaque
+    PTEX_BC3 = 2,       // 16 bytes a 4x4 block, with premultiplied alpha
+};
+
+struct PTexLevel {
+    uint32_t    width;
+    uint32_t    height;
+    uint64_t    offset;         // From the start of the file
+    uint64_t    size;           // In bytes
+};
+
+// The file header. Everything is stored in host byte order; a file from a
+// machine of the other endianness fails the version check.
+struct PTexHeader {
+    char        magic[4];       // "PTEX"
+    uint32_t    version;        // PTEX_VERSION
+    uint64_t    source_hash;    // Hash of the TGA file's contents
+    uint64_t    source_size;    // Size of the TGA file in bytes
+    int64_t     source_mtime;   // Modification time of the TGA file
+    uint32_t    width;
+    uint32_t    height;
+    uint32_t    format;         // A PTexFormat
+    uint32_t    num_levels;
+    PTexLevel   levels[PTEX_MAX_LEVELS];
+};
+
+class CompiledTexture {
+  private:
+    MappedFile          file;   // The mapped .ptex
+    const PTexHeader    *header;
+
+    bool    Validate(const char*, size_t);
+
+  public:
+    CompiledTexture(void) { header = nullptr; };
+
+    // Maps the baked form of a TGA file, if it has one that is up to date,
+    // or with plain, its plain RGB copy. A .ptex without its TGA is
+    // trusted as is.
+    bool    Load(const char*, bool plain = false);
+
+    // Maps a .ptex directly. Returns false if it isn't a valid one.
+    bool    Open(const char*);
+
+    // Releases the mapping.
+    void    Close(void);
+
+    bool        Loaded(void) const { return header != nullptr; };
+
+    // Whether the open .ptex was baked from the given TGA as it is now.
+    bool        Matches(const char*) const;
+
+    PTexFormat  Format(void) const { return (PTexFormat)header->format; };
+    bool        Compressed(void) const { return header->format != PTEX_RGB8; };
+    uint32_t    Num_Levels(void) const { return header->num_levels; };
+    const PTexLevel&    Level(uint32_t i) const { return header->levels[i]; };
+    const void*         Level_Data(uint32_t i) const;
+
+    // Bakes a TGA file into a .ptex image in memory: builds the mip chain
+    // with a box filter, then compresses every level if asked to.
+    static bool     Compile(const char*, PTexFormat, std::vector<char>&);
+
+    // Bakes a TGA file and writes the result to the given file.
+    static bool     Compile(const char*, PTexFormat, const char*);
+
+    // The baked file name for a TGA file: its extension becomes .ptex, and
+    // it goes in the baked asset directory, if there is one.
+    static std::string  Cache_Name(const char*, const char *dir = PARK_ASSET_DIR);
+
+    // The same for the plain RGB copy of a compressed .ptex.
+    static std::string  Plain_Name(const char*, const char *dir = PARK_ASSET_DIR);
+};
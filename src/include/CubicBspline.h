@@ -8,58 +8,103 @@
 #define _CUBICBSPLINE_H_
 
 #include <stdio.h>
+#include <array>
+#include <vector>
 
+/* The default arc length table resolution, in steps per span. Each step
+** is integrated exactly enough that interpolating between them is what
+** limits the accuracy. */
+const unsigned short	ARC_STEPS = 32;
 
+/* The largest dimension there is a curve for. CubicBspline.cpp builds
+** one for each dimension from 1 to this, which is as many as
+** DynamicBspline can pick from at run time. */
+const unsigned short	SPLINE_MAX_DIM = 4;
+
+/* The most control points a curve can have. Positions along it are
+** worked out as ints, so this is the largest one. */
+const unsigned int	SPLINE_MAX_CONTROLS = 0x7fffffff;
+
+
+/* The dimension of each point is fixed when the curve is compiled, so
+** every loop over the coordinates has a known length, and the compiler
+** unrolls it. The track is a CubicBspline<3>. */
+template <unsigned short Dim>
 class CubicBspline {
+  public:
+    /* A point on the curve, or a control point. */
+    typedef std::array<float, Dim>  Point;
+
   private:
-    unsigned short  d;		/* The dimension of each point on the curve. */
-    unsigned short  n;		/* The number of control points. */
-    float   	    **c_pts;	/* The control points. */
+    unsigned int    n;		/* The number of control points. */
+    std::vector<Point>	c_pts;	/* The control points, one after another,
+				** so Dim floats each with nothing
+				** between. */
     bool	    loop;	/* Whether the curve loops or not. */
 
-  public:
-    /* Initializes with the given dimension and no control points. */
-    CubicBspline(const unsigned short dim = 3, const bool l = true)
-	{ d = dim; n = 0; c_pts = NULL; loop = l; };
+    /* The arc length table: the distance along the curve at even steps of
+    ** the parameter, and the parameter at even steps of distance, each
+    ** with one more entry than steps. Empty until it is needed, and
+    ** emptied again whenever the control points change. */
+    std::vector<float>	arc_s;
+    std::vector<float>	arc_t;
+    unsigned short	arc_steps;	/* Steps per span of the parameter. */
+    float		arc_length;	/* The whole curve's. */
+
+    static_assert(Dim > 0 && Dim <= SPLINE_MAX_DIM,
+		  "CubicBspline - Dimension out of range");
+    static_assert(sizeof(Point) == Dim * sizeof(float),
+		  "CubicBspline - Points must be packed");
 
-    /* Initializes with the given dimension and control points. */
-    CubicBspline(const unsigned short, const unsigned short, float**,
-		 const bool);
+  public:
+    /* Initializes with no control points. */
+    CubicBspline(const bool l = true)
+	{ n = 0; loop = l; arc_steps = 0; arc_length = 0.0f; };
 
-    /* Destructor. */
-    ~CubicBspline(void);
+    /* Initializes with the given control points. */
+    CubicBspline(const unsigned int, float**, const bool);
 
-    /* Copy operator. */
-    CubicBspline& operator=(const CubicBspline&);
+    /* Copying copies the control points. Moving takes them, leaving the
+    ** source with none. */
+    CubicBspline(const CubicBspline&) = default;
+    CubicBspline(CubicBspline&&) noexcept;
+    CubicBspline& operator=(const CubicBspline&) = default;
+    CubicBspline& operator=(CubicBspline&&) noexcept;
 
     /* Query the dimension. */
-    unsigned short	D(void) { return d; };
+    static unsigned short	D(void) { return Dim; };
 
     /* Query the number of control points. */
-    unsigned short	N(void) { return n; };
+    unsigned int	N(void) { return n; };
 
     /* Query a control point, putting the value into the given array.
     ** Throws an exception if the index is out of range. */
-    void		C(unsigned short, float*);
+    void		C(unsigned int, float*);
 
     /* Query whether the curve is a loop. */
     bool		Loop(void) { return loop; }
 
     /* Change a control point at the given position.
     ** Will throw an exception if the position is out of range. */
-    void    Set_Control(const float*, const unsigned short);
+    void    Set_Control(const float*, const unsigned int);
+
+    /* Make room for the given number of control points, so that adding
+    ** up to that many allocates nothing. Adding more grows the storage
+    ** geometrically anyway. */
+    void    Reserve(const unsigned int);
 
-    /* Add a control point at the end. */
+    /* Add a control point at the end.
+    ** Will throw an exception if there are as many as can be counted. */
     void    Append_Control(const float*);
 
     /* Add a control point at the given position. */
     /* Will throw an exception if the position is beyond the end of
     ** the existing set of control points. */
-    void    Insert_Control(const float*, const unsigned short);
+    void    Insert_Control(const float*, const unsigned int);
 
     /* Remove a control point at the given position. */
     /* Will throw an exception the position is out of range. */
-    void    Delete_Control(const unsigned short);
+    void    Delete_Control(const unsigned int);
 
     /* Evaluate the curve at a parameter value and copy the result into
     ** the given array. Throws an exception if the parameter is out of
@@ -71,18 +116,59 @@ class CubicBspline {
     ** range, unless told to wrap. */
     void    Evaluate_Derivative(const float, float*);
 
+    /* Evaluate the curve at count parameter values at once, putting Dim
+    ** floats for each into the given array, one after another. Gives the
+    ** same values as Evaluate_Point, much faster, using SIMD where the CPU
+    ** has it. Throws an exception if any parameter is out of range, unless
+    ** the curve is a loop. */
+    void    Evaluate_Points(const float*, size_t, float*);
+
+    /* The same for the point, the derivative and the second derivative
+    ** all at once. Any of the three arrays may be NULL, and that one is
+    ** skipped. */
+    void    Evaluate_Derivatives(const float*, size_t, float*, float*, float*);
+
     /* Refine the curve one level, putting the result into the given curve. This
     ** will correctly account for cyclic curves. There is also a tolerance
-    ** version that stops when each sub-section is locally flat enough. */
+    ** version that stops when each sub-section is locally flat enough.
+    ** Both throw an exception if the new control points can't be counted. */
     void    Refine(CubicBspline&);
     void    Refine_Tolerance(CubicBspline&, const float);
 
+    /* Refine this curve one level, in place. */
+    void    Refine(void);
+
+    /* Build the arc length table, with the given number of steps per span
+    ** between control points. Each step's length is found by Gauss-Legendre
+    ** quadrature. The queries below build it with ARC_STEPS if it isn't
+    ** there, so this is only needed to choose another resolution, or to
+    ** build it ahead of time. */
+    void    Build_Arc_Length(const unsigned short steps = ARC_STEPS);
+
+    /* Query the length of the curve; once around, for a loop. */
+    float   Length(void);
+
+    /* Query the distance along the curve at a parameter value, and the
+    ** parameter value at a distance along it, in constant time, by
+    ** interpolating in the table. Past the end, a loop's distances and
+    ** parameters go on round again; an open curve's stop at the end. */
+    float   Arc_Length(const float);
+    float   Arc_Parameter(const float);
+
   private:
     void    Copy_Controls(float**);
-    void    Delete_Controls(void);
+    void    Check_Parameters(const float*, size_t);
+    void    Forget_Arc_Length(void) { arc_s.clear(); arc_t.clear(); };
     bool    Within_Tolerance(const float);
 };
 
 
+/* CubicBspline.cpp builds one of each; nothing else needs to. */
+extern template class CubicBspline<1>;
+extern template class CubicBspline<2>;
+extern template class CubicBspline<3>;
+extern template class CubicBspline<4>;
+
+
 #endif
 
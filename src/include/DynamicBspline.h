@@ -0,0 +1,88 @@
+/*
+ * DynamicBspline.h: Header file for a uniform cubic B-spline whose
+ * dimension is chosen at run time.
+ *
+ * This is the interface CubicBspline had before its dimension became a
+ * template parameter. It holds a curve of each dimension it supports, and
+ * passes every call to the one that matches. Code that knows its
+ * dimension should use CubicBspline<Dim> directly.
+ */
+
+#ifndef _DYNAMICBSPLINE_H_
+#define _DYNAMICBSPLINE_H_
+
+#include "CubicBspline.h"
+
+
+class DynamicBspline {
+  private:
+    unsigned short  d;		/* The dimension of each point on the curve. */
+
+    /* One curve of each dimension. Only the one of dimension d is used;
+    ** the rest stay empty. */
+    CubicBspline<1> c1;
+    CubicBspline<2> c2;
+    CubicBspline<3> c3;
+    CubicBspline<4> c4;
+
+    /* Calls f with the curve of dimension d. */
+    template <class F>
+    auto    With(F f) -> decltype(f(c3))
+    {
+	switch ( d )
+	{
+	    case 1: return f(c1);
+	    case 2: return f(c2);
+	    case 4: return f(c4);
+	    default: return f(c3);
+	}
+    }
+
+  public:
+    /* Initializes with the given dimension and no control points.
+    ** Throws an exception if there is no curve of that dimension. */
+    DynamicBspline(const unsigned short dim = 3, const bool l = true);
+
+    /* Initializes with the given dimension and control points. */
+    DynamicBspline(const unsigned short, const unsigned int, float**,
+		   const bool);
+
+    /* Query the dimension. */
+    unsigned short	D(void) { return d; };
+
+    /* Query the number of control points. */
+    unsigned int	N(void);
+
+    /* Query a control point, putting the value into the given array.
+    ** Throws an exception if the index is out of range. */
+    void		C(unsigned int, float*);
+
+    /* Query whether the curve is a loop. */
+    bool		Loop(void);
+
+    /* The rest are as for CubicBspline, with d floats to a point. */
+    void    Set_Control(const float*, const unsigned int);
+    void    Reserve(const unsigned int);
+    void    Append_Control(const float*);
+    void    Insert_Control(const float*, const unsigned int);
+    void    Delete_Control(const unsigned int);
+
+    void    Evaluate_Point(const float, float*);
+    void    Evaluate_Derivative(const float, float*);
+    void    Evaluate_Points(const float*, size_t, float*);
+    void    Evaluate_Derivatives(const float*, size_t, float*, float*, float*);
+
+    /* The result takes this curve's dimension. */
+    void    Refine(DynamicBspline&);
+    void    Refine_Tolerance(DynamicBspline&, const float);
+    void    Refine(void);
+
+    void    Build_Arc_Length(const unsigned short steps = ARC_STEPS);
+    float   Length(void);
+    float   Arc_Length(const float);
+    float   Arc_Parameter(const float);
+};
+
+
+#endif
+
@@ -0,0 +1,58 @@
+/*
+ * Frustum.h: Header file for the camera's view volume, for culling.
+ *
+ * The six planes come straight out of projection * view. Anything whose
+ * bounding sphere lies wholly behind one of them can't be on screen, so
+ * it needn't be drawn. Every object works out a sphere around itself when
+ * it is initialized, and the window tests it each frame before drawing.
+ *
+ * Cull() tests a whole batch of spheres, given as separate arrays of x, y,
+ * z and radius, four at a time on x86-64.
+ *
+ * The frustum counts what it has tested and culled until the next
+ * Reset(), so the window can say how much each frame skipped.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+struct BoundingSphere {
+    glm::vec3   centre;
+    float       radius;
+};
+
+// The smallest sphere around both.
+BoundingSphere  Bounding_Union(const BoundingSphere&, const BoundingSphere&);
+
+// The sphere moved by a transform. Scales grow it by the largest.
+BoundingSphere  Bounding_Transform(const glm::mat4&, const BoundingSphere&);
+
+class Frustum {
+  private:
+    glm::vec4   planes[6];  // Unit normals, pointing in
+    size_t      tested;     // Spheres tested since Reset()
+    size_t      culled;     // And how many of them were outside
+
+  public:
+    // A frustum that contains everything.
+    Frustum(void);
+
+    // Takes the planes from a projection times a view matrix, and resets
+    // the counts.
+    void    Set(const glm::mat4 &projection_view);
+    void    Reset(void) { tested = culled = 0; };
+
+    // Whether any of the sphere could be on screen.
+    bool    Visible(const BoundingSphere&);
+
+    // Tests count spheres at once, setting visible[i] to 1 if sphere i
+    // could be on screen and 0 if not. Returns how many could.
+    size_t  Cull(const float *x, const float *y, const float *z, const float *radius
+                , size_t count, uint8_t *visible);
+
+    size_t  Tested(void) const { return tested; };
+    size_t  Culled(void) const { return culled; };
+};
@@ -9,21 +9,27 @@
 #define _GROUND_H_
 
 #include <FL/gl.h>
+#include "TextureCache.h"
 
 class Ground {
   private:
     GLubyte display_list;   // The display list that does all the work.
-    GLuint  texture_obj;    // The object for the grass texture.
     bool    initialized;    // Whether or not we have been initialised.
+    TextureCache::Handle texture;   // The grass, shared with the hill.
 
   public:
     // Constructor. Can't do initialization here because we are
     // created before the OpenGL context is set up.
     Ground(void) { display_list = 0; initialized = false; };
 
-    // Destructor. Frees the display lists and texture object.
+    // Destructor. Frees the display list; the texture goes with the
+    // last object using it.
     ~Ground(void);
 
+    // Reads the texture from disk. Needs no GL context, so it can run on
+    // a loader thread. Initialize() calls it if nobody else has.
+    bool    Load(void);
+
     // Initializer. Creates the display list.
     bool    Initialize(void);
 
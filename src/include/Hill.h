@@ -9,7 +9,10 @@
 #include <FL/gl.h>
 #include <glm/glm.hpp>
 #include <vector>
+#include "MeshBuffer.h"
+#include "RenderQueue.h"
 #include "Vertex.h"
+#include "TextureCache.h"
 
 // Vertices for a pyramid
 const std::vector<Vertex> Pyramid_Vertices = {
@@ -30,48 +33,38 @@ const std::vector<GLuint> Pyramid_Indices = {
 
 class Hill {
   private:
-    GLuint  texture_obj;    // The object for the grass texture.
     bool    initialized;    // Whether or not we have been initialised.
+    TextureCache::Handle texture;   // The grass, shared with the ground.
 
     GLuint  degree;         // The degree of subdivision.
     GLfloat scale;          // How much detail / modulation.
 
-    // globe data
-    std::vector<Vertex> vertex_data;  // each element contains pos, uv, normal
-    std::vector<GLuint> indices;   
-    std::vector<glm::vec3> vertices;
-    std::vector<glm::vec2> uvs;
-    std::vector<glm::vec3> normals;
-
-    // globe buffers
-    GLuint vertexbuffer;
-    GLuint uvbuffer;
-    GLuint normalbuffer;
-    GLuint indexbuffer;
+    // hill buffers, one interleaved vertex buffer and the indices. The
+    // vertices are built afresh for each upload and dropped after it.
+    MeshBuffer buffer;
 
   public:
     Hill(void) { 
       initialized = false; 
       degree = 0;
       scale = 0.5f;
-      vertex_data = {Pyramid_Vertices}; 
-      indices = {Pyramid_Indices}, 
-      vertices = {}; 
-      uvs = {}; 
-      normals = {}; 
     }
 
-    ~Hill(void);
-
-    void    CleanupBuffers(void);
+    // Uploads a subdivided pyramid. Nothing is kept on the CPU.
+    void    Index(const std::vector<Vertex>&, const std::vector<GLuint>&);
 
-    void    Index();
+    // Reads the texture from disk. Needs no GL context, so it can run on
+    // a loader thread. Initialize() calls it if nobody else has.
+    bool    Load(void);
 
     // Initializer. Creates the display list.
     bool    Initialize(void);
 
-    // Does the drawing.
-    void    Draw(void);
+    // Queues the drawing, placed in the world.
+    void    Draw(const glm::mat4&, RenderQueue&);
+
+    // Reports what the mesh costs.
+    void    Print_Stats(FILE*) const;
 
     // Wraps the subdivision
     void    Update();
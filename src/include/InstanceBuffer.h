@@ -0,0 +1,59 @@
+/*
+ * InstanceBuffer.h: Header file for per-instance data drawn with a mesh.
+ *
+ * Many copies of one mesh go in a single instanced draw. Each copy's
+ * transform and colour go in this buffer, and MeshBuffer::Attach() points
+ * the mesh's vertex array at it, once. After that the instances can be
+ * cleared and added again every frame; the next Upload() refills the same
+ * GL buffer.
+ *
+ * The CPU copy is kept, so the mesh shader can choose a level of detail
+ * that suits every instance, and send only the ones the camera can see.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <FL/gl.h>
+#include <glm/glm.hpp>
+
+struct MeshInstance {
+    glm::mat4   model;      // Applied before the draw's own model matrix
+    glm::vec4   color;      // Multiplies the draw's colour, when tinted
+};
+
+class InstanceBuffer {
+  private:
+    GLuint                      buffer;
+    size_t                      capacity;   // Instances the GL buffer holds
+    std::vector<MeshInstance>   instances;
+    std::vector<MeshInstance>   shown;      // The visible ones, being sent
+    GLsizei                     uploaded;   // Instances in the GL buffer
+    bool                        dirty;      // GL buffer isn't all of them
+
+    void    Send(const std::vector<MeshInstance>&);
+
+  public:
+    InstanceBuffer(void);
+    ~InstanceBuffer(void);
+
+    InstanceBuffer(const InstanceBuffer&) = delete;
+    InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+    void    Clear(void);
+    void    Add(const glm::mat4 &model, const glm::vec4 &color = glm::vec4(1.0f));
+
+    // Sends the instances to the GL, if they have changed. Must be called
+    // on the GL thread, before the buffer is first attached.
+    void    Upload(void);
+
+    // Sends just the instances whose visible[] entry is set, in order, to
+    // be drawn this frame. The next Upload() sends them all again.
+    void    Upload(const uint8_t *visible);
+
+    GLuint  Object(void) const { return buffer; };
+    GLsizei Count(void) const { return (GLsizei)instances.size(); };
+    GLsizei Uploaded(void) const { return uploaded; };
+    const std::vector<MeshInstance>&    Instances(void) const { return instances; };
+};
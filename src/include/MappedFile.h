@@ -0,0 +1,41 @@
+/*
+ * MappedFile.h: Header file for a read-only memory-mapped file.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <cstddef>
+
+class MappedFile {
+  private:
+    const char  *data;      // The start of the mapping.
+    size_t      size;       // The length of the file in bytes.
+    bool        heap;       // Whether data was read into the heap instead.
+
+  public:
+    // Constructor. Nothing is mapped until Open() is called.
+    MappedFile(void) { data = nullptr; size = 0; heap = false; };
+
+    // Destructor. Unmaps the file.
+    ~MappedFile(void) { Close(); };
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps the whole file. Returns false if it can't be opened or is empty.
+    bool    Open(const char*);
+
+    // Unmaps the file, if one is mapped.
+    void    Close(void);
+
+    const char* Data(void) const { return data; };
+    size_t      Size(void) const { return size; };
+
+    // A quick hash of the contents, for noticing that a file changed.
+    uint64_t    Hash(void) const;
+
+    // Writes a whole file: to the side first, then renamed over the old
+    // one, so a reader never sees half a file.
+    static bool Write(const char*, const char*, size_t);
+};
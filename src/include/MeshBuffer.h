@@ -0,0 +1,146 @@
+/*
+ * MeshBuffer.h: Header file for a compiled mesh uploaded to the GPU.
+ *
+ * The vertices go up either as they are, 32 bytes each, or packed into 16:
+ * positions as shorts spread over the mesh's bounds, normals folded onto
+ * an octahedron as two normalized shorts, and texture coordinates as half
+ * floats, which keep their precision however far a texture repeats.
+ * MeshShader's vertex stage unpacks them, positions with the scale and
+ * offset the buffer gives it.
+ *
+ * The vertex layout lives in a vertex array object made at upload, so
+ * drawing needs nothing but Bind() and Draw(). Attach() adds an
+ * InstanceBuffer to it, after which Draw() can draw every instance in it
+ * at once. That takes instanced arrays, which are core in GL 3.3 and an
+ * extension before it; without them Attach() does nothing, and the
+ * instances have to be drawn one at a time.
+ *
+ * A mesh compiled with levels of detail keeps them all in its index
+ * buffer, and Select_Lod() picks the coarsest one whose error covers less
+ * than MESH_LOD_PIXELS pixels on screen where it is being drawn.
+ *
+ * Nothing of the mesh stays on the CPU but the counts, the level table and
+ * the bounds, so the caller can drop its copy as soon as Upload() returns.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <FL/gl.h>
+#include <glm/glm.hpp>
+#include "CompiledMesh.h"
+#include "Frustum.h"
+#include "InstanceBuffer.h"
+
+// How far, in pixels, a level of detail may stray from the full mesh.
+const float MESH_LOD_PIXELS = 1.0f;
+
+// Whether instances can be drawn in one call: GL 3.3, or an older GL with
+// ARB_instanced_arrays. Must be called on the GL thread, after glewInit().
+bool    Mesh_Instancing(void);
+
+// Where MeshShader reads each part of a vertex.
+enum MeshAttribute {
+    MESH_ATTRIB_POSITION = 0,
+    MESH_ATTRIB_NORMAL = 1,
+    MESH_ATTRIB_UV = 2,
+    MESH_ATTRIB_INSTANCE_MODEL = 3,     // A column each, 3 to 6
+    MESH_ATTRIB_INSTANCE_COLOR = 7,
+};
+
+// How the vertices are stored in the buffer.
+enum VertexFormat {
+    VERTEX_FLOAT,       // Vertex, as compiled
+    VERTEX_PACKED,      // PackedVertex
+};
+
+// Each attribute starts on a four-byte boundary; the last two bytes are
+// only there to keep the next vertex's on one too.
+struct PackedVertex {
+    int16_t     normal[2];  // Octahedral, -32767 to 32767 for -1 to 1
+    uint16_t    uv[2];      // Half floats
+    int16_t     pos[3];     // -32767 to 32767 across the bounds
+    int16_t     pad;
+};
+
+class MeshBuffer {
+  private:
+    struct Lod {
+        GLsizei     count;      // Number of indices
+        size_t      offset;     // Into the index buffer, in bytes
+        float       error;      // In model units
+    };
+
+    GLuint          vertexarray;    // The layout of the two buffers
+    GLuint          vertexbuffer;   // Interleaved vertex data
+    GLuint          indexbuffer;    // The mesh's indices
+    GLenum          index_type;     // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    GLsizei         count;          // Number of indices
+    VertexFormat    format;
+    size_t          bytes;          // Size of the vertex buffer
+    size_t          index_bytes;    // Size of the index buffer
+    size_t          num_vertices;
+    std::vector<Lod>    lods;       // Most detailed first
+    glm::vec3       centre;         // Of the bounding box
+    float           radius;         // Of a sphere around the bounding box
+
+    // Unpacking PackedVertex: pos = offset + packed * scale
+    glm::vec3       pos_offset, pos_scale;
+
+    void    Upload_Vertices(const Vertex*, size_t);
+    void    Upload_Indices(const void*, size_t count, size_t index_size);
+    void    Upload_Layout(void);
+
+  public:
+    MeshBuffer(void);
+    ~MeshBuffer(void);
+
+    MeshBuffer(const MeshBuffer&) = delete;
+    MeshBuffer& operator=(const MeshBuffer&) = delete;
+
+    // Uploads a mesh in the given format. Must be called on the GL thread.
+    // Uploading again replaces the old mesh in the same buffers.
+    bool    Upload(const CompiledMesh&, VertexFormat);
+    bool    Upload(const Vertex*, size_t, const GLuint*, size_t, VertexFormat);
+
+    // Reads per-instance transforms and colours from the given buffer from
+    // now on. Must be called after Upload() and the buffer's own Upload().
+    // Does nothing unless Mesh_Instancing().
+    void    Attach(const InstanceBuffer&);
+
+    // Binds the vertex array. Draw() can then be called any number of
+    // times before Unbind(), with any level of detail, and for an attached
+    // buffer, any number of instances, if Mesh_Instancing().
+    void    Bind(void) const;
+    void    Draw(GLsizei lod = 0) const;
+    void    Draw(GLsizei lod, GLsizei instances) const;
+    void    Unbind(void) const;
+
+    // The coarsest level that is close enough, drawn with the given
+    // modelview matrix where pixels_per_unit pixels cover one unit at a
+    // depth of 1.
+    GLsizei Select_Lod(const glm::mat4 &modelview, float pixels_per_unit) const;
+
+    GLsizei Num_Lods(void) const { return (GLsizei)lods.size(); };
+    GLsizei Num_Triangles(GLsizei lod) const { return lods[lod].count / 3; };
+
+    // A sphere around the mesh, in its own coordinates.
+    BoundingSphere  Bounds(void) const { return BoundingSphere{ centre, radius }; };
+
+    GLuint          Object(void) const { return vertexarray; };
+    VertexFormat    Format(void) const { return format; };
+    const glm::vec3&    Pos_Offset(void) const { return pos_offset; };
+    const glm::vec3&    Pos_Scale(void) const { return pos_scale; };
+    size_t          Vertex_Bytes(void) const { return bytes; };
+    size_t          Index_Bytes(void) const { return index_bytes; };
+
+    // One line on what the mesh costs: what is on the GPU, and what its
+    // owner says it still holds on the CPU.
+    void            Print_Stats(FILE*, const char *name, size_t cpu_bytes) const;
+
+    // Packs vertices, giving the scale and offset that unpack positions.
+    static void     Pack(const Vertex*, size_t, std::vector<PackedVertex>&
+                        , glm::vec3 &pos_offset, glm::vec3 &pos_scale);
+};
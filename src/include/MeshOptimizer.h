@@ -0,0 +1,43 @@
+/*
+ * MeshOptimizer.h: Header file for reordering indexed meshes so the GPU
+ * does less work drawing them.
+ *
+ * OBJ exporters write triangles in whatever order the modeller left them,
+ * which makes the post-transform cache miss much more often than it need
+ * to. These passes reorder the triangles for that cache (Forsyth's
+ * algorithm), optionally regroup them so outward-facing parts draw first
+ * and hide the rest (as in Tipsify), and then reorder the vertices into
+ * the order the triangles first use them, for fetch locality. None of
+ * them change what is drawn.
+ */
+
+#pragma once
+
+#include <vector>
+#include "Vertex.h"
+
+// The FIFO cache size the statistics are measured against; a fair guess
+// at older hardware, where the ordering matters most.
+const unsigned int MESH_STATS_CACHE_SIZE = 16;
+
+struct MeshCacheStats {
+    float   acmr;   // Vertices transformed per triangle; 0.5 is the ideal
+    float   atvr;   // Vertices transformed per vertex; 1 is the ideal
+};
+
+// Simulates a FIFO post-transform cache over a triangle list.
+MeshCacheStats  Mesh_Cache_Stats(const std::vector<unsigned int> &indices, size_t num_vertices
+                                , unsigned int cache_size = MESH_STATS_CACHE_SIZE);
+
+// Reorders the triangles for post-transform cache locality.
+void    Optimize_Vertex_Cache(std::vector<unsigned int> &indices, size_t num_vertices);
+
+// Regroups cache-ordered triangles into clusters drawn outside in, to cut
+// overdraw. The new order is kept only if its ACMR is within threshold
+// times the old one's (1.05 allows it to get 5% worse).
+void    Optimize_Overdraw(const std::vector<Vertex> &vertices
+                         , std::vector<unsigned int> &indices, float threshold);
+
+// Reorders the vertices into the order the triangles first use them,
+// dropping any that no triangle uses, and renumbers the indices to match.
+void    Optimize_Vertex_Fetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices);
@@ -0,0 +1,115 @@
+/*
+ * MeshShader.h: Header file for the shader that draws MeshBuffers.
+ *
+ * Meshes are drawn with GLSL rather than the fixed-function pipeline, so
+ * each one is a vertex array bind and a draw. The shader unpacks packed
+ * vertices and lights them with the scene's one directional light, just
+ * as GL_LIGHT0 with GL_COLOR_MATERIAL would: the colour, times the light
+ * model's ambient plus the diffuse term, times the texture if there is
+ * one. It takes its matrices as uniforms, so it needs neither the matrix
+ * stacks nor GL_NORMALIZE.
+ *
+ * Many copies of a mesh are drawn with one instanced call, each with its
+ * own transform and colour from an InstanceBuffer. The shader itself needs
+ * GL 3.0; where instanced arrays aren't there too, the same copies are
+ * drawn one call each instead.
+ *
+ * The shader keeps the frame's view frustum. The render queue culls
+ * whole meshes with it, and an instanced draw sends only the instances
+ * inside it, all tested in one batch.
+ *
+ * Use(), Bind() and Set_Material() are separate so the render queue can
+ * skip whichever of them is the same as for the last draw.
+ *
+ * Everything that isn't a MeshBuffer still draws the old way, after
+ * Unbind() has put the fixed-function pipeline back.
+ */
+
+#pragma once
+
+#include <FL/gl.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Frustum.h"
+#include "MeshBuffer.h"
+
+// GL's default light model ambient, which the rest of the scene gets.
+const float MESH_AMBIENT = 0.2f;
+
+class MeshShader {
+  private:
+    GLuint      program;    // 0 until Initialize() works
+    bool        tried;      // Whether Initialize() has been called
+    bool        instancing; // Whether Mesh_Instancing()
+
+    // Uniform locations
+    GLint       u_instanced, u_tinted, u_octahedral;
+    GLint       u_model, u_view, u_projection, u_normal_matrix;
+    GLint       u_pos_offset, u_pos_scale;
+    GLint       u_light_dir, u_ambient, u_color, u_textured, u_texture;
+
+    // This frame's camera and light
+    glm::mat4   view;
+    glm::mat4   projection;
+    glm::vec3   light_dir;          // Towards the light, in world space
+    glm::vec4   color;              // The last Set_Material()'s
+    float       pixels_per_unit;    // At a depth of 1, for picking levels
+    Frustum     frustum;
+
+    // Instances' bounds, for culling them in a batch
+    std::vector<float>      cull_x, cull_y, cull_z, cull_radius;
+    std::vector<uint8_t>    cull_visible;
+
+    static GLuint   Compile(GLenum, const char*);
+    void            Set_Model(const glm::mat4&);
+    void            Draw_Each(const MeshBuffer&, const glm::mat4&
+                             , const std::vector<MeshInstance>&, bool tinted);
+
+  public:
+    MeshShader(void);
+
+    MeshShader(const MeshShader&) = delete;
+    MeshShader& operator=(const MeshShader&) = delete;
+
+    // The shader every scene object shares. It lives as long as the GL
+    // context, so it is never deleted.
+    static MeshShader&  Shared(void);
+
+    // Compiles and links the shader, the first time it is called. Must be
+    // called on the GL thread. Returns false, and reports why, if it can't.
+    bool    Initialize(void);
+
+    // Sets the camera and light for everything drawn this frame, and
+    // starts the frustum's counts again.
+    void    Begin_Frame(const glm::mat4 &view, const glm::mat4 &projection
+                       , const glm::vec3 &light_dir, int viewport_height);
+
+    // This frame's view volume, which whole objects can be tested against
+    // too, so that one count covers everything culled.
+    Frustum&            View_Frustum(void) { return frustum; };
+    const glm::mat4&    View(void) const { return view; };
+
+    // Makes the shader current, with this frame's camera and light.
+    void    Use(void);
+
+    // Binds a buffer's vertex array, and tells the shader how to unpack
+    // it. Draw() can then be called any number of times before Unbind().
+    void    Bind(const MeshBuffer&);
+
+    // The colour to draw in, times the texture bound to unit 0 if textured.
+    void    Set_Material(const glm::vec4 &color, bool textured);
+
+    // Draws the buffer at the given model transform, at whatever level of
+    // detail its size on screen calls for.
+    void    Draw(const MeshBuffer&, const glm::mat4 &model);
+
+    // Draws every visible instance in a buffer attached to the mesh, each
+    // at the model transform times its own, in one call if the GL has
+    // instanced arrays. The instances are uploaded here, so the caller
+    // needn't. With tinted, each instance's colour multiplies the one given
+    // to Set_Material().
+    void    Draw(const MeshBuffer&, const glm::mat4 &model, InstanceBuffer&, bool tinted);
+
+    // Goes back to the fixed-function pipeline.
+    void    Unbind(const MeshBuffer&);
+};
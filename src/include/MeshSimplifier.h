@@ -0,0 +1,32 @@
+/*
+ * MeshSimplifier.h: Header file for building levels of detail for an
+ * indexed mesh.
+ *
+ * Edges are collapsed cheapest first, by Garland and Heckbert's quadric
+ * error metric. Each collapse moves one vertex onto a neighbour, so every
+ * level indexes the same vertices as the full mesh and they can all share
+ * one vertex buffer. Vertices on a border, or where a texture or normal
+ * seam splits a position into several vertices, are never moved, so the
+ * levels keep their outline and don't tear along seams.
+ */
+
+#pragma once
+
+#include <vector>
+#include "Vertex.h"
+
+struct MeshLod {
+    std::vector<unsigned int>   indices;
+    float                       error;      // Roughly how far, in model units,
+                                            // the surface has moved
+};
+
+// How many triangles each level keeps from the one before.
+const float MESH_LOD_RATIO = 0.25f;
+
+// Fills lods with up to max_levels levels. The first is the mesh as given,
+// with no error; each one after has about MESH_LOD_RATIO as many triangles
+// as the one before. Stops early once nothing more can be collapsed.
+void    Build_Lod_Chain(const std::vector<Vertex> &vertices
+                       , const std::vector<unsigned int> &indices
+                       , unsigned int max_levels, std::vector<MeshLod> &lods);
@@ -0,0 +1,86 @@
+/*
+ * RenderQueue.h: Header file for the queue every mesh is drawn through.
+ *
+ * Objects don't draw their meshes themselves. They submit them, with a
+ * texture, a transform and a colour, and the window flushes the queue
+ * once everything is in. Flush() sorts the draws by a 64-bit key, so that
+ * draws sharing a texture, and then a buffer, come together:
+ *
+ *   63..60   pass        opaque first, then blended
+ *   59..44   texture     GL texture object, 0 for none
+ *   43..28   buffer      GL vertex array object
+ *   27..0    depth       front to back
+ *
+ * Blended draws have to go back to front whatever they use, so for them
+ * the depth, inverted, comes straight after the pass.
+ *
+ * Walking the sorted draws, the queue binds a texture or a buffer only
+ * when it differs from the last draw's, and counts what that saved.
+ *
+ * Whole meshes outside the frustum are dropped when submitted. Instanced
+ * draws keep theirs, and MeshShader culls the instances when drawing.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include "InstanceBuffer.h"
+#include "MeshBuffer.h"
+#include "TextureCache.h"
+
+// The far plane, beyond which depths all sort the same.
+const float RENDER_DEPTH_RANGE = 1000.0f;
+
+enum RenderPass {
+    RENDER_OPAQUE = 0,
+    RENDER_BLENDED = 1,
+};
+
+class RenderQueue {
+  private:
+    struct Item {
+        const MeshBuffer                *buffer;
+        const TextureCache::Texture     *texture;   // nullptr for none
+        glm::mat4                       model;
+        glm::vec4                       color;
+        InstanceBuffer                  *instances; // nullptr for one mesh
+        bool                            tinted;     // Instances' colours too
+    };
+
+    std::vector<Item>                           items;
+    std::vector<std::pair<uint64_t, uint32_t>>  order;  // Key, and index into items
+
+    size_t  binds;      // Programs, textures and buffers bound last Flush()
+    size_t  saved;      // And those it skipped, being bound already
+
+    void    Add(const Item&, RenderPass);
+
+  public:
+    RenderQueue(void) { binds = saved = 0; };
+
+    RenderQueue(const RenderQueue&) = delete;
+    RenderQueue& operator=(const RenderQueue&) = delete;
+
+    // Queues a mesh drawn at model, in color, times the texture if there is
+    // one. The mesh, texture and instances must last until Flush().
+    void    Submit(const MeshBuffer&, const TextureCache::Texture*
+                  , const glm::mat4 &model, const glm::vec4 &color
+                  , RenderPass pass = RENDER_OPAQUE);
+
+    // Queues every instance in a buffer attached to the mesh, as
+    // MeshShader::Draw() does.
+    void    Submit(const MeshBuffer&, const TextureCache::Texture*
+                  , const glm::mat4 &model, const glm::vec4 &color
+                  , InstanceBuffer&, bool tinted, RenderPass pass = RENDER_OPAQUE);
+
+    // Draws everything queued, in key order, then empties the queue. Must
+    // be called on the GL thread, after MeshShader::Begin_Frame().
+    void    Flush(void);
+
+    size_t  Binds(void) const { return binds; };
+    size_t  Saved_Binds(void) const { return saved; };
+
+    static uint64_t Key(RenderPass, GLuint texture, GLuint buffer, float depth);
+};
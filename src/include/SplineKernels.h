@@ -0,0 +1,42 @@
+/*
+ * SplineKernels.h: Header file for evaluating a uniform cubic B-spline at
+ * many parameter values at once.
+ *
+ * A kernel takes the control points as CubicBspline stores them, d floats
+ * each, and a run of parameter values, and writes the point, the first
+ * derivative and the second derivative at each, interleaved d floats to a
+ * value, into whichever of the outputs aren't null. The parameters wrap
+ * around the control points, as a looped curve's do; checking that an
+ * open curve's are in range is up to the caller.
+ *
+ * There is a plain version, and on x86-64 an AVX2 one that does eight
+ * parameters at a time, picked at run time. They agree to the bit: the
+ * AVX2 one does the same arithmetic in the same order.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+typedef void (*SplineKernel)(const float *controls, unsigned int d, unsigned int n
+                            , const float *t, size_t count
+                            , float *points, float *first, float *second);
+
+// Instruction sets, from worst to best
+enum SplineIsa {
+    SPLINE_ISA_SCALAR = 0,
+    SPLINE_ISA_AVX2 = 1,
+    SPLINE_ISA_COUNT = 2,
+};
+
+// The best instruction set this machine runs, within the limit below.
+int             Spline_Kernel_Isa(void);
+
+// Caps the instruction set CubicBspline will use; for benchmarks and checks.
+void            Spline_Limit_Kernel_Isa(int isa);
+
+// The kernel for an instruction set, or nullptr if this build doesn't have
+// one. Doesn't check that the CPU can run it.
+SplineKernel    Spline_Get_Kernel(int isa);
+
+const char*     Spline_Isa_Name(int isa);
@@ -0,0 +1,39 @@
+/*
+ * SweptMesh.h: Header file for meshes made by sweeping a circle along a
+ * curve.
+ *
+ * The curve comes as points with their tangents, sampled closely enough
+ * that straight pieces between them look smooth. Sweep_Frames() gives
+ * each point a normal by rotation-minimizing frames (the double reflection
+ * method of Wang et al.), so a tube swept along them doesn't twist any
+ * more than the curve makes it. Sweep_Tube() then puts a ring of vertices
+ * around each frame and joins the rings into one indexed triangle mesh.
+ *
+ * A closed curve's frames don't, in general, come back to where they
+ * started. The difference is spread evenly around the loop, so the tube
+ * joins up with itself.
+ */
+
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Vertex.h"
+
+struct SweepFrame {
+    glm::vec3   point;
+    glm::vec3   tangent;    // Unit, along the curve
+    glm::vec3   normal;     // Unit, across it
+};
+
+// Frames for points along a curve. The first normal is the one closest to
+// up, unless the curve starts straight up or down.
+void    Sweep_Frames(const std::vector<glm::vec3> &points, const std::vector<glm::vec3> &tangents
+                    , bool loop, std::vector<SweepFrame> &frames);
+
+// Appends a tube of the given radius, with a ring of sides vertices around
+// each frame, facing out. A loop's last ring joins its first. The tubes
+// are open ended. Texture coordinates go once around the tube in u, and
+// one per unit of length in v.
+void    Sweep_Tube(const std::vector<SweepFrame> &frames, float radius, int sides, bool loop
+                  , std::vector<Vertex> &vertices, std::vector<unsigned int> &indices);
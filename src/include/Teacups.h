@@ -8,6 +8,12 @@
 #include <FL/gl.h>
 #include <vector>
 #include <glm/glm.hpp>
+#include "AssetWatcher.h"
+#include "CompiledMesh.h"
+#include "Frustum.h"
+#include "MeshBuffer.h"
+#include "RenderQueue.h"
+#include "TextureCache.h"
 
 class Teacups {
     private:
@@ -22,18 +28,15 @@ class Teacups {
         GLdouble        theta;          // Rotation of track
         GLdouble        speed;          // Speed of rotation
         GLdouble        step;           // The spread of the teacups on the track
-        GLuint          texture_obj;    // The object for the teacup texture.
+        TextureCache::Handle texture;   // The teacup texture.
 
         // my teacup model
-        std::vector<glm::vec3> teacup_vertices;
-        std::vector<glm::vec2> teacup_uvs;
-        std::vector<glm::vec3> teacup_normals;
+        CompiledMesh    teacup_mesh;    // The mapped model, until it is uploaded.
+        MeshBuffer      teacup_buffer;  // The uploaded model
+        InstanceBuffer  teacup_instances;   // Where each teacup is this frame
+        BoundingSphere  bounds;         // Around it all, however it turns
 
-        // my teacup buffers
-        //GLuint VAO;
-        GLuint vertexbuffer;
-        GLuint uvbuffer;
-        GLuint normalbuffer;
+        void    Update_Bounds(void);    // Refits bounds to the uploaded cup.
 
     public:
         // Constructor
@@ -48,14 +51,18 @@ class Teacups {
             theta = 0.0f; 
             speed = 15.0f;
             step = 360.0f / num_teacups;
-            texture_obj = 0;
+            bounds = { glm::vec3(0.0f), 0.0f };
         };
 
         // Destructor
         ~Teacups(void);
 
+        bool    Load(void);         // Reads the files. Safe off the GL thread.
         bool    Initialize(void);	// Gets everything set up for drawing.
         void    Update(float);	// Updates the location of the teacup
-        void    Draw(void);		// Draws everything.
+        void    Draw(const glm::mat4&, RenderQueue&);  // Draws the track and queues the cups, placed in the world.
+        const BoundingSphere&   Bounds(void) const { return bounds; };  // Set by Initialize() and reloads
+        void    Print_Stats(FILE*) const;  // Reports what the model costs.
+        void    Watch(AssetWatcher&);  // Reloads the model when it is rebaked.
 };
 
@@ -0,0 +1,147 @@
+/*
+ * TextureCache.h: Header file for textures shared between scene objects.
+ *
+ * Objects ask the cache for a texture by file name and sampler settings,
+ * and get back a shared handle. Each image is decoded once, however many
+ * objects use it, and each file and sampler pair is uploaded once. The GL
+ * texture goes away when the last handle to it does.
+ *
+ * A file baked into a .ptex by park_bake is read from that instead, and
+ * its levels are uploaded as they are, compressed or not.
+ *
+ * When a .ptex is rebaked while the program runs, the file is read again
+ * and uploaded into the same GL textures, so the handles never change.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <FL/gl.h>
+#include "AssetWatcher.h"
+#include "CompiledTexture.h"
+#include "TgaImage.h"
+
+// How a texture is wrapped and filtered. A min filter that uses mipmaps
+// gets them, baked or built at upload; any other doesn't.
+struct TextureSampler {
+    GLint   wrap_s;
+    GLint   wrap_t;
+    GLint   min_filter;
+    GLint   mag_filter;
+
+    bool    operator<(const TextureSampler &other) const;
+    bool    Mipmapped(void) const;
+};
+
+// Repeats and filters linearly, without mipmaps.
+const TextureSampler REPEAT_LINEAR = { GL_REPEAT, GL_REPEAT, GL_LINEAR, GL_LINEAR };
+
+// Repeats, with mipmaps; for textures tiled many times over a surface.
+const TextureSampler REPEAT_MIPMAPPED = { GL_REPEAT, GL_REPEAT, GL_NEAREST_MIPMAP_LINEAR, GL_LINEAR };
+
+class TextureCache {
+  private:
+    // A decoded file, shared by every texture made from it until they
+    // have all been uploaded.
+    struct Image {
+        std::mutex      lock;
+        bool            tried;  // Whether decoding has been attempted
+        CompiledTexture baked;  // The .ptex, if there is an up to date one
+        TgaImage        pixels; // Otherwise the TGA itself
+
+        Image(void) { tried = false; };
+
+        // Without compressed_ok, a compressed .ptex won't do. Its plain
+        // copy is read instead, or the TGA if there isn't one.
+        bool    Decode(const std::string&, bool compressed_ok = true);
+        bool    Use_Baked(bool compressed_ok) const;
+    };
+
+  public:
+    class Texture {
+      private:
+        std::mutex              lock;
+        std::string             filename;
+        TextureSampler          sampler;
+        std::shared_ptr<Image>  image;  // Released once uploaded, until reloaded
+        GLuint                  object;
+        size_t                  bytes;  // Video memory used, mipmaps and all
+
+        friend class TextureCache;
+
+        void    Upload_Baked(const CompiledTexture&);
+        void    Upload_Pixels(const TgaImage&);
+
+      public:
+        Texture(const std::string &name, const TextureSampler &s
+               , const std::shared_ptr<Image> &i)
+            : filename(name), sampler(s), image(i) { object = 0; bytes = 0; };
+        ~Texture(void);
+
+        Texture(const Texture&) = delete;
+        Texture& operator=(const Texture&) = delete;
+
+        // Makes the GL texture, if no other handle has yet, or fills it
+        // again after a reload. Must be called on the GL thread. Returns
+        // false if the image couldn't be read.
+        bool    Upload(void);
+
+        // The GL texture object; 0 until uploaded.
+        GLuint  Object(void) const { return object; };
+
+        // Binds the texture to GL_TEXTURE_2D.
+        void    Bind(void) const;
+
+        const std::string&  Filename(void) const { return filename; };
+    };
+
+    typedef std::shared_ptr<Texture>    Handle;
+
+  private:
+    typedef std::pair<std::string, TextureSampler>  Key;
+
+    std::mutex                                      lock;
+    std::map<Key, std::weak_ptr<Texture>>           textures;
+    std::map<std::string, std::weak_ptr<Image>>     images;
+
+    uint32_t    hits;       // Requests for a texture that was already live
+    uint32_t    misses;     // Requests that had to make one
+    uint32_t    decodes;    // Images read from disk
+
+  public:
+    TextureCache(void) { hits = misses = decodes = 0; };
+
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    // The cache every scene object shares.
+    static TextureCache&    Shared(void);
+
+    // Gets a texture, decoding the file if no live texture has it. Safe to
+    // call from any thread; the upload waits for Texture::Upload(). Returns
+    // an empty handle, and reports why, if the file can't be read.
+    Handle  Acquire(const char *filename, const TextureSampler &sampler);
+
+    uint32_t    Hits(void);
+    uint32_t    Misses(void);
+    uint32_t    Decodes(void);
+
+    // Prints the request counts and the live textures, with how many
+    // handles each has and the video memory it holds.
+    void    Print_Stats(FILE*);
+
+    // Reads a file again for every live texture made from it, without
+    // touching GL. Returns false, and keeps the old image, if it can't.
+    bool    Reload(const std::string &filename);
+
+    // Uploads what Reload() read. Must be called on the GL thread.
+    void    Refresh(const std::string &filename);
+
+    // Has the watcher reload each live texture's file when its .ptex is
+    // rebaked.
+    void    Watch(AssetWatcher&);
+};
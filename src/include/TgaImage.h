@@ -0,0 +1,48 @@
+/*
+ * TgaImage.h: Header file for an image decoded with libtarga.
+ *
+ * Decoding touches no GL state, so it can happen on any thread; the pixels
+ * are handed to the GL thread for uploading afterwards.
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "libtarga.h"
+
+class TgaImage {
+  private:
+    ubyte   *data;      // The pixels, starting at the lower left.
+    int     width;
+    int     height;
+
+  public:
+    TgaImage(void) { data = nullptr; width = height = 0; };
+    ~TgaImage(void) { Free(); };
+
+    TgaImage(const TgaImage&) = delete;
+    TgaImage& operator=(const TgaImage&) = delete;
+
+    // Decodes a file into the given TGA_TRUECOLOR_* format. Returns false,
+    // and reports why, if it can't.
+    bool    Load(const char *filename, unsigned int format)
+    {
+        Free();
+        if ( ! ( data = (ubyte*)tga_load(filename, &width, &height, format) ) )
+        {
+            fprintf(stderr, "TgaImage::Load: Couldn't load %s: %s\n"
+                   , filename, tga_error_string(tga_get_last_error()));
+            return false;
+        }
+        return true;
+    };
+
+    // Releases the pixels once they have been uploaded.
+    void    Free(void) { free(data); data = nullptr; width = height = 0; };
+
+    bool            Loaded(void) const { return data != nullptr; };
+    const ubyte*    Data(void) const { return data; };
+    int             Width(void) const { return width; };
+    int             Height(void) const { return height; };
+};
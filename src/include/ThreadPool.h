@@ -0,0 +1,49 @@
+/*
+ * ThreadPool.h: Header file for a fixed-size pool of worker threads.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+  private:
+    std::vector<std::thread>            workers;
+    std::deque<std::function<void()>>   jobs;       // Waiting to run
+    std::mutex                          lock;       // Guards jobs and stopping
+    std::condition_variable             wake;       // Signalled when jobs arrive
+    bool                                stopping;
+
+    void    Work(void);     // The loop each worker runs.
+
+  public:
+    // Starts the given number of workers, or one per hardware thread.
+    explicit ThreadPool(unsigned int threads = 0);
+
+    // Runs whatever is still queued, then joins the workers.
+    ~ThreadPool(void);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queues a job. The future gives its result, or rethrows what it threw.
+    template <class F>
+    auto    Submit(F job) -> std::future<decltype(job())>
+    {
+        auto task = std::make_shared<std::packaged_task<decltype(job())()>>(std::move(job));
+        auto result = task->get_future();
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            jobs.emplace_back([task] { (*task)(); });
+        }
+        wake.notify_one();
+        return result;
+    }
+};
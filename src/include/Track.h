@@ -12,42 +12,51 @@
 #include <vector>
 #include <glm/glm.hpp>
 #include "CubicBspline.h"
+#include "AssetWatcher.h"
+#include "CompiledMesh.h"
+#include "Frustum.h"
+#include "MeshBuffer.h"
+#include "RenderQueue.h"
+#include "TextureCache.h"
 
 class Track {
   private:
-    GLubyte 	    track_list;	    // The display list for the track.
-    GLubyte 	    train_list;	    // The display list for the train.
     bool    	    initialized;    // Whether or not we have been initialized.
-    CubicBspline    *track;	        // The spline that defines the track.
+    CubicBspline<3> *track;	        // The spline that defines the track.
     float	        posn_on_track;  // The train's parametric position on the track.
+    float	        dist_on_track;  // And how far along the track that is.
     float	        speed;	        // The train's speed, in world coordinates
 
     static const int	TRACK_NUM_CONTROLS;	// Constants about the track.
     static const float 	TRACK_CONTROLS[][3];
     static const float 	TRAIN_ENERGY;
+    static const int	TRAIN_NUM_CARS;
 
     // my train model
-    std::vector<glm::vec3> train_vertices;
-    std::vector<glm::vec2> train_uvs;
-    std::vector<glm::vec3> train_normals;
+    CompiledMesh    train_mesh;     // The mapped model, until it is uploaded.
+    MeshBuffer      train_buffer;   // The uploaded model
+    MeshBuffer      rails_buffer;   // Both rails, swept along the spline
+    MeshBuffer      supports_buffer;    // Posts from the ground up to the track
 
-    // my train buffers
-    GLuint vertexbuffer;
-    GLuint uvbuffer;
-    GLuint normalbuffer;
+    TextureCache::Handle texture;   // The train car texture.
+    BoundingSphere  bounds;         // Around the track and the train on it
 
-    GLuint          texture_obj;    // The object for the teacup texture.
+    void    Update_Bounds(void);    // Refits bounds to the uploaded meshes.
 
   public:
     // Constructor
-    Track(void) { initialized = false; posn_on_track = 0.0f; speed = 0.0f; texture_obj = 0; };
+    Track(void) { initialized = false; track = nullptr; posn_on_track = 0.0f; dist_on_track = 0.0f; speed = 0.0f; bounds = { glm::vec3(0.0f), 0.0f }; };
 
     // Destructor
     ~Track(void);
 
+    bool    Load(void);         // Reads the files. Safe off the GL thread.
     bool    Initialize(void);	// Gets everything set up for drawing.
     void    Update(float, float*, float*);	// Updates the location of the train
-    void    Draw(void);		// Draws everything.
+    void    Draw(RenderQueue&);	// Draws the track and queues the train.
+    const BoundingSphere&   Bounds(void) const { return bounds; };  // Set by Initialize() and reloads
+    void    Print_Stats(FILE*) const;  // Reports what the model costs.
+    void    Watch(AssetWatcher&);  // Reloads the model when it is rebaked.
 };
 
 
@@ -1,5 +1,9 @@
 /*
  * Tree.h: Header file for a parameterized class that draws trees.
+ *
+ * One Tree is one shape of tree, planted any number of times. Every tree
+ * of a shape is drawn with two instanced draws, the trunk and the foliage,
+ * however many there are.
  */
 
 #pragma once
@@ -7,6 +11,10 @@
 #include <FL/gl.h>
 #include <array>
 #include <map>
+#include <glm/glm.hpp>
+#include "InstanceBuffer.h"
+#include "MeshBuffer.h"
+#include "RenderQueue.h"
 
 enum Season {
     SPRING,
@@ -17,8 +25,6 @@ enum Season {
 
 class Tree {
   private:
-    GLubyte display_list;   // The display list that does all the work.
-    //GLuint  texture_obj;    // The object for the trunk texture.
     bool    initialized;    // Whether or not we have been initialised.
 
     Season  season;
@@ -27,6 +33,10 @@ class Tree {
     GLfloat foliageHeight;
     GLfloat foliageRadius;
 
+    MeshBuffer      trunk;      // A cylinder
+    MeshBuffer      foliage;    // A cone on top, closed underneath
+    InstanceBuffer  instances;  // Where each tree is, and its foliage color
+
     // create a map of (Season, color array) pairs; this will set the foliage color based on season.
     static const std::map<Season, std::array<GLfloat, 3>> foliageColors;
 
@@ -34,12 +44,13 @@ class Tree {
     // Constructor
     Tree(Season s, GLfloat trunkHeight, GLfloat trunkRadius, GLfloat foliageHeight, GLfloat foliageRadius);
 
-    // Destructor. Frees the display lists and texture object.
-    ~Tree(void);
-
-    // Initializer. Creates the display list.
+    // Initializer. Builds the meshes.
     bool    Initialize(void);
 
-    // Does the drawing.
-    void    Draw(void);
+    // Adds a tree at the given point, in its season's color, or another.
+    void    Plant(const glm::vec3 &position);
+    void    Plant(const glm::vec3 &position, Season);
+
+    // Queues every tree planted.
+    void    Draw(RenderQueue&);
 };
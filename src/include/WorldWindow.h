@@ -14,6 +14,7 @@
 #include <FL/Fl.H>
 #include <FL/Fl_Gl_Window.H>
 #include <array>
+#include "AssetWatcher.h"
 #include "Ground.h"
 #include "Track.h"
 #include "Teacups.h"
@@ -21,6 +22,7 @@
 #include "Tree.h"
 #include "Globe.h"
 #include "Hill.h"
+#include "RenderQueue.h"
 //#include "Horizon.h"
 
 enum Camera {
@@ -45,6 +47,11 @@ class WorldWindow : public Fl_Gl_Window {
 	// the last time this method was called.
 	bool Update(float);
 
+	// How many objects, meshes and instances the last frame left out
+	// because they were out of view, and how many it tested.
+	size_t	Culled(void) const { return frame_culled; };
+	size_t	Tested(void) const { return frame_tested; };
+
     private:
     Camera  camera;             // The camera mode
 	Ground	ground;			    // The ground object.
@@ -58,7 +65,14 @@ class WorldWindow : public Fl_Gl_Window {
     Globe   globe;              // A globe object.
     Hill    hill;               // A hill object.
 	//Horizon	horizon;		// The horizon object.
+    RenderQueue queue;          // Every mesh drawn this frame
+    AssetWatcher watcher;       // Reloads rebaked assets. Declared after
+                                // the objects it reloads, so it goes first.
     float train_pos[3], train_dir[3];   // The train position and direction.
+    glm::mat4 view;                     // The camera, set each frame.
+    glm::mat4 projection;               // Set when the context is.
+    size_t  frame_tested;               // Bounds tested last frame
+    size_t  frame_culled;               // And found out of view
 
 
 	static const double FOV_X; // The horizontal field of view.
@@ -83,6 +97,10 @@ class WorldWindow : public Fl_Gl_Window {
 	float	y_at_down;  // The y-coord to look at when the mouse went down.
 
 	void	Drag(float);	// The function to call for mouse drag events
+
+    // Reads every object's textures and models on a pool of threads, so
+    // Initialize() is left with nothing but the GL uploads.
+    void    Load_Assets(void);
                             
     // based on camera spawn
     // +down, +right
@@ -0,0 +1,73 @@
+/*
+** tga_kernels.h -- row conversion kernels for libtarga.
+**
+** Each kernel converts a run of pixels from the order they are stored in
+** a targa (BGR, BGRA, packed 16-bit) to what tga_load hands back (RGB or
+** RGBA, alpha premultiplied), exactly as tga_convert_color would, one
+** pixel at a time. Every kernel has a plain C version; on x86-64 there
+** are SSSE3 and AVX2 versions too, picked at run time.
+**
+** The match kernels go the other way, for the RLE encoder: they find
+** where a row of pixels repeats, so runs can be cut without looking at
+** every pixel.
+*/
+
+#ifndef _tga_kernels_h_
+#define _tga_kernels_h_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* converts count pixels from src to dst. src and dst must not overlap. */
+typedef void (*tga_row_kernel)( const unsigned char * src, unsigned char * dst, unsigned int count );
+
+
+/* marks repeats in a row of count 3 or 4 byte pixels: bit i % 32 of
+   same[i / 32] is set when pixel i is the same as pixel i + 1. all
+   (count + 31) / 32 words are written; the bits from count - 1 on are
+   clear. */
+typedef void (*tga_match_kernel)( const unsigned char * row, unsigned int count, unsigned int * same );
+
+
+/* the conversions there are kernels for */
+#define TGA_KERNEL_BGR24_RGB24      (0)     /* 24-bit to 24-bit */
+#define TGA_KERNEL_BGR24_RGBA32     (1)     /* 24-bit to 32-bit, alpha at full */
+#define TGA_KERNEL_BGRA32_RGBA32    (2)     /* 32-bit to 32-bit, premultiplied */
+#define TGA_KERNEL_BGRA32_RGB24     (3)     /* 32-bit to 24-bit, premultiplied */
+#define TGA_KERNEL_BGR565_RGB24     (4)     /* 16-bit 5-6-5 to 24-bit */
+#define TGA_KERNEL_BGR555_RGB24     (5)     /* 15-bit 5-5-5 to 24-bit */
+#define TGA_KERNEL_COUNT            (6)
+
+
+/* instruction sets, from worst to best */
+#define TGA_ISA_SCALAR              (0)
+#define TGA_ISA_SSSE3               (1)
+#define TGA_ISA_AVX2                (2)
+#define TGA_ISA_COUNT               (3)
+
+
+/* the best instruction set this machine runs, within the limit below */
+int             tga_kernel_isa( void );
+
+/* caps the instruction set tga_load will use; for benchmarks and checks */
+void            tga_limit_kernel_isa( int isa );
+
+/* the kernel for a conversion on an instruction set, or NULL if this
+   build doesn't have one. doesn't check that the CPU can run it. */
+tga_row_kernel  tga_get_kernel( int kernel, int isa );
+
+/* the match kernel for pixels of 3 or 4 bytes on an instruction set, or
+   NULL, as above. */
+tga_match_kernel tga_get_match_kernel( unsigned int bytes_per_pix, int isa );
+
+const char *    tga_isa_name( int isa );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* _tga_kernels_h_ */
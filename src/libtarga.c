@@ -46,10 +46,23 @@
   09-16-2005
 */
 #define _CRT_SECURE_NO_DEPRECATE // Added by Feng
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L   // for mmap
+#endif
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <malloc.h>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #include "libtarga.h"
+#include "tga_kernels.h"
 
 
 
@@ -100,7 +113,35 @@
 
 
 
-static uint32 TargaError;
+/* loads may run on several threads at once, so each keeps its own error. */
+#if defined( _MSC_VER )
+#define TGA_THREAD_LOCAL __declspec( thread )
+#else
+#define TGA_THREAD_LOCAL _Thread_local
+#endif
+
+static TGA_THREAD_LOCAL uint32 TargaError;
+
+
+/* a targa file, mapped (or read) into memory in one go. */
+typedef struct {
+    const ubyte * data;
+    size_t        size;
+    int           mapped;       // data came from mmap rather than malloc
+} tga_file;
+
+
+/* where the pixels decoded out of a targa come from and where they go. */
+typedef struct {
+    ubyte    bytes_per_pix;     // bytes per pixel (or index) in the file
+    ubyte *  colormap;          // the palette, or NULL for truecolor
+    ubyte    cmap_bytes_entry;  // bytes per palette entry
+    uint32   cmap_length;       // palette entries
+    uint32   bpp_in;            // the true bits per pixel
+    ubyte    alphabits;         // alpha bits, from the image descriptor
+    uint32   format_out;        // TGA_TRUECOLOR_24 or TGA_TRUECOLOR_32
+    tga_row_kernel kernel;      // converts whole rows at once, or NULL
+} tga_pixel_format;
 
 
 static int16 ttohs( int16 val );
@@ -109,11 +150,22 @@ static int32 ttohl( int32 val );
 static int32 htotl( int32 val );
 
 
-static uint32 tga_get_pixel( FILE * tga, ubyte bytes_per_pix, 
-                            ubyte * colormap, ubyte cmap_bytes_entry );
+static int tga_open_file( const char * filename, tga_file * file );
+static void tga_close_file( tga_file * file );
+static const ubyte * tga_skip( const ubyte * src, const ubyte * end, uint32 bytes );
+static const ubyte * tga_decode_pixels( const ubyte * src, const ubyte * end, uint32 count, 
+                                       const tga_pixel_format * fmt, uint32 * out );
+static void tga_store_pixels( ubyte * dat, ubyte img_spec, uint32 first, uint32 count, 
+                             uint32 w, uint32 h, const uint32 * pixels, uint32 format );
+static void tga_fill_pixels( ubyte * dat, ubyte img_spec, uint32 first, uint32 count, 
+                            uint32 w, uint32 h, uint32 pixel, uint32 format );
+static tga_row_kernel tga_pick_kernel( const tga_pixel_format * fmt, ubyte img_spec );
+static const ubyte * tga_convert_pixels( const ubyte * src, const tga_pixel_format * fmt, ubyte * dat, 
+                                        ubyte img_spec, uint32 first, uint32 count, uint32 w, uint32 h );
 static uint32 tga_convert_color( uint32 pixel, uint32 bpp_in, ubyte alphabits, uint32 format_out );
-static void tga_write_pixel_to_mem( ubyte * dat, ubyte img_spec, uint32 number, 
-                                   uint32 w, uint32 h, uint32 pixel, uint32 format );
+static void tga_unpremultiply_row( const ubyte * src, ubyte * dst, uint32 count );
+static uint32 tga_find_bit( const uint32 * bits, uint32 first, uint32 limit, int value );
+static uint32 tga_count_trailing_zeros( uint32 word );
 
 
 
@@ -199,6 +251,91 @@ void * tga_create( int width, int height, unsigned int format ) {
 
 
 
+/* maps a whole file read-only, or reads it into memory where we can't map. */
+static int tga_open_file( const char * filename, tga_file * file ) {
+
+    file->data = NULL;
+    file->size = 0;
+    file->mapped = 0;
+
+#ifndef _WIN32
+    {
+        struct stat st;
+        int fd = open( filename, O_RDONLY );
+        void * map;
+
+        if( fd < 0 ) {
+            return( 0 );
+        }
+        if( fstat( fd, &st ) != 0 ) {
+            close( fd );
+            return( 0 );
+        }
+
+        /* an empty file opens fine; it just has no header */
+        if( st.st_size > 0 ) {
+            map = mmap( NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+            if( map == MAP_FAILED ) {
+                close( fd );
+                return( 0 );
+            }
+            posix_madvise( map, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL );
+            file->data = (const ubyte *)map;
+            file->size = (size_t)st.st_size;
+            file->mapped = 1;
+        }
+        close( fd );
+    }
+#else
+    {
+        FILE * fp = fopen( filename, "rb" );
+        long length;
+        ubyte * buf;
+
+        if( fp == NULL ) {
+            return( 0 );
+        }
+        fseek( fp, 0, SEEK_END );
+        length = ftell( fp );
+        fseek( fp, 0, SEEK_SET );
+
+        if( length > 0 ) {
+            buf = (ubyte *)malloc( (size_t)length );
+            if( buf == NULL || fread( buf, 1, (size_t)length, fp ) != (size_t)length ) {
+                free( buf );
+                fclose( fp );
+                return( 0 );
+            }
+            file->data = buf;
+            file->size = (size_t)length;
+        }
+        fclose( fp );
+    }
+#endif
+
+    return( 1 );
+
+}
+
+
+static void tga_close_file( tga_file * file ) {
+
+#ifndef _WIN32
+    if( file->mapped ) {
+        munmap( (void *)file->data, file->size );
+    }
+#else
+    free( (void *)file->data );
+#endif
+
+    file->data = NULL;
+    file->size = 0;
+    file->mapped = 0;
+
+}
+
+
+
 /* loads and converts a targa from disk */
 void * tga_load( const char * filename, 
                 int * width, int * height, unsigned int format ) {
@@ -216,24 +353,19 @@ void * tga_load( const char * filename,
     ubyte  img_spec_pix_depth;  // the depth of a pixel in the image.
     ubyte  img_spec_img_desc;   // the image descriptor.
 
-    FILE * targafile;
+    tga_file targafile;
 
-    ubyte * tga_hdr = NULL;
+    const ubyte * tga_hdr = NULL;
+    const ubyte * src = NULL;   // the next unread byte of the file
+    const ubyte * end = NULL;   // one past the last byte of the file
 
     ubyte * colormap = NULL;
 
-    //***********************************************************************
-    // Add by Yu-Chi because of variable initialization.
-    // Add all = 0 to all the following variables
-    //***********************************************************************
-
-
     ubyte cmap_bytes_entry = 0;
     uint32 cmap_bytes = 0;
     
     uint32 tmp_col = 0;
     uint32 tmp_int32 = 0;
-    ubyte  tmp_byte = 0;
 
     ubyte alphabits = 0;
 
@@ -243,7 +375,6 @@ void * tga_load( const char * filename,
     uint32 j = 0;
 
     ubyte * image_data = 0;
-    uint32 img_dat_len = 0;
 
     ubyte bytes_per_pix = 0;
 
@@ -252,7 +383,12 @@ void * tga_load( const char * filename,
     uint32 bytes_total = 0;
 
     ubyte packet_header = 0;
-    ubyte repcount = 0;
+    uint32 repcount = 0;
+
+    tga_pixel_format pixfmt;
+
+    uint32 * row = NULL;                    // one decoded scanline
+    uint32 packet[128];                     // one decoded RLE packet
     
 
     switch( format ) {
@@ -268,23 +404,24 @@ void * tga_load( const char * filename,
     }
 
     
-    /* open binary image file */
-    targafile = fopen( filename, "rb" );
-    if( targafile == NULL ) {
+    /* map the whole file; everything below decodes straight out of memory */
+    if( ! tga_open_file( filename, &targafile ) ) {
         TargaError = TGA_ERR_OPEN_FAILS;
         return( NULL );
     }
 
+    src = targafile.data;
+    end = targafile.data + targafile.size;
 
-    /* allocate memory for the header */
-    tga_hdr = (ubyte *)malloc( HDR_LENGTH );
 
-    /* read the header in. */
-    if( fread( (void *)tga_hdr, 1, HDR_LENGTH, targafile ) != HDR_LENGTH ) {
-        free( tga_hdr );
+    /* the header is the first HDR_LENGTH bytes. */
+    if( targafile.size < HDR_LENGTH ) {
+        tga_close_file( &targafile );
         TargaError = TGA_ERR_BAD_HEADER;
         return( NULL );
     }
+    tga_hdr = src;
+    src += HDR_LENGTH;
 
     
     /* byte order is important here. */
@@ -304,12 +441,11 @@ void * tga_load( const char * filename,
     img_spec_pix_depth = (ubyte)tga_hdr[HDR_IMG_SPEC_PIX_DEPTH];
     img_spec_img_desc  = (ubyte)tga_hdr[HDR_IMG_SPEC_IMG_DESC];
 
-    free( tga_hdr );
-
 
     num_pixels = img_spec_width * img_spec_height;
 
     if( num_pixels == 0 ) {
+        tga_close_file( &targafile );
         TargaError = TGA_ERR_BAD_DIMENSIONS;
         return( NULL );
     }
@@ -318,17 +454,14 @@ void * tga_load( const char * filename,
     alphabits = img_spec_img_desc & 0x0F;
 
     
-    /* seek past the image id, if there is one */
-    if( idlen ) {
-        if( fseek( targafile, idlen, SEEK_CUR ) ) {
-            TargaError = TGA_ERR_UNEXPECTED_EOF;
-            return( NULL );
-        }
-    }
+    /* skip the image id, if there is one. like fseek, going past the end
+       isn't an error; the reads that follow just come up empty. */
+    src = tga_skip( src, end, idlen );
 
 
     /* if this is a 'nodata' image, just jump out. */
     if( image_type == TGA_IMG_NODATA ) {
+        tga_close_file( &targafile );
         TargaError = TGA_ERR_NODATA_IMAGE;
         return( NULL );
     }
@@ -355,6 +488,7 @@ void * tga_load( const char * filename,
             
         case TGA_IMG_UNC_GRAYSCALE:
         case TGA_IMG_RLE_GRAYSCALE:
+            tga_close_file( &targafile );
             TargaError = TGA_ERR_COLORMAP_FOR_GRAY;
             return( NULL );
         }
@@ -364,6 +498,7 @@ void * tga_load( const char * filename,
             cmap_entry_size == 16 ||
             cmap_entry_size == 24 ||
             cmap_entry_size == 32) ) {
+            tga_close_file( &targafile );
             TargaError = TGA_ERR_BAD_COLORMAP_ENTRY_SIZE;
             return( NULL );
         }
@@ -384,18 +519,21 @@ void * tga_load( const char * filename,
             
             /* seek ahead to first entry used */
             if( cmap_first != 0 ) {
-                fseek( targafile, cmap_first * cmap_bytes_entry, SEEK_CUR );
+                src = tga_skip( src, end, cmap_first * cmap_bytes_entry );
             }
             
+            if( (size_t)(end - src) < cmap_bytes_entry ) {
+                free( colormap );
+                tga_close_file( &targafile );
+                TargaError = TGA_ERR_BAD_COLORMAP;
+                return( NULL );
+            }
+
             tmp_int32 = 0;
             for( j = 0; j < cmap_bytes_entry; j++ ) {
-                if( !fread( &tmp_byte, 1, 1, targafile ) ) {
-                    free( colormap );
-                    TargaError = TGA_ERR_BAD_COLORMAP;
-                    return( NULL );
-                }
-                tmp_int32 += tmp_byte << (j * 8);
+                tmp_int32 += (uint32)src[j] << (j * 8);
             }
+            src += cmap_bytes_entry;
 
             // byte order correct.
             tmp_int32 = ttohl( tmp_int32 );
@@ -423,16 +561,24 @@ void * tga_load( const char * filename,
     }
 
 
+    // compute the true number of bits per pixel
+    true_bits_per_pixel = cmap_type ? cmap_entry_size : img_spec_pix_depth;
+
+    pixfmt.bytes_per_pix = bytes_per_pix;
+    pixfmt.colormap = colormap;
+    pixfmt.cmap_bytes_entry = cmap_bytes_entry;
+    pixfmt.cmap_length = cmap_length;
+    pixfmt.bpp_in = true_bits_per_pixel;
+    pixfmt.alphabits = alphabits;
+    pixfmt.format_out = format;
+    pixfmt.kernel = tga_pick_kernel( &pixfmt, img_spec_img_desc );
+
+
     /* compute how many bytes of storage we need for the image */
     bytes_total = img_spec_width * img_spec_height * format;
 
     image_data = (ubyte *)malloc( bytes_total );
 
-    img_dat_len = img_spec_width * img_spec_height * bytes_per_pix;
-
-    // compute the true number of bits per pixel
-    true_bits_per_pixel = cmap_type ? cmap_entry_size : img_spec_pix_depth;
-
     switch( image_type ) {
 
     case TGA_IMG_UNC_TRUECOLOR:
@@ -441,17 +587,26 @@ void * tga_load( const char * filename,
 
         /* FIXME: support grayscale */
 
-        for( i = 0; i < num_pixels; i++ ) {
+        /* a scanline at a time: decode it, then store it. */
+        row = (uint32 *)malloc( img_spec_width * sizeof( uint32 ) );
 
-            // get the color value.
-            tmp_col = tga_get_pixel( targafile, bytes_per_pix, colormap, cmap_bytes_entry );
-            tmp_col = tga_convert_color( tmp_col, true_bits_per_pixel, alphabits, format );
-            
-            // now write the data out.
-            tga_write_pixel_to_mem( image_data, img_spec_img_desc, 
-                i, img_spec_width, img_spec_height, tmp_col, format );
+        for( i = 0; i < num_pixels; i += img_spec_width ) {
+
+            if( pixfmt.kernel != NULL && 
+                (size_t)(end - src) >= (size_t)img_spec_width * bytes_per_pix ) {
+                // straight from the file into the image.
+                src = tga_convert_pixels( src, &pixfmt, image_data, img_spec_img_desc, 
+                    i, img_spec_width, img_spec_width, img_spec_height );
+                continue;
+            }
+
+            src = tga_decode_pixels( src, end, img_spec_width, &pixfmt, row );
+            tga_store_pixels( image_data, img_spec_img_desc, 
+                i, img_spec_width, img_spec_width, img_spec_height, row, format );
 
         }
+
+        free( row );
     
         break;
 
@@ -465,47 +620,49 @@ void * tga_load( const char * filename,
         for( i = 0; i < num_pixels; ) {
 
             /* a bit of work to do to read the data.. */
-            if( fread( &packet_header, 1, 1, targafile ) < 1 ) {
+            if( src < end ) {
+                packet_header = *src++;
+            } else {
                 // well, just let them fill the rest with null pixels then...
                 packet_header = 1;
             }
 
+            repcount = (packet_header & 0x7F) + 1;
+
             if( packet_header & 0x80 ) {
-                /* run length packet */
+                /* run length packet, one pixel filled across the image */
 
-                tmp_col = tga_get_pixel( targafile, bytes_per_pix, colormap, cmap_bytes_entry );
-                tmp_col = tga_convert_color( tmp_col, true_bits_per_pixel, alphabits, format );
-                
-                repcount = (packet_header & 0x7F) + 1;
-                
-                /* write all the data out */
-                for( j = 0; j < repcount; j++ ) {
-                    tga_write_pixel_to_mem( image_data, img_spec_img_desc, 
-                        i + j, img_spec_width, img_spec_height, tmp_col, format );
-                }
+                src = tga_decode_pixels( src, end, 1, &pixfmt, &tmp_col );
+
+                tga_fill_pixels( image_data, img_spec_img_desc, 
+                    i, repcount, img_spec_width, img_spec_height, tmp_col, format );
 
                 i += repcount;
+                continue;
 
-            } else {
-                /* raw packet */
-                /* get pixel from file */
-                
-                repcount = (packet_header & 0x7F) + 1;
-                
-                for( j = 0; j < repcount; j++ ) {
-                    
-                    tmp_col = tga_get_pixel( targafile, bytes_per_pix, colormap, cmap_bytes_entry );
-                    tmp_col = tga_convert_color( tmp_col, true_bits_per_pixel, alphabits, format );
-                    
-                    tga_write_pixel_to_mem( image_data, img_spec_img_desc, 
-                        i + j, img_spec_width, img_spec_height, tmp_col, format );
+            } else if( pixfmt.kernel != NULL && 
+                       (size_t)(end - src) >= repcount * bytes_per_pix ) {
+                /* raw packet, straight from the file into the image */
 
-                }
+                src = tga_convert_pixels( src, &pixfmt, image_data, img_spec_img_desc, 
+                    i, repcount, img_spec_width, img_spec_height );
 
                 i += repcount;
+                continue;
+
+            } else {
+                /* raw packet */
+
+                src = tga_decode_pixels( src, end, repcount, &pixfmt, packet );
 
             }
 
+            /* write all the data out */
+            tga_store_pixels( image_data, img_spec_img_desc, 
+                i, repcount, img_spec_width, img_spec_height, packet, format );
+
+            i += repcount;
+
         }
 
         break;
@@ -513,12 +670,16 @@ void * tga_load( const char * filename,
 
     default:
 
+        free( image_data );
+        free( colormap );
+        tga_close_file( &targafile );
         TargaError = TGA_ERR_BAD_IMAGE_TYPE;
         return( NULL );
 
     }
 
-    fclose( targafile );
+    free( colormap );
+    tga_close_file( &targafile );
 
     *width  = img_spec_width;
     *height = img_spec_height;
@@ -673,32 +834,28 @@ int tga_write_rle( const char * file, int width, int height, unsigned char * dat
 
     FILE * tga;
 
-    uint32 i, j;
-    uint32 oc, nc;
-
-    enum RLE_STATE { INIT, NONE, RLP, RAWP };
-
-    int state = INIT;
+    uint32 x, y;
+    uint32 end;
 
-    uint32 size = width * height;
+    uint32 w = (uint32)width;
 
     uint16 shortwidth = (uint16)width;
     uint16 shortheight = (uint16)height;
 
-    ubyte repcount;
-
-    float red, green, blue, alpha;
-
-    int idx, row, column;
+    tga_row_kernel convert;
+    tga_match_kernel match;
 
-    // have to buffer a whole line for raw packets.
-    unsigned char * rawbuf = (unsigned char *)malloc( width * format );  
+    // a row at a time: converted to BGR, its repeats marked, then packed.
+    // every packet holds at least one pixel, so a row packs into at most
+    // one extra byte a pixel.
+    ubyte * row;
+    uint32 * same;
+    ubyte * packed;
+    ubyte * out;
 
     char id[] = "written with libtarga";
     ubyte idlen = 21;
     ubyte zeroes[5] = { 0, 0, 0, 0, 0 };
-    uint32 pixbuf;
-    ubyte one = 1;
     ubyte cmap_type = 0;
     ubyte img_type  = 10;  // 2 - uncompressed truecolor  10 - RLE truecolor
     uint16 xorigin  = 0;
@@ -709,7 +866,13 @@ int tga_write_rle( const char * file, int width, int height, unsigned char * dat
 
     switch( format ) {
     case TGA_TRUECOLOR_24:
+        // swapping red and blue undoes itself.
+        convert = tga_get_kernel( TGA_KERNEL_BGR24_RGB24, tga_kernel_isa() );
+        break;
+
     case TGA_TRUECOLOR_32:
+        // only swaps opaque pixels; tga_unpremultiply_row does the rest.
+        convert = tga_get_kernel( TGA_KERNEL_BGRA32_RGBA32, tga_kernel_isa() );
         break;
 
     default:
@@ -717,10 +880,30 @@ int tga_write_rle( const char * file, int width, int height, unsigned char * dat
         return( 0 );
     }
 
+    if( width <= 0 || height <= 0 ) {
+        TargaError = TGA_ERR_BAD_DIMENSIONS;
+        return( 0 );
+    }
+
+    match = tga_get_match_kernel( format, tga_kernel_isa() );
+
+    row = (ubyte *)malloc( w * format );
+    same = (uint32 *)malloc( ((w + 31) / 32) * sizeof( uint32 ) );
+    packed = (ubyte *)malloc( w * (format + 1) );
+
+    if( row == NULL || same == NULL || packed == NULL ) {
+        free( row );
+        free( same );
+        free( packed );
+        return( 0 );
+    }
 
     tga = fopen( file, "wb" );
 
     if( tga == NULL ) {
+        free( row );
+        free( same );
+        free( packed );
         TargaError = TGA_ERR_OPEN_FAILS;
         return( 0 );
     }
@@ -749,379 +932,472 @@ int tga_write_rle( const char * file, int width, int height, unsigned char * dat
     // write image id.
     fwrite( &id, idlen, 1, tga );
 
-    // initial color values -- just to shut up the compiler.
-    nc = 0;
+    // packets never cross the end of a row.
+    for( y = 0; y < (uint32)height; y++, dat += w * format ) {
 
-    // color correction -- data is in RGB, need BGR.
-    // also run-length-encoding.
-    for( i = 0; i < size; i++ ) {
+        // color correction -- data is in RGB, need BGR.
+        convert( dat, row, w );
+        if( format == TGA_TRUECOLOR_32 ) {
+            tga_unpremultiply_row( dat, row, w );
+        }
 
-        idx = i * format;
+        match( row, w, same );
 
-        row = i / width;
-        column = i % width;
+        out = packed;
+        for( x = 0; x < w; ) {
+
+            if( (same[x >> 5] >> (x & 31)) & 1 ) {
+                // pixel x repeats: a run up to the first pixel that doesn't,
+                // which includes that one.
+                end = tga_find_bit( same, x, x + 127, 0 );
+                *out++ = (ubyte)(0x80 | (end - x));
+                memcpy( out, row + x * format, format );
+                out += format;
+                x = end + 1;
+            } else {
+                // a raw packet up to where the next run starts.
+                end = tga_find_bit( same, x, ( w - x > 128 ) ? x + 128 : w, 1 );
+                *out++ = (ubyte)(end - x - 1);
+                memcpy( out, row + x * format, (end - x) * format );
+                out += (end - x) * format;
+                x = end;
+            }
 
-        //printf( "row: %d, col: %d\n", row, column );
-        pixbuf = 0;
-        for( j = 0; j < format; j++ ) {
-            pixbuf += dat[idx+j] << (8 * j);
         }
 
-        switch( format ) {
+        fwrite( packed, out - packed, 1, tga );
 
-        case TGA_TRUECOLOR_24:
+    }
 
-            pixbuf = ((pixbuf & 0xFF) << 16) + 
-                     (pixbuf & 0xFF00) + 
-                     ((pixbuf & 0xFF0000) >> 16);
 
-            pixbuf = htotl( pixbuf );
-            break;
+    // close the file.
+    fclose( tga );
 
-        case TGA_TRUECOLOR_32:
+    free( row );
+    free( same );
+    free( packed );
 
-            /* need to un-premultiply alpha.. */
+    return( 1 );
 
-            red     = (pixbuf & 0xFF) / 255.0f;
-            green   = ((pixbuf & 0xFF00) >> 8) / 255.0f;
-            blue    = ((pixbuf & 0xFF0000) >> 16) / 255.0f;
-            alpha   = ((pixbuf & 0xFF000000) >> 24) / 255.0f;
+}
 
-            if( alpha > 0.0001 ) {
-                red /= alpha;
-                green /= alpha;
-                blue /= alpha;
-            }
 
-            /* clamp to 1.0f */
 
-            red = red > 1.0f ? 255.0f : red * 255.0f;
-            green = green > 1.0f ? 255.0f : green * 255.0f;
-            blue = blue > 1.0f ? 255.0f : blue * 255.0f;
-            alpha = alpha > 1.0f ? 255.0f : alpha * 255.0f;
 
-            pixbuf = (ubyte)blue + (((ubyte)green) << 8) + 
-                (((ubyte)red) << 16) + (((ubyte)alpha) << 24);
-                
-            pixbuf = htotl( pixbuf );
-            break;
+static void tga_unpremultiply_row( const ubyte * src, ubyte * dst, uint32 count ) {
+
+    /* need to un-premultiply alpha.. the kernel has already swapped the
+       opaque pixels, which it can do exactly; the rest are redone here. */
+
+    float red, green, blue, alpha;
+    uint32 i;
+
+    for( i = 0; i < count; i++, src += 4, dst += 4 ) {
 
+        if( src[3] == 0xFF ) {
+            continue;
         }
 
+        red     = src[0] / 255.0f;
+        green   = src[1] / 255.0f;
+        blue    = src[2] / 255.0f;
+        alpha   = src[3] / 255.0f;
 
-        oc = nc;
+        if( alpha > 0.0001 ) {
+            red /= alpha;
+            green /= alpha;
+            blue /= alpha;
+        }
 
-        nc = pixbuf;
+        /* clamp to 1.0f */
 
+        red = red > 1.0f ? 255.0f : red * 255.0f;
+        green = green > 1.0f ? 255.0f : green * 255.0f;
+        blue = blue > 1.0f ? 255.0f : blue * 255.0f;
+        alpha = alpha > 1.0f ? 255.0f : alpha * 255.0f;
 
-        switch( state ) {
+        dst[0] = (ubyte)blue;
+        dst[1] = (ubyte)green;
+        dst[2] = (ubyte)red;
+        dst[3] = (ubyte)alpha;
 
-        case INIT:
-            // this is just used to make sure we have 2 pixel values to consider.
-            state = NONE;
-            break;
+    }
 
+}
 
-        case NONE:
 
-            if( column == 0 ) {
-                // write a 1 pixel raw packet for the old pixel, then go thru again.
-                repcount = 0;
-                fwrite( &repcount, 1, 1, tga );
-#ifdef WORDS_BIGENDIAN
-                fwrite( (&oc)+4, format, 1, tga );  // byte order..
-#else
-                fwrite( &oc, format, 1, tga );
-#endif
-                state = NONE;
-                break;
-            }
 
-            if( nc == oc ) {
-                repcount = 0;
-                state = RLP;
-            } else {
-                repcount = 0;
-                state = RAWP;
-                for( j = 0; j < format; j++ ) {
-#ifdef WORDS_BIGENDIAN
-                    rawbuf[(repcount * format) + j] = (ubyte)(*((&oc)+format-j-1));
-#else
-                    rawbuf[(repcount * format) + j] = *(((ubyte *)(&oc)) + j);
-#endif
-                }
-            }
-            break;
 
+static uint32 tga_find_bit( const uint32 * bits, uint32 first, uint32 limit, int value ) {
 
-        case RLP:
-            repcount++;
+    // the first bit from first on that is value, or limit if none is
+    // before it. whole words at a time.
 
-            if( column == 0 ) {
-                // finish off rlp.
-                repcount |= 0x80;
-                fwrite( &repcount, 1, 1, tga );
-#ifdef WORDS_BIGENDIAN
-                fwrite( (&oc)+4, format, 1, tga );  // byte order..
-#else
-                fwrite( &oc, format, 1, tga );
-#endif
-                state = NONE;
-                break;
-            }
+    uint32 word;
+    uint32 i = first;
 
-            if( repcount == 127 ) {
-                // finish off rlp.
-                repcount |= 0x80;
-                fwrite( &repcount, 1, 1, tga );
-#ifdef WORDS_BIGENDIAN
-                fwrite( (&oc)+4, format, 1, tga );  // byte order..
-#else
-                fwrite( &oc, format, 1, tga );
-#endif
-                state = NONE;
-                break;
-            }
+    while( i < limit ) {
 
-            if( nc != oc ) {
-                // finish off rlp
-                repcount |= 0x80;
-                fwrite( &repcount, 1, 1, tga );
-#ifdef WORDS_BIGENDIAN
-                fwrite( (&oc)+4, format, 1, tga );  // byte order..
-#else
-                fwrite( &oc, format, 1, tga );
-#endif
-                state = NONE;
-            }
-            break;
+        word = bits[i >> 5];
+        if( ! value ) {
+            word = ~word;
+        }
+        word >>= (i & 31);
 
+        if( word != 0 ) {
+            i += tga_count_trailing_zeros( word );
+            return( i < limit ? i : limit );
+        }
+        i = (i | 31) + 1;
 
-        case RAWP:
-            repcount++;
+    }
 
-            if( column == 0 ) {
-                // finish off rawp.
-                for( j = 0; j < format; j++ ) {
-#ifdef WORDS_BIGENDIAN
-                    rawbuf[(repcount * format) + j] = (ubyte)(*((&oc)+format-j-1));
-#else
-                    rawbuf[(repcount * format) + j] = *(((ubyte *)(&oc)) + j);
-#endif
-                }
-                fwrite( &repcount, 1, 1, tga );
-                fwrite( rawbuf, (repcount + 1) * format, 1, tga );
-                state = NONE;
-                break;
-            }
+    return( limit );
 
-            if( repcount == 127 ) {
-                // finish off rawp.
-                for( j = 0; j < format; j++ ) {
-#ifdef WORDS_BIGENDIAN
-                    rawbuf[(repcount * format) + j] = (ubyte)(*((&oc)+format-j-1));
-#else
-                    rawbuf[(repcount * format) + j] = *(((ubyte *)(&oc)) + j);
-#endif
-                }
-                fwrite( &repcount, 1, 1, tga );
-                fwrite( rawbuf, (repcount + 1) * format, 1, tga );
-                state = NONE;
-                break;
-            }
+}
 
-            if( nc == oc ) {
-                // finish off rawp
-                repcount--;
-                fwrite( &repcount, 1, 1, tga );
-                fwrite( rawbuf, (repcount + 1) * format, 1, tga );
-                
-                // start new rlp
-                repcount = 0;
-                state = RLP;
-                break;
-            }
 
-            // continue making rawp
-            for( j = 0; j < format; j++ ) {
-#ifdef WORDS_BIGENDIAN
-                rawbuf[(repcount * format) + j] = (ubyte)(*((&oc)+format-j-1));
+
+
+static uint32 tga_count_trailing_zeros( uint32 word ) {
+
+    /* word isn't 0. */
+
+#if defined( _MSC_VER )
+    unsigned long index;
+    _BitScanForward( &index, word );
+    return( (uint32)index );
+#elif defined( __GNUC__ )
+    return( (uint32)__builtin_ctz( word ) );
 #else
-                rawbuf[(repcount * format) + j] = *(((ubyte *)(&oc)) + j);
+    uint32 n = 0;
+    while( ! (word & 1) ) {
+        word >>= 1;
+        n++;
+    }
+    return( n );
 #endif
-            }
 
-            break;
+}
+
+
+
+
+
 
-        }
-       
 
+/*************************************************************************************************/
+
+
+
+
+
+
+
+static const ubyte * tga_skip( const ubyte * src, const ubyte * end, uint32 bytes ) {
+
+    // skipping past the end just leaves us at the end, like an fseek
+    // followed by reads that all fail.
+    if( (size_t)(end - src) < bytes ) {
+        return( end );
     }
+    return( src + bytes );
 
+}
 
-    // clean up state.
 
-    switch( state ) {
 
-    case INIT:
-        break;
 
-    case NONE:
-        // write the last 2 pixels in a raw packet.
-        fwrite( &one, 1, 1, tga );
-#ifdef WORDS_BIGENDIAN
-                fwrite( (&oc)+4, format, 1, tga );  // byte order..
-#else
-                fwrite( &oc, format, 1, tga );
-#endif
-#ifdef WORDS_BIGENDIAN
-                fwrite( (&nc)+4, format, 1, tga );  // byte order..
-#else
-                fwrite( &nc, format, 1, tga );
-#endif
-        break;
 
-    case RLP:
-        repcount++;
-        repcount |= 0x80;
-        fwrite( &repcount, 1, 1, tga );
-#ifdef WORDS_BIGENDIAN
-                fwrite( (&oc)+4, format, 1, tga );  // byte order..
-#else
-                fwrite( &oc, format, 1, tga );
-#endif
-        break;
+static const ubyte * tga_decode_pixels( const ubyte * src, const ubyte * end, uint32 count, 
+                                       const tga_pixel_format * fmt, uint32 * out ) {
 
-    case RAWP:
-        repcount++;
-        for( j = 0; j < format; j++ ) {
-#ifdef WORDS_BIGENDIAN
-            rawbuf[(repcount * format) + j] = (ubyte)(*((&oc)+format-j-1));
-#else
-            rawbuf[(repcount * format) + j] = *(((ubyte *)(&oc)) + j);
+    /* decode count pixels from the file into output colors, returning
+       where the next pixel starts. */
+
+    uint32 tmp_col;
+    uint32 tmp_int32;
+    uint32 alpha;
+
+    uint32 i, j;
+
+    uint32 bytes_per_pix = fmt->bytes_per_pix;
+
+#ifndef WORDS_BIGENDIAN
+    // opaque BGR is the common case, and with alpha at full the premultiply
+    // below changes nothing, so all that's left is swapping red and blue.
+    if( fmt->colormap == NULL && (size_t)(end - src) >= (size_t)count * bytes_per_pix &&
+        ( (fmt->bpp_in == 24 && bytes_per_pix == 3) ||
+          (fmt->bpp_in == 32 && bytes_per_pix == 4 && fmt->alphabits == 0) ) ) {
+
+        alpha = ( fmt->format_out == TGA_TRUECOLOR_32 ) ? 0xFF000000 : 0;
+        for( i = 0; i < count; i++, src += bytes_per_pix ) {
+            out[i] = src[2] + (src[1] << 8) + (src[0] << 16) + alpha;
+        }
+        return( src );
+
+    }
 #endif
+
+    for( i = 0; i < count; i++ ) {
+
+        /* get the image data value out */
+        tmp_int32 = 0;
+        if( (size_t)(end - src) >= bytes_per_pix ) {
+            for( j = 0; j < bytes_per_pix; j++ ) {
+                tmp_int32 += src[j] << (j * 8);
+            }
+            src += bytes_per_pix;
+        } else {
+            // a pixel cut off by the end of the file reads as 0.
+            src = end;
         }
-        fwrite( &repcount, 1, 1, tga );
-        fwrite( rawbuf, (repcount + 1) * 3, 1, tga );
-        break;
+    
+        /* byte-order correct the thing */
+        switch( bytes_per_pix ) {
+        
+        case 2:
+            tmp_int32 = ttohs( (uint16)tmp_int32 );
+            break;
+        
+        case 3: /* intentional fall-thru */
+        case 4:
+            tmp_int32 = ttohl( tmp_int32 );
+            break;
+        
+        }
+    
+        if( fmt->colormap != NULL ) {
+            /* need to look up value to get real color. an index past the
+               end of the palette gets 0 rather than whatever follows it. */
+            tmp_col = 0;
+            for( j = 0; tmp_int32 < fmt->cmap_length && j < fmt->cmap_bytes_entry; j++ ) {
+                tmp_col += fmt->colormap[fmt->cmap_bytes_entry * tmp_int32 + j] << (8 * j);
+            }
+        } else {
+            tmp_col = tmp_int32;
+        }
+
+        out[i] = tga_convert_color( tmp_col, fmt->bpp_in, fmt->alphabits, fmt->format_out );
 
     }
+    
+    return( src );
+    
+}
 
 
-    // close the file.
-    fclose( tga );
 
-    free( rawbuf );
 
-    return( 1 );
 
-}
+static void tga_store_pixels( ubyte * dat, ubyte img_spec, uint32 first, uint32 count, 
+                             uint32 w, uint32 h, const uint32 * pixels, uint32 format ) {
 
+    // write pixels first .. first + count - 1 (in file order) to the data,
+    // a row at a time, regarding how the header says the data is ordered.
 
+    uint32 num_pixels = w * h;
+    uint32 origin = (img_spec & 0x30) >> 4;
+    uint32 i, n;
+    uint32 x, y;
+    int    step;
+    ubyte * dst;
 
+    // a packet that runs off the end of the image is cut short.
+    if( first >= num_pixels ) {
+        return;
+    }
+    if( count > num_pixels - first ) {
+        count = num_pixels - first;
+    }
 
+    while( count > 0 ) {
 
+        x = first % w;
+        y = first / w;
+        n = ( w - x < count ) ? w - x : count;
 
-/*************************************************************************************************/
+        if( origin == TGA_UPPER_LEFT || origin == TGA_UPPER_RIGHT ) {
+            y = h - 1 - y;
+        }
+        if( origin == TGA_LOWER_RIGHT || origin == TGA_UPPER_RIGHT ) {
+            x = w - 1 - x;
+            step = -(int)format;
+        } else {
+            step = (int)format;
+        }
 
+        dst = dat + (y * w + x) * format;
+        if( format == TGA_TRUECOLOR_32 ) {
+            for( i = 0; i < n; i++, dst += step ) {
+                dst[0] = (ubyte)(pixels[i] & 0xFF);
+                dst[1] = (ubyte)((pixels[i] >> 8) & 0xFF);
+                dst[2] = (ubyte)((pixels[i] >> 16) & 0xFF);
+                dst[3] = (ubyte)((pixels[i] >> 24) & 0xFF);
+            }
+        } else {
+            for( i = 0; i < n; i++, dst += step ) {
+                dst[0] = (ubyte)(pixels[i] & 0xFF);
+                dst[1] = (ubyte)((pixels[i] >> 8) & 0xFF);
+                dst[2] = (ubyte)((pixels[i] >> 16) & 0xFF);
+            }
+        }
 
+        pixels += n;
+        first += n;
+        count -= n;
 
+    }
 
+}
 
 
 
-static void tga_write_pixel_to_mem( ubyte * dat, ubyte img_spec, uint32 number, 
-                                   uint32 w, uint32 h, uint32 pixel, uint32 format ) {
 
-    // write the pixel to the data regarding how the
-    // header says the data is ordered.
 
-    uint32 j;
+static void tga_fill_pixels( ubyte * dat, ubyte img_spec, uint32 first, uint32 count, 
+                            uint32 w, uint32 h, uint32 pixel, uint32 format ) {
+
+    // tga_store_pixels for count copies of one pixel. they're all the same,
+    // so which way a row runs doesn't matter: each row's share is filled
+    // from the left, a whole pattern of pixels at a time.
+
+    uint32 num_pixels = w * h;
+    uint32 origin = (img_spec & 0x30) >> 4;
+    uint32 i, n;
     uint32 x, y;
-    uint32 addy;
+    uint32 bytes, done;
+    ubyte pattern[48];      // a whole number of 3 and of 4 byte pixels
+    ubyte * dst;
 
-    switch( (img_spec & 0x30) >> 4 ) {
+    // a packet that runs off the end of the image is cut short.
+    if( first >= num_pixels ) {
+        return;
+    }
+    if( count > num_pixels - first ) {
+        count = num_pixels - first;
+    }
 
-    case TGA_LOWER_RIGHT:
-        x = w - 1 - (number % w);
-        y = number / h;
-        break;
+    for( i = 0; i < sizeof( pattern ) && i < count * format; i += format ) {
+        pattern[i]     = (ubyte)(pixel & 0xFF);
+        pattern[i + 1] = (ubyte)((pixel >> 8) & 0xFF);
+        pattern[i + 2] = (ubyte)((pixel >> 16) & 0xFF);
+        if( format == TGA_TRUECOLOR_32 ) {
+            pattern[i + 3] = (ubyte)((pixel >> 24) & 0xFF);
+        }
+    }
 
-    case TGA_UPPER_LEFT:
-        x = number % w;
-        y = h - 1 - (number / w);
-        break;
+    while( count > 0 ) {
 
-    case TGA_UPPER_RIGHT:
-        x = w - 1 - (number % w);
-        y = h - 1 - (number / w);
-        break;
+        x = first % w;
+        y = first / w;
+        n = ( w - x < count ) ? w - x : count;
 
-    case TGA_LOWER_LEFT:
-    default:
-        x = number % w;
-        y = number / w;
-        break;
+        if( origin == TGA_UPPER_LEFT || origin == TGA_UPPER_RIGHT ) {
+            y = h - 1 - y;
+        }
+        if( origin == TGA_LOWER_RIGHT || origin == TGA_UPPER_RIGHT ) {
+            // this row's pixels end up at w - 1 - x and to the left of it.
+            x = w - x - n;
+        }
 
-    }
+        dst = dat + (y * w + x) * format;
+        bytes = n * format;
+        for( done = 0; bytes - done >= sizeof( pattern ); done += sizeof( pattern ) ) {
+            memcpy( dst + done, pattern, sizeof( pattern ) );
+        }
+        memcpy( dst + done, pattern, bytes - done );
+
+        first += n;
+        count -= n;
 
-    addy = (y * w + x) * format;
-    for( j = 0; j < format; j++ ) {
-        dat[addy + j] = (ubyte)((pixel >> (j * 8)) & 0xFF);
     }
-    
+
 }
 
 
 
 
 
-static uint32 tga_get_pixel( FILE * tga, ubyte bytes_per_pix, 
-                            ubyte * colormap, ubyte cmap_bytes_entry ) {
-    
-    /* get the image data value out */
+static tga_row_kernel tga_pick_kernel( const tga_pixel_format * fmt, ubyte img_spec ) {
 
-    uint32 tmp_col;
-    uint32 tmp_int32;
-    ubyte tmp_byte;
+    // the kernels convert whole runs of truecolor pixels, and write them
+    // left to right.
 
-    uint32 j;
+    uint32 origin = (img_spec & 0x30) >> 4;
+    int kernel = -1;
 
-    tmp_int32 = 0;
-    for( j = 0; j < bytes_per_pix; j++ ) {
-        if( fread( &tmp_byte, 1, 1, tga ) < 1 ) {
-            tmp_int32 = 0;
-        } else {
-            tmp_int32 += tmp_byte << (j * 8);
+#ifdef WORDS_BIGENDIAN
+    return( NULL );
+#endif
+
+    if( fmt->colormap != NULL || origin == TGA_LOWER_RIGHT || origin == TGA_UPPER_RIGHT ) {
+        return( NULL );
+    }
+
+    if( fmt->bytes_per_pix == 3 && fmt->bpp_in == 24 ) {
+        kernel = ( fmt->format_out == TGA_TRUECOLOR_32 ) ? TGA_KERNEL_BGR24_RGBA32 : TGA_KERNEL_BGR24_RGB24;
+    } else if( fmt->bytes_per_pix == 4 && fmt->bpp_in == 32 && fmt->alphabits != 0 ) {
+        kernel = ( fmt->format_out == TGA_TRUECOLOR_32 ) ? TGA_KERNEL_BGRA32_RGBA32 : TGA_KERNEL_BGRA32_RGB24;
+    } else if( fmt->bytes_per_pix == 2 && fmt->format_out == TGA_TRUECOLOR_24 ) {
+        if( fmt->bpp_in == 15 || (fmt->bpp_in == 16 && fmt->alphabits == 1) ) {
+            kernel = TGA_KERNEL_BGR555_RGB24;
+        } else if( fmt->bpp_in == 16 ) {
+            kernel = TGA_KERNEL_BGR565_RGB24;
         }
     }
-    
-    /* byte-order correct the thing */
-    switch( bytes_per_pix ) {
-        
-    case 2:
-        tmp_int32 = ttohs( (uint16)tmp_int32 );
-        break;
-        
-    case 3: /* intentional fall-thru */
-    case 4:
-        tmp_int32 = ttohl( tmp_int32 );
-        break;
-        
+
+    if( kernel < 0 ) {
+        return( NULL );
     }
-    
-    if( colormap != NULL ) {
-        /* need to look up value to get real color */
-        tmp_col = 0;
-        for( j = 0; j < cmap_bytes_entry; j++ ) {
-            tmp_col += colormap[cmap_bytes_entry * tmp_int32 + j] << (8 * j);
+    return( tga_get_kernel( kernel, tga_kernel_isa() ) );
+
+}
+
+
+
+
+
+static const ubyte * tga_convert_pixels( const ubyte * src, const tga_pixel_format * fmt, ubyte * dat, 
+                                        ubyte img_spec, uint32 first, uint32 count, uint32 w, uint32 h ) {
+
+    // run the kernel over pixels first .. first + count - 1, a row at a
+    // time. the caller has checked that they are all in the file.
+
+    uint32 num_pixels = w * h;
+    uint32 origin = (img_spec & 0x30) >> 4;
+    const ubyte * next = src + count * fmt->bytes_per_pix;
+    uint32 n;
+    uint32 x, y;
+
+    // a packet that runs off the end of the image is cut short.
+    if( first >= num_pixels ) {
+        return( next );
+    }
+    if( count > num_pixels - first ) {
+        count = num_pixels - first;
+    }
+
+    while( count > 0 ) {
+
+        x = first % w;
+        y = first / w;
+        n = ( w - x < count ) ? w - x : count;
+
+        if( origin == TGA_UPPER_LEFT ) {
+            y = h - 1 - y;
         }
-    } else {
-        tmp_col = tmp_int32;
+
+        fmt->kernel( src, dat + (y * w + x) * fmt->format_out, n );
+
+        src += n * fmt->bytes_per_pix;
+        first += n;
+        count -= n;
+
     }
-    
-    return( tmp_col );
-    
+
+    return( next );
+
 }
 
 
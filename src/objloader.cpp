@@ -0,0 +1,560 @@
+/*
+ * objloader.cpp: A Wavefront OBJ loader.
+ *
+ * The file is memory-mapped and walked twice. The first walk only counts
+ * lines so that every array can be sized exactly once, and the second parses
+ * numbers with hand-rolled scanners. Nothing is allocated per line and the
+ * C library is never asked to tokenize anything.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <cmath>
+#include "objloader.h"
+#include "MappedFile.h"
+
+namespace {
+
+// Exact powers of ten representable as doubles.
+const double POW10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+inline bool
+Is_Digit(char c)
+{
+    return (unsigned)(c - '0') < 10u;
+}
+
+inline bool
+Is_Blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char*
+Skip_Blanks(const char *p, const char *end)
+{
+    while ( p < end && Is_Blank(*p) )
+        ++p;
+    return p;
+}
+
+inline const char*
+Skip_Token(const char *p, const char *end)
+{
+    while ( p < end && ! Is_Blank(*p) )
+        ++p;
+    return p;
+}
+
+inline const char*
+Line_End(const char *p, const char *end)
+{
+    const char *nl = (const char*)memchr(p, '\n', end - p);
+    return nl ? nl : end;
+}
+
+// Parses a decimal float such as "-1.25e-3". Returns the character after the
+// number, or nullptr if there were no digits.
+const char*
+Parse_Float(const char *p, const char *end, float &out)
+{
+    bool        neg = false;
+    uint64_t    mant = 0;
+    int         digits = 0;     // significant digits held in mant
+    int         exp10 = 0;
+    bool        any = false;
+
+    if ( p < end && ( *p == '-' || *p == '+' ) )
+    {
+        neg = *p == '-';
+        ++p;
+    }
+
+    for ( ; p < end && Is_Digit(*p) ; ++p )
+    {
+        any = true;
+        if ( digits < 19 )
+        {
+            mant = mant * 10 + (uint64_t)(*p - '0');
+            if ( mant ) ++digits;
+        }
+        else
+            ++exp10;
+    }
+
+    if ( p < end && *p == '.' )
+    {
+        for ( ++p ; p < end && Is_Digit(*p) ; ++p )
+        {
+            any = true;
+            if ( digits < 19 )
+            {
+                mant = mant * 10 + (uint64_t)(*p - '0');
+                if ( mant ) ++digits;
+                --exp10;
+            }
+        }
+    }
+
+    if ( ! any )
+        return nullptr;
+
+    if ( p < end && ( *p == 'e' || *p == 'E' ) )
+    {
+        const char  *q = p + 1;
+        bool        eneg = false;
+        int         e = 0;
+
+        if ( q < end && ( *q == '-' || *q == '+' ) )
+        {
+            eneg = *q == '-';
+            ++q;
+        }
+        if ( q < end && Is_Digit(*q) )
+        {
+            for ( ; q < end && Is_Digit(*q) ; ++q )
+                if ( e < 10000 ) e = e * 10 + (*q - '0');
+            exp10 += eneg ? -e : e;
+            p = q;
+        }
+    }
+
+    double v = (double)mant;
+    if ( exp10 < 0 )
+        v = -exp10 <= 22 ? v / POW10[-exp10] : v * std::pow(10.0, exp10);
+    else if ( exp10 > 0 )
+        v = exp10 <= 22 ? v * POW10[exp10] : v * std::pow(10.0, exp10);
+
+    out = (float)( neg ? -v : v );
+    return p;
+}
+
+// Parses an optionally signed decimal integer. Returns nullptr if there were
+// no digits.
+inline const char*
+Parse_Int(const char *p, const char *end, long &out)
+{
+    bool    neg = false;
+    long    v = 0;
+
+    if ( p < end && ( *p == '-' || *p == '+' ) )
+    {
+        neg = *p == '-';
+        ++p;
+    }
+    if ( p >= end || ! Is_Digit(*p) )
+        return nullptr;
+
+    for ( ; p < end && Is_Digit(*p) ; ++p )
+        v = v * 10 + (*p - '0');
+
+    out = neg ? -v : v;
+    return p;
+}
+
+// Turns a 1-based (or negative, relative) OBJ index into a 0-based one.
+// Returns false if it doesn't refer to anything read so far.
+inline bool
+Resolve(long index, size_t count, size_t &out)
+{
+    if ( index > 0 && (size_t)index <= count )
+    {
+        out = (size_t)index - 1;
+        return true;
+    }
+    if ( index < 0 && (size_t)(-index) <= count )
+    {
+        out = count - (size_t)(-index);
+        return true;
+    }
+    return false;
+}
+
+// One corner of a face: "v", "v/vt", "v//vn" or "v/vt/vn".
+struct Corner {
+    long    v, vt, vn;
+};
+
+const char*
+Parse_Corner(const char *p, const char *end, Corner &c)
+{
+    c.vt = c.vn = 0;
+
+    if ( ! ( p = Parse_Int(p, end, c.v) ) )
+        return nullptr;
+    if ( p < end && *p == '/' )
+    {
+        ++p;
+        if ( p < end && *p != '/' )
+            if ( ! ( p = Parse_Int(p, end, c.vt) ) )
+                return nullptr;
+        if ( p < end && *p == '/' )
+            if ( ! ( p = Parse_Int(p + 1, end, c.vn) ) )
+                return nullptr;
+    }
+    return p;
+}
+
+// What the counting pass found.
+struct Obj_Counts {
+    size_t  v, vt, vn;
+    size_t  triangles;
+};
+
+Obj_Counts
+Count(const char *p, const char *end)
+{
+    Obj_Counts  counts = { 0, 0, 0, 0 };
+
+    while ( p < end )
+    {
+        const char *eol = Line_End(p, end);
+
+        p = Skip_Blanks(p, eol);
+        if ( eol - p >= 2 && p[0] == 'v' )
+        {
+            if ( Is_Blank(p[1]) )
+                ++counts.v;
+            else if ( p[1] == 't' )
+                ++counts.vt;
+            else if ( p[1] == 'n' )
+                ++counts.vn;
+        }
+        else if ( eol - p >= 2 && p[0] == 'f' && Is_Blank(p[1]) )
+        {
+            // a polygon with k corners fans out into k - 2 triangles
+            size_t corners = 0;
+            for ( p = Skip_Blanks(p + 1, eol) ; p < eol ; p = Skip_Blanks(p, eol) )
+            {
+                ++corners;
+                p = Skip_Token(p, eol);
+            }
+            if ( corners >= 3 )
+                counts.triangles += corners - 2;
+        }
+
+        p = eol + 1;
+    }
+
+    return counts;
+}
+
+// A face corner after its indices have been resolved. vt and vn are NONE
+// when the file didn't give them.
+const size_t NONE = (size_t)-1;
+
+struct Ref {
+    size_t  v, vt, vn;
+};
+
+// The attribute arrays as read from the file.
+struct Obj_Data {
+    std::vector<glm::vec3>  vertices;
+    std::vector<glm::vec2>  uvs;
+    std::vector<glm::vec3>  normals;
+};
+
+// The flat normal of a triangle, for faces that don't have normals.
+glm::vec3
+Face_Normal(const Obj_Data &data, const Ref *tri)
+{
+    glm::vec3 n = glm::cross(data.vertices[tri[1].v] - data.vertices[tri[0].v]
+                           , data.vertices[tri[2].v] - data.vertices[tri[0].v]);
+    float l = glm::length(n);
+    return l > 0.0f ? n / l : n;
+}
+
+// Parses the whole file into data, handing each triangle to emit() as soon
+// as its face is read. Faces are fanned around their first corner.
+template <class Emit>
+bool
+Parse(const char *filename, const char *begin, const char *end
+     , Obj_Data &data, Emit emit)
+{
+    size_t      nv = 0, nvt = 0, nvn = 0;
+    int         line = 0;
+    const char  *p = begin;
+
+    while ( p < end )
+    {
+        const char *eol = Line_End(p, end);
+        ++line;
+
+        p = Skip_Blanks(p, eol);
+        if ( eol - p >= 2 && p[0] == 'v' && Is_Blank(p[1]) )
+        {
+            // vertex
+            glm::vec3 &vertex = data.vertices[nv++];
+            if ( ! ( p = Parse_Float(Skip_Blanks(p + 1, eol), eol, vertex.x) )
+              || ! ( p = Parse_Float(Skip_Blanks(p, eol), eol, vertex.y) )
+              || ! ( p = Parse_Float(Skip_Blanks(p, eol), eol, vertex.z) ) )
+                goto bad_line;
+        }
+        else if ( eol - p >= 3 && p[0] == 'v' && p[1] == 't' && Is_Blank(p[2]) )
+        {
+            // texture, v is optional
+            glm::vec2 &uv = data.uvs[nvt++];
+            if ( ! ( p = Parse_Float(Skip_Blanks(p + 2, eol), eol, uv.x) ) )
+                goto bad_line;
+            if ( ! Parse_Float(Skip_Blanks(p, eol), eol, uv.y) )
+                uv.y = 0.0f;
+        }
+        else if ( eol - p >= 3 && p[0] == 'v' && p[1] == 'n' && Is_Blank(p[2]) )
+        {
+            // normal
+            glm::vec3 &normal = data.normals[nvn++];
+            if ( ! ( p = Parse_Float(Skip_Blanks(p + 2, eol), eol, normal.x) )
+              || ! ( p = Parse_Float(Skip_Blanks(p, eol), eol, normal.y) )
+              || ! ( p = Parse_Float(Skip_Blanks(p, eol), eol, normal.z) ) )
+                goto bad_line;
+        }
+        else if ( eol - p >= 2 && p[0] == 'f' && Is_Blank(p[1]) )
+        {
+            // face
+            Ref tri[3];
+            int corners = 0;
+
+            for ( p = Skip_Blanks(p + 1, eol) ; p < eol ; p = Skip_Blanks(p, eol) )
+            {
+                Corner  c;
+                Ref     r;
+
+                // A corner is a whole token, as Count() took it, or there
+                // would be more triangles than it made room for.
+                if ( ! ( p = Parse_Corner(p, eol, c) ) || ( p < eol && ! Is_Blank(*p) )
+                  || ! Resolve(c.v, nv, r.v) )
+                    goto bad_line;
+                r.vt = r.vn = NONE;
+                if ( c.vt && ! Resolve(c.vt, nvt, r.vt) )
+                    goto bad_line;
+                if ( c.vn && ! Resolve(c.vn, nvn, r.vn) )
+                    goto bad_line;
+
+                if ( corners >= 3 )
+                    tri[1] = tri[2];    // next triangle of the fan
+                tri[corners < 3 ? corners : 2] = r;
+
+                if ( ++corners >= 3 )
+                    emit(tri);
+            }
+        }
+        // ignore rest
+
+        p = eol + 1;
+        continue;
+
+bad_line:
+        fprintf(stderr, "ObjLoader: %s:%d: malformed line\n", filename, line);
+        return false;
+    }// while
+
+    return true;
+}
+
+// Maps a (v, vt, vn) triple to the index of the vertex made for it. This is
+// an open addressing table sized once up front, so that de-duplicating a
+// mesh costs no allocations beyond the output itself.
+class Vertex_Table {
+  private:
+    struct Key {
+        uint32_t    v, vt, vn;
+    };
+
+    std::vector<uint32_t>   slots;  // vertex index + 1, 0 when empty
+    std::vector<Key>        keys;   // the key of each vertex
+    uint32_t                mask;
+
+    static uint32_t
+    Hash(const Key &k)
+    {
+        uint32_t h = k.v * 0x9E3779B1u ^ k.vt * 0x85EBCA77u ^ k.vn * 0xC2B2AE3Du;
+        return h ^ ( h >> 15 );
+    }
+
+  public:
+    explicit Vertex_Table(size_t max_vertices)
+    {
+        size_t size = 16;
+        while ( size < max_vertices * 2 )
+            size <<= 1;
+        slots.assign(size, 0);
+        keys.reserve(max_vertices);
+        mask = (uint32_t)( size - 1 );
+    }
+
+    // Looks the triple up, adding it if it is new. Returns the vertex index
+    // and sets created if this is the first time it was seen.
+    uint32_t
+    Find(uint32_t v, uint32_t vt, uint32_t vn, bool &created)
+    {
+        Key         k = { v, vt, vn };
+        uint32_t    i = Hash(k) & mask;
+
+        while ( slots[i] )
+        {
+            const Key &o = keys[slots[i] - 1];
+            if ( o.v == v && o.vt == vt && o.vn == vn )
+            {
+                created = false;
+                return slots[i] - 1;
+            }
+            i = ( i + 1 ) & mask;
+        }
+
+        keys.push_back(k);
+        slots[i] = (uint32_t)keys.size();
+        created = true;
+        return slots[i] - 1;
+    }
+};
+
+// Maps the file, sizes data from a counting pass and parses it.
+bool
+Load(const char *filename, MappedFile &file, Obj_Counts &counts, Obj_Data &data)
+{
+    if ( ! file.Open(filename) )
+    {
+        fprintf(stderr, "ObjLoader: Failed to open %s\n", filename);
+        return false;
+    }
+
+    counts = Count(file.Data(), file.Data() + file.Size());
+    data.vertices.resize(counts.v);
+    data.uvs     .resize(counts.vt);
+    data.normals .resize(counts.vn);
+    return true;
+}
+
+void
+Report(const char *filename, const MappedFile &file
+      , std::chrono::steady_clock::time_point start
+      , size_t triangles, size_t unique)
+{
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count();
+    double mb = file.Size() / (1024.0 * 1024.0);
+
+    fprintf(stderr, "ObjLoader: %s: %.2f MB, %zu triangles", filename, mb, triangles);
+    if ( unique )
+        fprintf(stderr, ", %zu unique vertices (%.2fx reuse)"
+               , unique, triangles * 3.0 / unique);
+    fprintf(stderr, " in %.2f ms (%.1f MB/s)\n"
+           , ms, ms > 0.0 ? mb * 1000.0 / ms : 0.0);
+}
+
+} // namespace
+
+
+bool
+ObjLoader(const char *filename
+         , std::vector<glm::vec3> &vertices
+         , std::vector<glm::vec2> &uvs
+         , std::vector<glm::vec3> &normals)
+{
+    auto        start = std::chrono::steady_clock::now();
+    MappedFile  file;
+    Obj_Counts  counts;
+    Obj_Data    data;
+
+    if ( ! Load(filename, file, counts, data) )
+        return false;
+
+    vertices.resize(counts.triangles * 3);
+    uvs     .resize(counts.triangles * 3);
+    normals .resize(counts.triangles * 3);
+    size_t out = 0;
+
+    // indexing
+    auto emit = [&] (const Ref *tri)
+    {
+        glm::vec3 flat(0.0f);
+        if ( tri[0].vn == NONE || tri[1].vn == NONE || tri[2].vn == NONE )
+            flat = Face_Normal(data, tri);
+
+        for ( int k = 0 ; k < 3 ; ++k, ++out )
+        {
+            vertices[out] = data.vertices[tri[k].v];
+            uvs     [out] = tri[k].vt != NONE ? data.uvs[tri[k].vt] : glm::vec2(0.0f);
+            normals [out] = tri[k].vn != NONE ? data.normals[tri[k].vn] : flat;
+        }
+    };
+
+    if ( ! Parse(filename, file.Data(), file.Data() + file.Size(), data, emit) )
+    {
+        vertices.clear();
+        uvs     .clear();
+        normals .clear();
+        return false;
+    }
+
+    Report(filename, file, start, out / 3, 0);
+
+    return true;
+}
+
+
+bool
+ObjLoader(const char *filename
+         , std::vector<Vertex> &vertices
+         , std::vector<unsigned int> &indices)
+{
+    auto        start = std::chrono::steady_clock::now();
+    MappedFile  file;
+    Obj_Counts  counts;
+    Obj_Data    data;
+
+    if ( ! Load(filename, file, counts, data) )
+        return false;
+
+    Vertex_Table table(counts.triangles * 3);
+    vertices.clear();
+    vertices.reserve(counts.triangles * 3);
+    indices.resize(counts.triangles * 3);
+    size_t  out = 0;
+    size_t  tri_num = 0;
+
+    // Corners without a normal take their triangle's flat normal, so they
+    // can only be shared within that triangle.
+    auto emit = [&] (const Ref *tri)
+    {
+        glm::vec3 flat(0.0f);
+        if ( tri[0].vn == NONE || tri[1].vn == NONE || tri[2].vn == NONE )
+            flat = Face_Normal(data, tri);
+
+        for ( int k = 0 ; k < 3 ; ++k, ++out )
+        {
+            uint32_t vt = tri[k].vt != NONE ? (uint32_t)tri[k].vt + 1 : 0;
+            uint32_t vn = tri[k].vn != NONE ? (uint32_t)tri[k].vn + 1
+                                            : ~(uint32_t)tri_num;
+            bool created;
+
+            indices[out] = table.Find((uint32_t)tri[k].v, vt, vn, created);
+            if ( created )
+            {
+                Vertex vertex;
+                vertex.pos    = data.vertices[tri[k].v];
+                vertex.uv     = vt ? data.uvs[tri[k].vt] : glm::vec2(0.0f);
+                vertex.normal = tri[k].vn != NONE ? data.normals[tri[k].vn] : flat;
+                vertices.push_back(vertex);
+            }
+        }
+        ++tri_num;
+    };
+
+    if ( ! Parse(filename, file.Data(), file.Data() + file.Size(), data, emit) )
+    {
+        vertices.clear();
+        indices .clear();
+        return false;
+    }
+
+    vertices.shrink_to_fit();
+    Report(filename, file, start, out / 3, vertices.size());
+
+    return true;
+}
@@ -0,0 +1,731 @@
+/*
+** tga_kernels.c -- row conversion kernels for libtarga.
+**
+** The scalar kernels are tga_convert_color unrolled for one input format
+** each. The SIMD kernels do the same arithmetic, in the same order and in
+** single precision, so they agree with it to the bit: the premultiply is
+** (c / 255) * (a / 255) * 255 truncated, and the 16-bit expansion is a
+** single multiply by the same odd constants, truncated.
+**
+** SIMD kernels work on 4 (SSSE3) or 8 (AVX2) pixels at a time and hand
+** the leftovers to the next narrower kernel. Loads and stores are full vectors,
+** so a vector loop only runs while a whole vector's worth of bytes is
+** left on both sides; nothing is read or written past the run.
+**
+** The match kernels compare a vector of pixels with the same vector one
+** pixel on, and squeeze the byte mask down to a bit per pixel.
+*/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "tga_kernels.h"
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+#define TGA_KERNELS_X86 1
+#include <immintrin.h>
+#if defined( _MSC_VER ) && !defined( __clang__ )
+#include <intrin.h>
+#endif
+#endif
+
+#if defined( TGA_KERNELS_X86 ) && defined( __GNUC__ )
+#define TGA_TARGET_SSSE3    __attribute__(( target( "ssse3" ) ))
+#define TGA_TARGET_AVX2     __attribute__(( target( "avx2" ) ))
+#else
+#define TGA_TARGET_SSSE3
+#define TGA_TARGET_AVX2
+#endif
+
+
+typedef unsigned char  ubyte;
+typedef unsigned int   uint32;
+
+
+static int TgaIsaLimit = TGA_ISA_COUNT - 1;
+
+
+
+/*************************************************************************************************/
+/* scalar */
+
+static void bgr24_rgb24_scalar( const ubyte * src, ubyte * dst, uint32 count ) {
+
+    uint32 i;
+
+    for( i = 0; i < count; i++, src += 3, dst += 3 ) {
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = src[0];
+    }
+
+}
+
+
+static void bgr24_rgba32_scalar( const ubyte * src, ubyte * dst, uint32 count ) {
+
+    uint32 i;
+
+    for( i = 0; i < count; i++, src += 3, dst += 4 ) {
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = src[0];
+        dst[3] = 0xFF;
+    }
+
+}
+
+
+/* premultiplies one channel, just as tga_convert_color does. */
+static ubyte premultiply( ubyte c, ubyte a ) {
+
+    return( (ubyte)(((float)c / 255.0f) * ((float)a / 255.0f) * 255.0f) );
+
+}
+
+
+static void bgra32_rgba32_scalar( const ubyte * src, ubyte * dst, uint32 count ) {
+
+    uint32 i;
+
+    for( i = 0; i < count; i++, src += 4, dst += 4 ) {
+        dst[0] = premultiply( src[2], src[3] );
+        dst[1] = premultiply( src[1], src[3] );
+        dst[2] = premultiply( src[0], src[3] );
+        dst[3] = src[3];
+    }
+
+}
+
+
+static void bgra32_rgb24_scalar( const ubyte * src, ubyte * dst, uint32 count ) {
+
+    uint32 i;
+
+    for( i = 0; i < count; i++, src += 4, dst += 3 ) {
+        dst[0] = premultiply( src[2], src[3] );
+        dst[1] = premultiply( src[1], src[3] );
+        dst[2] = premultiply( src[0], src[3] );
+    }
+
+}
+
+
+static void bgr565_rgb24_scalar( const ubyte * src, ubyte * dst, uint32 count ) {
+
+    uint32 i;
+    uint32 pixel;
+
+    for( i = 0; i < count; i++, src += 2, dst += 3 ) {
+        pixel = src[0] + (src[1] << 8);
+        dst[0] = (ubyte)(((float)((pixel & 0xF800) >> 11)) * 8.2258f);
+        dst[1] = (ubyte)(((float)((pixel & 0x07E0) >> 5 )) * 4.0476f);
+        dst[2] = (ubyte)(((float)(pixel & 0x001F)) * 8.2258f);
+    }
+
+}
+
+
+static void bgr555_rgb24_scalar( const ubyte * src, ubyte * dst, uint32 count ) {
+
+    uint32 i;
+    uint32 pixel;
+
+    for( i = 0; i < count; i++, src += 2, dst += 3 ) {
+        pixel = src[0] + (src[1] << 8);
+        dst[0] = (ubyte)(((float)((pixel & 0x7C00) >> 10)) * 8.2258f);
+        dst[1] = (ubyte)(((float)((pixel & 0x03E0) >> 5 )) * 8.2258f);
+        dst[2] = (ubyte)(((float)(pixel & 0x001F)) * 8.2258f);
+    }
+
+}
+
+
+/* marks the repeats from pixel first on. the words are already clear. */
+static void match_from( const ubyte * row, uint32 first, uint32 count, uint32 bytes, uint32 * same ) {
+
+    const ubyte * p = row + first * bytes;
+    uint32 i;
+
+    for( i = first; i + 1 < count; i++, p += bytes ) {
+        if( p[0] == p[bytes] && p[1] == p[bytes + 1] && p[2] == p[bytes + 2] &&
+            ( bytes == 3 || p[3] == p[7] ) ) {
+            same[i >> 5] |= 1u << (i & 31);
+        }
+    }
+
+}
+
+
+static void clear_matches( uint32 * same, uint32 count ) {
+
+    memset( same, 0, ((count + 31) / 32) * sizeof( uint32 ) );
+
+}
+
+
+static void match24_scalar( const ubyte * row, uint32 count, uint32 * same ) {
+
+    clear_matches( same, count );
+    match_from( row, 0, count, 3, same );
+
+}
+
+
+static void match32_scalar( const ubyte * row, uint32 count, uint32 * same ) {
+
+    clear_matches( same, count );
+    match_from( row, 0, count, 4, same );
+
+}
+
+
+
+#ifdef TGA_KERNELS_X86
+
+/* pshufb masks; -1 zeroes the byte. */
+
+// 4 BGR pixels to 4 RGB pixels, in the low 12 bytes.
+#define SHUF_BGR24_RGB24    2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, -1, -1, -1, -1
+// 4 BGR pixels to 4 RGB_ pixels; alpha is or'ed in afterwards.
+#define SHUF_BGR24_RGBA32   2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1
+// 4 RGBA pixels to 4 RGB pixels, in the low 12 bytes.
+#define SHUF_RGBA32_RGB24   0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1
+// one channel of 4 BGRA pixels, zero extended to 32 bits.
+#define SHUF_CHANNEL( c )   c, -1, -1, -1, c + 4, -1, -1, -1, c + 8, -1, -1, -1, c + 12, -1, -1, -1
+
+
+
+/*************************************************************************************************/
+/* SSSE3 */
+
+/* premultiplies 4 BGRA pixels, giving 4 RGBA pixels. */
+TGA_TARGET_SSSE3
+static __m128i premultiply_4( __m128i bgra ) {
+
+    const __m128 scale = _mm_set1_ps( 255.0f );
+
+    __m128 b = _mm_cvtepi32_ps( _mm_shuffle_epi8( bgra, _mm_setr_epi8( SHUF_CHANNEL( 0 ) ) ) );
+    __m128 g = _mm_cvtepi32_ps( _mm_shuffle_epi8( bgra, _mm_setr_epi8( SHUF_CHANNEL( 1 ) ) ) );
+    __m128 r = _mm_cvtepi32_ps( _mm_shuffle_epi8( bgra, _mm_setr_epi8( SHUF_CHANNEL( 2 ) ) ) );
+    __m128i a = _mm_shuffle_epi8( bgra, _mm_setr_epi8( SHUF_CHANNEL( 3 ) ) );
+    __m128 alpha = _mm_div_ps( _mm_cvtepi32_ps( a ), scale );
+
+    r = _mm_mul_ps( _mm_mul_ps( _mm_div_ps( r, scale ), alpha ), scale );
+    g = _mm_mul_ps( _mm_mul_ps( _mm_div_ps( g, scale ), alpha ), scale );
+    b = _mm_mul_ps( _mm_mul_ps( _mm_div_ps( b, scale ), alpha ), scale );
+
+    return( _mm_or_si128( _mm_or_si128( _mm_cvttps_epi32( r ),
+                                        _mm_slli_epi32( _mm_cvttps_epi32( g ), 8 ) ),
+                          _mm_or_si128( _mm_slli_epi32( _mm_cvttps_epi32( b ), 16 ),
+                                        _mm_slli_epi32( a, 24 ) ) ) );
+
+}
+
+
+/* expands 4 16-bit pixels, zero extended to 32 bits, to 4 RGB_ pixels. */
+TGA_TARGET_SSSE3
+static __m128i expand_16_4( __m128i pixel, int red_shift, uint32 green_mask, float green_scale ) {
+
+    const __m128 scale_5 = _mm_set1_ps( 8.2258f );
+
+    __m128i r = _mm_and_si128( _mm_srli_epi32( pixel, red_shift ), _mm_set1_epi32( 0x1F ) );
+    __m128i g = _mm_srli_epi32( _mm_and_si128( pixel, _mm_set1_epi32( (int)green_mask ) ), 5 );
+    __m128i b = _mm_and_si128( pixel, _mm_set1_epi32( 0x1F ) );
+
+    r = _mm_cvttps_epi32( _mm_mul_ps( _mm_cvtepi32_ps( r ), scale_5 ) );
+    g = _mm_cvttps_epi32( _mm_mul_ps( _mm_cvtepi32_ps( g ), _mm_set1_ps( green_scale ) ) );
+    b = _mm_cvttps_epi32( _mm_mul_ps( _mm_cvtepi32_ps( b ), scale_5 ) );
+
+    return( _mm_or_si128( r, _mm_or_si128( _mm_slli_epi32( g, 8 ), _mm_slli_epi32( b, 16 ) ) ) );
+
+}
+
+
+TGA_TARGET_SSSE3
+static void bgr24_rgb24_ssse3( const ubyte * src, ubyte * dst, uint32 count ) {
+
+    const __m128i shuf = _mm_setr_epi8( SHUF_BGR24_RGB24 );
+
+    // 4 pixels a time, but each load and store touches 16 bytes.
+    for( ; count >= 6; count -= 4, src += 12, dst += 12 ) {
+        __m128i v = _mm_loadu_si128( (const __m128i *)src );
+        _mm_storeu_si128( (__m128i *)dst, _mm_shuffle_epi8( v, shuf ) );
+    }
+    bgr24_rgb24_scalar( src, dst, count );
+
+}
+
+
+TGA_TARGET_SSSE3
+static void bgr24_rgba32_ssse3( const ubyte * src, ubyte * dst, uint32 count ) {
+
+    const __m128i shuf = _mm_setr_epi8( SHUF_BGR24_RGBA32 );
+    const __m128i alpha = _mm_set1_epi32( (int)0xFF000000 );
+
+    for( ; count >= 6; count -= 4, src += 12, dst += 16 ) {
+        __m128i v = _mm_loadu_si128( (const __m128i *)src );
+        _mm_storeu_si128( (__m128i *)dst, _mm_or_si128( _mm_shuffle_epi8( v, shuf ), alpha ) );
+    }
+    bgr24_rgba32_scalar( src, dst, count );
+
+}
+
+
+TGA_TARGET_SSSE3
+static void bgra32_rgba32_ssse3( const ubyte * src, ubyte * dst, uint32 count ) {
+
+    for( ; count >= 4; count -= 4, src += 16, dst += 16 ) {
+        __m128i v = _mm_loadu_si128( (const __m128i *)src );
+        _mm_storeu_si128( (__m128i *)dst, premultiply_4( v ) );
+    }
+    bgra32_rgba32_scalar( src, dst, count );
+
+}
+
+
+TGA_TARGET_SSSE3
+static void bgra32_rgb24_ssse3( const ubyte * src, ubyte * dst, uint32 count ) {
+
+    const __m128i shuf = _mm_setr_epi8( SHUF_RGBA32_RGB24 );
+
+    for( ; count >= 6; count -= 4, src += 16, dst += 12 ) {
+        __m128i v = _mm_loadu_si128( (const __m128i *)src );
+        _mm_storeu_si128( (__m128i *)dst, _mm_shuffle_epi8( premultiply_4( v ), shuf ) );
+    }
+    bgra32_rgb24_scalar( src, dst, count );
+
+}
+
+
+TGA_TARGET_SSSE3
+static void bgr565_rgb24_ssse3( const ubyte * src, ubyte * dst, uint32 count ) {
+
+    const __m128i shuf = _mm_setr_epi8( SHUF_RGBA32_RGB24 );
+
+    for( ; count >= 6; count -= 4, src += 8, dst += 12 ) {
+        __m128i v = _mm_unpacklo_epi16( _mm_loadl_epi64( (const __m128i *)src ), _mm_setzero_si128() );
+        _mm_storeu_si128( (__m128i *)dst, _mm_shuffle_epi8( expand_16_4( v, 11, 0x07E0, 4.0476f ), shuf ) );
+    }
+    bgr565_rgb24_scalar( src, dst, count );
+
+}
+
+
+TGA_TARGET_SSSE3
+static void bgr555_rgb24_ssse3( const ubyte * src, ubyte * dst, uint32 count ) {
+
+    const __m128i shuf = _mm_setr_epi8( SHUF_RGBA32_RGB24 );
+
+    for( ; count >= 6; count -= 4, src += 8, dst += 12 ) {
+        __m128i v = _mm_unpacklo_epi16( _mm_loadl_epi64( (const __m128i *)src ), _mm_setzero_si128() );
+        _mm_storeu_si128( (__m128i *)dst, _mm_shuffle_epi8( expand_16_4( v, 10, 0x03E0, 8.2258f ), shuf ) );
+    }
+    bgr555_rgb24_scalar( src, dst, count );
+
+}
+
+
+/* first has to be a multiple of 4, so a group of bits never straddles two words. */
+TGA_TARGET_SSSE3
+static void match24_from_ssse3( const ubyte * row, uint32 first, uint32 count, uint32 * same ) {
+
+    uint32 i, m;
+
+    // 4 pixels a time, against the 4 after them; each load is 16 bytes.
+    for( i = first; i + 7 <= count; i += 4 ) {
+        __m128i a = _mm_loadu_si128( (const __m128i *)(row + i * 3) );
+        __m128i b = _mm_loadu_si128( (const __m128i *)(row + i * 3 + 3) );
+        m = (uint32)_mm_movemask_epi8( _mm_cmpeq_epi8( a, b ) );
+        m &= (m >> 1) & (m >> 2);   // bit 3j: all of pixel j matched
+        same[i >> 5] |= ( (m & 1) | ((m >> 2) & 2) | ((m >> 4) & 4) | ((m >> 6) & 8) ) << (i & 31);
+    }
+    match_from( row, i, count, 3, same );
+
+}
+
+
+TGA_TARGET_SSSE3
+static void match32_from_ssse3( const ubyte * row, uint32 first, uint32 count, uint32 * same ) {
+
+    uint32 i, m;
+
+    for( i = first; i + 5 <= count; i += 4 ) {
+        __m128i a = _mm_loadu_si128( (const __m128i *)(row + i * 4) );
+        __m128i b = _mm_loadu_si128( (const __m128i *)(row + i * 4 + 4) );
+        m = (uint32)_mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32( a, b ) ) );
+        same[i >> 5] |= m << (i & 31);
+    }
+    match_from( row, i, count, 4, same );
+
+}
+
+
+TGA_TARGET_SSSE3
+static void match24_ssse3( const ubyte * row, uint32 count, uint32 * same ) {
+
+    clear_matches( same, count );
+    match24_from_ssse3( row, 0, count, same );
+
+}
+
+
+TGA_TARGET_SSSE3
+static void match32_ssse3( const ubyte * row, uint32 count, uint32 * same ) {
+
+    clear_matches( same, count );
+    match32_from_ssse3( row, 0, count, same );
+
+}
+
+
+
+/*************************************************************************************************/
+/* AVX2. pshufb works within each 128-bit lane, so 8 pixels are split
+   4 and 4 across the lanes, and packed pixels are gathered back with a
+   cross-lane permute. the leftovers go to the SSSE3 kernel, which isn't
+   VEX encoded; the upper halves are cleared first, or every SSE
+   instruction after pays for the switch. */
+
+// moves the 24 bytes of 8 packed pixels to the low 12 bytes of each lane.
+#define PERM_SPLIT_24       0, 1, 2, 3, 3, 4, 5, 6
+// and back again.
+#define PERM_JOIN_24        0, 1, 2, 4, 5, 6, 7, 7
+
+
+TGA_TARGET_AVX2
+static __m256i premultiply_8( __m256i bgra ) {
+
+    const __m256 scale = _mm256_set1_ps( 255.0f );
+
+    __m256 b = _mm256_cvtepi32_ps( _mm256_shuffle_epi8( bgra, _mm256_setr_epi8( SHUF_CHANNEL( 0 ), SHUF_CHANNEL( 0 ) ) ) );
+    __m256 g = _mm256_cvtepi32_ps( _mm256_shuffle_epi8( bgra, _mm256_setr_epi8( SHUF_CHANNEL( 1 ), SHUF_CHANNEL( 1 ) ) ) );
+    __m256 r = _mm256_cvtepi32_ps( _mm256_shuffle_epi8( bgra, _mm256_setr_epi8( SHUF_CHANNEL( 2 ), SHUF_CHANNEL( 2 ) ) ) );
+    __m256i a = _mm256_srli_epi32( bgra, 24 );
+    __m256 alpha = _mm256_div_ps( _mm256_cvtepi32_ps( a ), scale );
+
+    r = _mm256_mul_ps( _mm256_mul_ps( _mm256_div_ps( r, scale ), alpha ), scale );
+    g = _mm256_mul_ps( _mm256_mul_ps( _mm256_div_ps( g, scale ), alpha ), scale );
+    b = _mm256_mul_ps( _mm256_mul_ps( _mm256_div_ps( b, scale ), alpha ), scale );
+
+    return( _mm256_or_si256( _mm256_or_si256( _mm256_cvttps_epi32( r ),
+                                              _mm256_slli_epi32( _mm256_cvttps_epi32( g ), 8 ) ),
+                             _mm256_or_si256( _mm256_slli_epi32( _mm256_cvttps_epi32( b ), 16 ),
+                                              _mm256_slli_epi32( a, 24 ) ) ) );
+
+}
+
+
+TGA_TARGET_AVX2
+static __m256i expand_16_8( __m256i pixel, int red_shift, uint32 green_mask, float green_scale ) {
+
+    const __m256 scale_5 = _mm256_set1_ps( 8.2258f );
+
+    __m256i r = _mm256_and_si256( _mm256_srli_epi32( pixel, red_shift ), _mm256_set1_epi32( 0x1F ) );
+    __m256i g = _mm256_srli_epi32( _mm256_and_si256( pixel, _mm256_set1_epi32( (int)green_mask ) ), 5 );
+    __m256i b = _mm256_and_si256( pixel, _mm256_set1_epi32( 0x1F ) );
+
+    r = _mm256_cvttps_epi32( _mm256_mul_ps( _mm256_cvtepi32_ps( r ), scale_5 ) );
+    g = _mm256_cvttps_epi32( _mm256_mul_ps( _mm256_cvtepi32_ps( g ), _mm256_set1_ps( green_scale ) ) );
+    b = _mm256_cvttps_epi32( _mm256_mul_ps( _mm256_cvtepi32_ps( b ), scale_5 ) );
+
+    return( _mm256_or_si256( r, _mm256_or_si256( _mm256_slli_epi32( g, 8 ), _mm256_slli_epi32( b, 16 ) ) ) );
+
+}
+
+
+/* packs 8 RGBA pixels down to 24 bytes of RGB, at the bottom. */
+TGA_TARGET_AVX2
+static __m256i pack_rgb24_8( __m256i rgba ) {
+
+    const __m256i shuf = _mm256_setr_epi8( SHUF_RGBA32_RGB24, SHUF_RGBA32_RGB24 );
+
+    return( _mm256_permutevar8x32_epi32( _mm256_shuffle_epi8( rgba, shuf ),
+                                         _mm256_setr_epi32( PERM_JOIN_24 ) ) );
+
+}
+
+
+TGA_TARGET_AVX2
+static void bgr24_rgb24_avx2( const ubyte * src, ubyte * dst, uint32 count ) {
+
+    const __m256i split = _mm256_setr_epi32( PERM_SPLIT_24 );
+    const __m256i join = _mm256_setr_epi32( PERM_JOIN_24 );
+    const __m256i shuf = _mm256_setr_epi8( SHUF_BGR24_RGB24, SHUF_BGR24_RGB24 );
+
+    // 8 pixels a time, but each load and store touches 32 bytes.
+    for( ; count >= 11; count -= 8, src += 24, dst += 24 ) {
+        __m256i v = _mm256_permutevar8x32_epi32( _mm256_loadu_si256( (const __m256i *)src ), split );
+        v = _mm256_permutevar8x32_epi32( _mm256_shuffle_epi8( v, shuf ), join );
+        _mm256_storeu_si256( (__m256i *)dst, v );
+    }
+    _mm256_zeroupper();
+    bgr24_rgb24_ssse3( src, dst, count );
+
+}
+
+
+TGA_TARGET_AVX2
+static void bgr24_rgba32_avx2( const ubyte * src, ubyte * dst, uint32 count ) {
+
+    const __m256i split = _mm256_setr_epi32( PERM_SPLIT_24 );
+    const __m256i shuf = _mm256_setr_epi8( SHUF_BGR24_RGBA32, SHUF_BGR24_RGBA32 );
+    const __m256i alpha = _mm256_set1_epi32( (int)0xFF000000 );
+
+    for( ; count >= 11; count -= 8, src += 24, dst += 32 ) {
+        __m256i v = _mm256_permutevar8x32_epi32( _mm256_loadu_si256( (const __m256i *)src ), split );
+        _mm256_storeu_si256( (__m256i *)dst, _mm256_or_si256( _mm256_shuffle_epi8( v, shuf ), alpha ) );
+    }
+    _mm256_zeroupper();
+    bgr24_rgba32_ssse3( src, dst, count );
+
+}
+
+
+TGA_TARGET_AVX2
+static void bgra32_rgba32_avx2( const ubyte * src, ubyte * dst, uint32 count ) {
+
+    for( ; count >= 8; count -= 8, src += 32, dst += 32 ) {
+        __m256i v = _mm256_loadu_si256( (const __m256i *)src );
+        _mm256_storeu_si256( (__m256i *)dst, premultiply_8( v ) );
+    }
+    _mm256_zeroupper();
+    bgra32_rgba32_ssse3( src, dst, count );
+
+}
+
+
+TGA_TARGET_AVX2
+static void bgra32_rgb24_avx2( const ubyte * src, ubyte * dst, uint32 count ) {
+
+    for( ; count >= 11; count -= 8, src += 32, dst += 24 ) {
+        __m256i v = _mm256_loadu_si256( (const __m256i *)src );
+        _mm256_storeu_si256( (__m256i *)dst, pack_rgb24_8( premultiply_8( v ) ) );
+    }
+    _mm256_zeroupper();
+    bgra32_rgb24_ssse3( src, dst, count );
+
+}
+
+
+TGA_TARGET_AVX2
+static void bgr565_rgb24_avx2( const ubyte * src, ubyte * dst, uint32 count ) {
+
+    for( ; count >= 11; count -= 8, src += 16, dst += 24 ) {
+        __m256i v = _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i *)src ) );
+        _mm256_storeu_si256( (__m256i *)dst, pack_rgb24_8( expand_16_8( v, 11, 0x07E0, 4.0476f ) ) );
+    }
+    _mm256_zeroupper();
+    bgr565_rgb24_ssse3( src, dst, count );
+
+}
+
+
+TGA_TARGET_AVX2
+static void bgr555_rgb24_avx2( const ubyte * src, ubyte * dst, uint32 count ) {
+
+    for( ; count >= 11; count -= 8, src += 16, dst += 24 ) {
+        __m256i v = _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i *)src ) );
+        _mm256_storeu_si256( (__m256i *)dst, pack_rgb24_8( expand_16_8( v, 10, 0x03E0, 8.2258f ) ) );
+    }
+    _mm256_zeroupper();
+    bgr555_rgb24_ssse3( src, dst, count );
+
+}
+
+
+TGA_TARGET_AVX2
+static void match24_avx2( const ubyte * row, uint32 count, uint32 * same ) {
+
+    uint32 i, j, m, bits;
+
+    clear_matches( same, count );
+
+    // 8 pixels a time; cmpeq and movemask don't care about lanes.
+    for( i = 0; i + 12 <= count; i += 8 ) {
+        __m256i a = _mm256_loadu_si256( (const __m256i *)(row + i * 3) );
+        __m256i b = _mm256_loadu_si256( (const __m256i *)(row + i * 3 + 3) );
+        m = (uint32)_mm256_movemask_epi8( _mm256_cmpeq_epi8( a, b ) );
+        m &= (m >> 1) & (m >> 2);
+        for( bits = 0, j = 0; j < 8; j++ ) {
+            bits |= ((m >> (j * 3)) & 1) << j;
+        }
+        same[i >> 5] |= bits << (i & 31);
+    }
+    _mm256_zeroupper();
+    match24_from_ssse3( row, i, count, same );
+
+}
+
+
+TGA_TARGET_AVX2
+static void match32_avx2( const ubyte * row, uint32 count, uint32 * same ) {
+
+    uint32 i, m;
+
+    clear_matches( same, count );
+
+    for( i = 0; i + 9 <= count; i += 8 ) {
+        __m256i a = _mm256_loadu_si256( (const __m256i *)(row + i * 4) );
+        __m256i b = _mm256_loadu_si256( (const __m256i *)(row + i * 4 + 4) );
+        m = (uint32)_mm256_movemask_ps( _mm256_castsi256_ps( _mm256_cmpeq_epi32( a, b ) ) );
+        same[i >> 5] |= m << (i & 31);
+    }
+    _mm256_zeroupper();
+    match32_from_ssse3( row, i, count, same );
+
+}
+
+#endif /* TGA_KERNELS_X86 */
+
+
+
+/*************************************************************************************************/
+
+static const tga_row_kernel TgaKernels[TGA_ISA_COUNT][TGA_KERNEL_COUNT] = {
+    {
+        bgr24_rgb24_scalar,
+        bgr24_rgba32_scalar,
+        bgra32_rgba32_scalar,
+        bgra32_rgb24_scalar,
+        bgr565_rgb24_scalar,
+        bgr555_rgb24_scalar,
+    },
+#ifdef TGA_KERNELS_X86
+    {
+        bgr24_rgb24_ssse3,
+        bgr24_rgba32_ssse3,
+        bgra32_rgba32_ssse3,
+        bgra32_rgb24_ssse3,
+        bgr565_rgb24_ssse3,
+        bgr555_rgb24_ssse3,
+    },
+    {
+        bgr24_rgb24_avx2,
+        bgr24_rgba32_avx2,
+        bgra32_rgba32_avx2,
+        bgra32_rgb24_avx2,
+        bgr565_rgb24_avx2,
+        bgr555_rgb24_avx2,
+    },
+#endif
+};
+
+
+/* by instruction set, then 3 or 4 byte pixels */
+static const tga_match_kernel TgaMatchKernels[TGA_ISA_COUNT][2] = {
+    { match24_scalar, match32_scalar },
+#ifdef TGA_KERNELS_X86
+    { match24_ssse3,  match32_ssse3 },
+    { match24_avx2,   match32_avx2 },
+#endif
+};
+
+
+/* what the CPU (and OS) can actually run. */
+static int tga_cpu_isa( void ) {
+
+#if defined( TGA_KERNELS_X86 ) && defined( __GNUC__ )
+    if( __builtin_cpu_supports( "avx2" ) ) {
+        return( TGA_ISA_AVX2 );
+    }
+    if( __builtin_cpu_supports( "ssse3" ) ) {
+        return( TGA_ISA_SSSE3 );
+    }
+#elif defined( TGA_KERNELS_X86 ) && defined( _MSC_VER )
+    int info[4];
+
+    __cpuid( info, 0 );
+    if( info[0] >= 7 ) {
+        __cpuid( info, 1 );
+        // AVX needs the OS to save the ymm registers too.
+        if( (info[2] & (1 << 27)) && (info[2] & (1 << 28)) &&
+            (_xgetbv( 0 ) & 0x6) == 0x6 ) {
+            __cpuidex( info, 7, 0 );
+            if( info[1] & (1 << 5) ) {
+                return( TGA_ISA_AVX2 );
+            }
+        }
+    }
+    __cpuid( info, 1 );
+    if( info[2] & (1 << 9) ) {
+        return( TGA_ISA_SSSE3 );
+    }
+#endif
+
+    return( TGA_ISA_SCALAR );
+
+}
+
+
+int tga_kernel_isa( void ) {
+
+    int isa = tga_cpu_isa();
+
+    return( isa < TgaIsaLimit ? isa : TgaIsaLimit );
+
+}
+
+
+void tga_limit_kernel_isa( int isa ) {
+
+    if( isa < TGA_ISA_SCALAR ) {
+        isa = TGA_ISA_SCALAR;
+    }
+    if( isa >= TGA_ISA_COUNT ) {
+        isa = TGA_ISA_COUNT - 1;
+    }
+    TgaIsaLimit = isa;
+
+}
+
+
+tga_row_kernel tga_get_kernel( int kernel, int isa ) {
+
+    if( kernel < 0 || kernel >= TGA_KERNEL_COUNT || isa < 0 || isa >= TGA_ISA_COUNT ) {
+        return( NULL );
+    }
+#ifndef TGA_KERNELS_X86
+    if( isa != TGA_ISA_SCALAR ) {
+        return( NULL );
+    }
+#endif
+    return( TgaKernels[isa][kernel] );
+
+}
+
+
+tga_match_kernel tga_get_match_kernel( unsigned int bytes_per_pix, int isa ) {
+
+    if( (bytes_per_pix != 3 && bytes_per_pix != 4) || isa < 0 || isa >= TGA_ISA_COUNT ) {
+        return( NULL );
+    }
+#ifndef TGA_KERNELS_X86
+    if( isa != TGA_ISA_SCALAR ) {
+        return( NULL );
+    }
+#endif
+    return( TgaMatchKernels[isa][bytes_per_pix - 3] );
+
+}
+
+
+const char * tga_isa_name( int isa ) {
+
+    switch( isa ) {
+
+    case TGA_ISA_SCALAR:
+        return( "scalar" );
+
+    case TGA_ISA_SSSE3:
+        return( "ssse3" );
+
+    case TGA_ISA_AVX2:
+        return( "avx2" );
+
+    default:
+        return( "unknown" );
+
+    }
+
+}
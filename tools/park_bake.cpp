@@ -0,0 +1,175 @@
+/*
+ * park_bake.cpp: Bakes every asset the program loads at build time. OBJ
+ * models become .pmesh files and TGA textures become .ptex files, all in
+ * one asset directory, so the program never parses a source format.
+ *
+ * Assets whose baked file is already up to date are skipped, and the rest
+ * are baked in parallel. A compressed texture also gets a plain RGB copy,
+ * which drivers without S3TC read instead.
+ *
+ * Usage: park_bake [-j threads] [-c none|bc1|bc3] [-f] asset_dir asset...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <string>
+#include <vector>
+#include "CompiledMesh.h"
+#include "CompiledTexture.h"
+#include "ThreadPool.h"
+
+enum Bake_Result { BAKED, UP_TO_DATE, FAILED };
+
+static bool
+Has_Extension(const char *filename, const char *extension)
+{
+    size_t  n = strlen(filename), m = strlen(extension);
+    return n > m && strcmp(filename + n - m, extension) == 0;
+}
+
+static Bake_Result
+Bake_Mesh(const char *obj_filename, const std::string &pmesh_filename, bool force)
+{
+    CompiledMesh    baked;
+
+    if ( ! force && baked.Open(pmesh_filename.c_str()) && baked.Matches(obj_filename) )
+        return UP_TO_DATE;
+    baked.Close();
+
+    return CompiledMesh::Compile(obj_filename, pmesh_filename.c_str()) ? BAKED : FAILED;
+}
+
+static Bake_Result
+Bake_Texture(const char *tga_filename, const std::string &ptex_filename, PTexFormat format
+            , bool force)
+{
+    CompiledTexture baked;
+
+    if ( ! force && baked.Open(ptex_filename.c_str()) && baked.Format() == format
+      && baked.Matches(tga_filename) )
+        return UP_TO_DATE;
+    baked.Close();
+
+    return CompiledTexture::Compile(tga_filename, format, ptex_filename.c_str()) ? BAKED : FAILED;
+}
+
+// The plain copy goes first, so a program watching the compressed one
+// finds it up to date when that changes.
+static Bake_Result
+Bake_Texture_And_Copy(const char *tga_filename, const char *asset_dir, PTexFormat format
+                     , bool force)
+{
+    Bake_Result plain = UP_TO_DATE;
+
+    if ( format != PTEX_RGB8 )
+        plain = Bake_Texture(tga_filename, CompiledTexture::Plain_Name(tga_filename, asset_dir)
+                            , PTEX_RGB8, force);
+    if ( plain == FAILED )
+        return FAILED;
+
+    Bake_Result baked = Bake_Texture(tga_filename
+                                    , CompiledTexture::Cache_Name(tga_filename, asset_dir)
+                                    , format, force);
+    return baked == UP_TO_DATE ? plain : baked;
+}
+
+static int
+Usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [-j threads] [-c none|bc1|bc3] [-f] asset_dir asset...\n", program);
+    return 2;
+}
+
+int
+main(int argc, char *argv[])
+{
+    unsigned int    threads = 0;
+    PTexFormat      format = PTEX_BC1;
+    bool            force = false;
+    int             arg = 1;
+
+    for ( ; arg < argc && argv[arg][0] == '-' ; arg++ )
+    {
+        if ( strcmp(argv[arg], "-f") == 0 )
+            force = true;
+        else if ( strcmp(argv[arg], "-j") == 0 && arg + 1 < argc )
+            threads = (unsigned int)atoi(argv[++arg]);
+        else if ( strcmp(argv[arg], "-c") == 0 && arg + 1 < argc )
+        {
+            const char *name = argv[++arg];
+
+            if ( strcmp(name, "none") == 0 )
+                format = PTEX_RGB8;
+            else if ( strcmp(name, "bc1") == 0 )
+                format = PTEX_BC1;
+            else if ( strcmp(name, "bc3") == 0 )
+                format = PTEX_BC3;
+            else
+                return Usage(argv[0]);
+        }
+        else
+            return Usage(argv[0]);
+    }
+    if ( argc - arg < 2 )
+        return Usage(argv[0]);
+
+    const char  *asset_dir = argv[arg++];
+    struct stat st;
+
+    if ( stat(asset_dir, &st) != 0 || ! S_ISDIR(st.st_mode) )
+    {
+        fprintf(stderr, "%s: %s is not a directory\n", argv[0], asset_dir);
+        return 1;
+    }
+
+    auto    start = std::chrono::steady_clock::now();
+
+    std::vector<std::future<Bake_Result>>   bakes;
+    {
+        ThreadPool  pool(threads);
+
+        for ( int i = arg ; i < argc ; i++ )
+        {
+            const char  *source = argv[i];
+
+            if ( Has_Extension(source, ".obj") )
+            {
+                std::string baked = CompiledMesh::Cache_Name(source, asset_dir);
+                bakes.push_back(pool.Submit([=] { return Bake_Mesh(source, baked, force); }));
+            }
+            else if ( Has_Extension(source, ".tga") )
+            {
+                bakes.push_back(pool.Submit([=] { return Bake_Texture_And_Copy(source, asset_dir, format
+                                                                              , force); }));
+            }
+            else
+            {
+                fprintf(stderr, "%s: Don't know how to bake %s\n", argv[0], source);
+                bakes.push_back(std::async(std::launch::deferred, [] { return FAILED; }));
+            }
+        }
+    }
+
+    int counts[3] = { 0, 0, 0 };
+    for ( auto &bake : bakes )
+    {
+        try {
+            counts[bake.get()]++;
+        }
+        catch ( ... ) {
+            counts[FAILED]++;
+        }
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count();
+    printf("park_bake: %d baked, %d up to date, %d failed in %.2f ms\n"
+          , counts[BAKED], counts[UP_TO_DATE], counts[FAILED], ms);
+
+    return counts[FAILED] ? 1 : 0;
+}
@@ -0,0 +1,418 @@
+/*
+ * tga_bench.cpp: Times tga_load and tga_write_rle against the original
+ * decoder and encoder they replaced, and checks that they still agree to
+ * the byte.
+ *
+ * Usage: tga_bench [-n runs] image.tga ...
+ *
+ * First the row kernels are checked: every SIMD kernel against the scalar
+ * one on random pixels, and every kernel's format through tga_load against
+ * the original decoder on generated images. The RLE encoder is checked on
+ * generated images full of runs: what it writes has to decode to the same
+ * pixels as an uncompressed file does, by either decoder.
+ *
+ * Then each image is decoded to both 24 and 32 bits, by the original
+ * decoder and by tga_load limited to each instruction set this machine
+ * has, and those pixels are written back out as RLE by both encoders. The
+ * best of the runs is reported, in milliseconds per megapixel to decode
+ * and megabytes of pixels per second to encode, so images of different
+ * sizes compare. Exits with 1 if anything decodes differently.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "libtarga.h"
+#include "tga_kernels.h"
+#include "tga_reference.h"
+
+typedef void *(*Decoder)(const char*, int*, int*, unsigned int);
+typedef int (*Encoder)(const char*, int, int, unsigned char*, unsigned int);
+
+// What each kernel converts, for the checks.
+static const struct {
+    const char      *name;
+    int             bytes_in;
+    int             bytes_out;
+    unsigned char   depth;          // to write a test image of this format
+    unsigned char   descriptor;
+    unsigned int    format;
+} KERNELS[TGA_KERNEL_COUNT] = {
+    { "bgr24>rgb24",   3, 3, 24, 0x00, TGA_TRUECOLOR_24 },
+    { "bgr24>rgba32",  3, 4, 24, 0x00, TGA_TRUECOLOR_32 },
+    { "bgra32>rgba32", 4, 4, 32, 0x08, TGA_TRUECOLOR_32 },
+    { "bgra32>rgb24",  4, 3, 32, 0x08, TGA_TRUECOLOR_24 },
+    { "bgr565>rgb24",  2, 3, 16, 0x00, TGA_TRUECOLOR_24 },
+    { "bgr555>rgb24",  2, 3, 16, 0x01, TGA_TRUECOLOR_24 },
+};
+
+static const char *CHECK_FILE = "tga_bench_check.tga";
+static const char *RAW_FILE = "tga_bench_raw.tga";
+
+// Decodes the file runs times and returns the fastest, in milliseconds.
+// The last result is left in image, which the caller frees.
+static double
+Time_Decoder(Decoder decode, const char *filename, unsigned int format, int runs
+            , void **image, int *width, int *height)
+{
+    double best = 0.0;
+
+    *image = nullptr;
+    for ( int i = 0 ; i < runs ; i++ )
+    {
+        free(*image);
+
+        auto start = std::chrono::steady_clock::now();
+        *image = decode(filename, width, height, format);
+        double ms = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start).count();
+
+        if ( ! *image )
+            return -1.0;
+        if ( i == 0 || ms < best )
+            best = ms;
+    }
+    return best;
+}
+
+// Encodes the pixels runs times and returns the fastest, in milliseconds.
+static double
+Time_Encoder(Encoder encode, const char *filename, unsigned char *image
+            , int width, int height, unsigned int format, int runs)
+{
+    double best = 0.0;
+
+    for ( int i = 0 ; i < runs ; i++ )
+    {
+        auto start = std::chrono::steady_clock::now();
+        int ok = encode(filename, width, height, image, format);
+        double ms = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start).count();
+
+        if ( ! ok )
+            return -1.0;
+        if ( i == 0 || ms < best )
+            best = ms;
+    }
+    return best;
+}
+
+// Decodes a file with both decoders and compares the results.
+static bool
+Same_Decode(const char *filename, unsigned int format)
+{
+    int     ref_w = 0, ref_h = 0, w = 0, h = 0;
+    void    *ref = tga_load_reference(filename, &ref_w, &ref_h, format);
+    void    *image = tga_load(filename, &w, &h, format);
+
+    bool same = ref && image && ref_w == w && ref_h == h
+             && memcmp(ref, image, (size_t)w * h * format) == 0;
+
+    free(ref);
+    free(image);
+    return same;
+}
+
+// Checks every kernel on every instruction set this machine has.
+static bool
+Check_Kernels(int best_isa)
+{
+    bool                ok = true;
+    unsigned long long  seed = 1;
+
+    for ( int k = 0 ; k < TGA_KERNEL_COUNT ; k++ )
+    {
+        tga_row_kernel scalar = tga_get_kernel(k, TGA_ISA_SCALAR);
+
+        // SIMD against scalar, on every length around the vector widths,
+        // checking nothing is written past the end either.
+        for ( int isa = TGA_ISA_SCALAR + 1 ; isa <= best_isa ; isa++ )
+        {
+            tga_row_kernel kernel = tga_get_kernel(k, isa);
+
+            for ( unsigned int i = 0 ; i <= 100 ; i++ )
+            {
+                unsigned int n = i < 100 ? i : 4099;
+                std::vector<unsigned char> src(n * KERNELS[k].bytes_in + 1);
+                std::vector<unsigned char> want(n * KERNELS[k].bytes_out + 32, 0xCD);
+                std::vector<unsigned char> got(want.size(), 0xCD);
+
+                for ( auto &value : src )
+                    value = (unsigned char)( ( seed = seed * 6364136223846793005ull + 1 ) >> 56 );
+
+                // an odd offset, so nothing happens to be aligned
+                scalar(src.data() + 1, want.data(), n);
+                kernel(src.data() + 1, got.data(), n);
+                if ( want != got )
+                {
+                    printf("kernel %s on %s differs from scalar for %u pixels\n"
+                          , KERNELS[k].name, tga_isa_name(isa), n);
+                    ok = false;
+                    break;
+                }
+            }
+        }
+
+        // The whole path through tga_load against the original decoder.
+        // Pixel p holds p as a 16-bit value, or p % 256 in each colour
+        // channel with the row as alpha: every 16-bit value appears, and
+        // every alpha with every channel value.
+        const int   width = 256, height = 257;
+        const int   bytes = KERNELS[k].bytes_in;
+        std::vector<unsigned char> file(18 + width * height * bytes);
+
+        file[2] = 2;    // uncompressed truecolor
+        file[12] = width & 0xFF;
+        file[13] = width >> 8;
+        file[14] = height & 0xFF;
+        file[15] = height >> 8;
+        file[16] = KERNELS[k].depth;
+        file[17] = KERNELS[k].descriptor;
+        for ( int p = 0 ; p < width * height ; p++ )
+        {
+            unsigned char *pixel = &file[18 + p * bytes];
+
+            if ( bytes == 2 )
+            {
+                pixel[0] = (unsigned char)p;
+                pixel[1] = (unsigned char)( p >> 8 );
+            }
+            else
+            {
+                pixel[0] = pixel[1] = pixel[2] = (unsigned char)p;
+                if ( bytes == 4 )
+                    pixel[3] = (unsigned char)( p / width );
+            }
+        }
+
+        FILE *out = fopen(CHECK_FILE, "wb");
+        if ( ! out || fwrite(file.data(), 1, file.size(), out) != file.size() )
+        {
+            fprintf(stderr, "Couldn't write %s\n", CHECK_FILE);
+            if ( out )
+                fclose(out);
+            return false;
+        }
+        fclose(out);
+
+        for ( int isa = TGA_ISA_SCALAR ; isa <= best_isa ; isa++ )
+        {
+            tga_limit_kernel_isa(isa);
+            if ( ! Same_Decode(CHECK_FILE, KERNELS[k].format) )
+            {
+                printf("kernel %s on %s differs from the original decoder\n"
+                      , KERNELS[k].name, tga_isa_name(isa));
+                ok = false;
+            }
+        }
+        tga_limit_kernel_isa(TGA_ISA_COUNT - 1);
+    }
+
+    remove(CHECK_FILE);
+    return ok;
+}
+
+// Checks that RLE files decode to what was written, on every instruction
+// set this machine has.
+static bool
+Check_Encoder(int best_isa)
+{
+    bool                ok = true;
+    unsigned long long  seed = 1;
+    auto random = [&seed]() {
+        return (unsigned int)( ( seed = seed * 6364136223846793005ull + 1 ) >> 33 );
+    };
+
+    for ( int i = 0 ; i < 200 && ok ; i++ )
+    {
+        // Single pixels, short runs, and runs longer than a packet or a
+        // row, with 1 pixel wide images thrown in.
+        unsigned int    format = i % 2 ? TGA_TRUECOLOR_32 : TGA_TRUECOLOR_24;
+        int             width = i % 10 < 2 ? 1 : 1 + random() % 300;
+        int             height = 1 + random() % 16;
+        unsigned int    longest = i % 4 == 0 ? 1 : i % 4 == 1 ? 3 : i % 4 == 2 ? 40 : 400;
+        std::vector<unsigned char> image((size_t)width * height * format);
+
+        for ( size_t p = 0 ; p < image.size() ; )
+        {
+            unsigned int    run = 1 + random() % longest;
+            unsigned char   pixel[4];
+
+            for ( auto &value : pixel )
+                value = (unsigned char)random();
+            if ( format == TGA_TRUECOLOR_32 )
+            {
+                // opaque, clear and in between, premultiplied as tga_load
+                // would give them
+                pixel[3] = i % 3 == 0 ? 0xFF : i % 3 == 1 ? 0 : pixel[3];
+                for ( int c = 0 ; c < 3 ; c++ )
+                    pixel[c] = (unsigned char)( pixel[c] * pixel[3] / 255 );
+            }
+            for ( ; run > 0 && p < image.size() ; run--, p += format )
+                memcpy(&image[p], pixel, format);
+        }
+
+        for ( int isa = TGA_ISA_SCALAR ; isa <= best_isa ; isa++ )
+        {
+            int     rle_w = 0, rle_h = 0, raw_w = 0, raw_h = 0;
+
+            tga_limit_kernel_isa(isa);
+            tga_write_rle(CHECK_FILE, width, height, image.data(), format);
+            tga_write_raw(RAW_FILE, width, height, image.data(), format);
+
+            void    *rle = tga_load(CHECK_FILE, &rle_w, &rle_h, format);
+            void    *raw = tga_load(RAW_FILE, &raw_w, &raw_h, format);
+
+            // 24-bit pixels come back exactly; 32-bit ones go through
+            // un-premultiplying and premultiplying again either way.
+            bool same = rle && raw && rle_w == width && rle_h == height
+                     && raw_w == width && raw_h == height
+                     && memcmp(rle, raw, image.size()) == 0
+                     && ( format == TGA_TRUECOLOR_32
+                       || memcmp(rle, image.data(), image.size()) == 0 );
+            free(rle);
+            free(raw);
+
+            if ( ! same || ! Same_Decode(CHECK_FILE, format) )
+            {
+                printf("RLE encoder on %s wrote a %dx%d %u-bit image wrong\n"
+                      , tga_isa_name(isa), width, height, format * 8);
+                ok = false;
+            }
+        }
+        tga_limit_kernel_isa(TGA_ISA_COUNT - 1);
+    }
+
+    remove(CHECK_FILE);
+    remove(RAW_FILE);
+    return ok;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int runs = 10;
+    int first = 1;
+
+    if ( argc > 2 && strcmp(argv[1], "-n") == 0 )
+    {
+        runs = atoi(argv[2]);
+        first = 3;
+    }
+    if ( first >= argc || runs < 1 )
+    {
+        fprintf(stderr, "Usage: %s [-n runs] image.tga ...\n", argv[0]);
+        return 2;
+    }
+
+    int     best_isa = tga_kernel_isa();
+    bool    kernels_ok = Check_Kernels(best_isa);
+    bool    encoder_ok = Check_Encoder(best_isa);
+    bool    all_match = kernels_ok && encoder_ok;
+
+    printf("kernels on scalar");
+    for ( int isa = TGA_ISA_SCALAR + 1 ; isa <= best_isa ; isa++ )
+        printf(", %s", tga_isa_name(isa));
+    printf(": %s\n", kernels_ok ? "ok" : "FAILED");
+    printf("RLE encoder: %s\n\n", encoder_ok ? "ok" : "FAILED");
+
+    printf("%-24s %-10s %4s %12s", "image", "size", "bits", "before");
+    for ( int isa = TGA_ISA_SCALAR ; isa <= best_isa ; isa++ )
+        printf(" %10s", tga_isa_name(isa));
+    printf("   (ms/MP)\n");
+
+    for ( int i = first ; i < argc ; i++ )
+    {
+        static const unsigned int formats[] = { TGA_TRUECOLOR_24, TGA_TRUECOLOR_32 };
+        const char  *name = strrchr(argv[i], '/') ? strrchr(argv[i], '/') + 1 : argv[i];
+
+        for ( unsigned int format : formats )
+        {
+            void    *before_image;
+            int     before_w = 0, before_h = 0;
+
+            double before = Time_Decoder(tga_load_reference, argv[i], format, runs
+                                        , &before_image, &before_w, &before_h);
+            if ( before < 0.0 )
+            {
+                fprintf(stderr, "%s: Couldn't load %s: %s\n", argv[0], argv[i]
+                       , tga_error_string(tga_get_last_error()));
+                all_match = false;
+                break;
+            }
+
+            double  mp = before_w * (double)before_h / 1.0e6;
+            char    size[16];
+            snprintf(size, sizeof(size), "%dx%d", before_w, before_h);
+            printf("%-24s %-10s %4u %12.2f", name, size, format * 8, before / mp);
+
+            for ( int isa = TGA_ISA_SCALAR ; isa <= best_isa ; isa++ )
+            {
+                void    *after_image;
+                int     after_w = 0, after_h = 0;
+
+                tga_limit_kernel_isa(isa);
+                double after = Time_Decoder(tga_load, argv[i], format, runs
+                                           , &after_image, &after_w, &after_h);
+
+                bool match = after >= 0.0 && before_w == after_w && before_h == after_h
+                          && memcmp(before_image, after_image
+                                   , (size_t)after_w * after_h * format) == 0;
+                all_match = all_match && match;
+
+                printf(" %10.2f%s", after / mp, match ? "" : "!");
+                free(after_image);
+            }
+            tga_limit_kernel_isa(TGA_ISA_COUNT - 1);
+            printf("\n");
+
+            free(before_image);
+        }
+    }
+
+    printf("\n%-24s %-10s %4s %12s", "image", "size", "bits", "before");
+    for ( int isa = TGA_ISA_SCALAR ; isa <= best_isa ; isa++ )
+        printf(" %10s", tga_isa_name(isa));
+    printf("   (RLE encode, MB/s)\n");
+
+    for ( int i = first ; i < argc ; i++ )
+    {
+        static const unsigned int formats[] = { TGA_TRUECOLOR_24, TGA_TRUECOLOR_32 };
+        const char  *name = strrchr(argv[i], '/') ? strrchr(argv[i], '/') + 1 : argv[i];
+
+        for ( unsigned int format : formats )
+        {
+            int             w = 0, h = 0;
+            unsigned char   *image = (unsigned char*)tga_load(argv[i], &w, &h, format);
+
+            if ( ! image )
+                break;  // already reported above
+
+            double  mb = (double)w * h * format / 1.0e6;
+            double  before = Time_Encoder(tga_write_rle_reference, CHECK_FILE, image
+                                         , w, h, format, runs);
+            char    size[16];
+            snprintf(size, sizeof(size), "%dx%d", w, h);
+            printf("%-24s %-10s %4u %12.1f", name, size, format * 8, mb / before * 1000.0);
+
+            for ( int isa = TGA_ISA_SCALAR ; isa <= best_isa ; isa++ )
+            {
+                tga_limit_kernel_isa(isa);
+                double after = Time_Encoder(tga_write_rle, CHECK_FILE, image
+                                           , w, h, format, runs);
+                printf(" %10.1f", mb / after * 1000.0);
+            }
+            tga_limit_kernel_isa(TGA_ISA_COUNT - 1);
+            printf("\n");
+
+            free(image);
+        }
+    }
+    remove(CHECK_FILE);
+
+    if ( ! all_match )
+        printf("\n! decodes differently from the original\n");
+    return all_match ? 0 : 1;
+}
@@ -0,0 +1,20 @@
+/*
+ * tga_reference.h: The original libtarga decoder and RLE encoder, kept for
+ * the benchmarks.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* tga_load as it was, byte at a time. Same arguments and results. */
+void * tga_load_reference( const char * file, int * width, int * height, unsigned int format );
+
+/* tga_write_rle as it was, pixel at a time. Same arguments and results. */
+int tga_write_rle_reference( const char * file, int width, int height, unsigned char * dat, unsigned int format );
+
+#ifdef __cplusplus
+}
+#endif